@@ -0,0 +1,275 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "benchmarks/benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::atomic<uint64_t> g_allocation_count {0};
+std::atomic<int64_t> g_live_bytes {0};
+
+// Every block is prefixed with its size, to keep track of live bytes; the prefix keeps the
+// alignment of `malloc()`.
+constexpr size_t kBlockHeaderSize = 16;
+
+std::vector<bench::Family>& Families()
+{
+    static std::vector<bench::Family> families;
+    return families;
+}
+
+std::vector<std::string> g_filters;
+bool g_table_header_printed = false;
+
+bool MatchesFilters(const std::string& name)
+{
+    if (g_filters.empty()) {
+        return true;
+    }
+
+    return std::any_of(g_filters.begin(), g_filters.end(), [&name](const std::string& filter) {
+        return name.find(filter) != std::string::npos;
+    });
+}
+
+// Runs `body(thread_index)` on `threads` threads, which start together; returns the elapsed
+// time from the start to the moment the last thread finishes.
+template<typename Body>
+Clock::duration RunOnThreads(size_t threads, Body body)
+{
+    std::atomic<size_t> ready {0};
+    std::atomic<bool> go {false};
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; ++i) {
+        workers.emplace_back([&, i] {
+            ready.fetch_add(1);
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+
+            body(i);
+        });
+    }
+
+    while (ready.load() != threads - 1) {
+        std::this_thread::yield();
+    }
+
+    auto start = Clock::now();
+    go = true;
+    body(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    return Clock::now() - start;
+}
+
+uint64_t Percentile(const std::vector<uint64_t>& sorted, double percent)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    auto rank = static_cast<size_t>(percent / 100.0 * static_cast<double>(sorted.size() - 1));
+    return sorted[rank];
+}
+
+void PrintTableHeader()
+{
+    printf("%-44s %8s %10s %10s %10s %10s %10s\n",
+           "benchmark", "threads", "ns/op", "allocs/op", "p50(ns)", "p99(ns)", "p99.9(ns)");
+    g_table_header_printed = true;
+}
+
+}   // namespace
+
+void* operator new(size_t size)
+{
+    g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    g_live_bytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+    for (;;) {
+        if (auto ptr = static_cast<char*>(malloc(size + kBlockHeaderSize))) {
+            memcpy(ptr, &size, sizeof(size));
+            return ptr + kBlockHeaderSize;
+        }
+
+        auto handler = std::get_new_handler();
+        if (!handler) {
+            g_live_bytes.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+            throw std::bad_alloc();
+        }
+
+        handler();
+    }
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    try {
+        return operator new(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (!ptr) {
+        return;
+    }
+
+    auto block = static_cast<char*>(ptr) - kBlockHeaderSize;
+    size_t size;
+    memcpy(&size, block, sizeof(size));
+    g_live_bytes.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+    free(block);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+namespace bench {
+
+FamilyRegistrar::FamilyRegistrar(Family family)
+{
+    Families().push_back(family);
+}
+
+uint64_t AllocationCount() noexcept
+{
+    return g_allocation_count.load(std::memory_order_relaxed);
+}
+
+int64_t LiveAllocatedBytes() noexcept
+{
+    return g_live_bytes.load(std::memory_order_relaxed);
+}
+
+void Report(const std::string& name, const std::string& metric, double value)
+{
+    if (!MatchesFilters(name)) {
+        return;
+    }
+
+    printf("%-44s %s: %.1f\n", name.c_str(), metric.c_str(), value);
+    fflush(stdout);
+}
+
+void Measure(const std::string& name, const MeasureOptions& options, const Operation& op)
+{
+    if (!MatchesFilters(name)) {
+        return;
+    }
+
+    if (!g_table_header_printed) {
+        PrintTableHeader();
+    }
+
+    auto threads = std::max<size_t>(options.threads, 1);
+
+    // Warm up thread-local states and caches.
+    for (size_t i = 0; i < std::min<size_t>(options.iterations, 100); ++i) {
+        op(0);
+    }
+
+    // Throughput pass.
+    auto allocations_before = AllocationCount();
+    auto elapsed = RunOnThreads(threads, [&op, &options](size_t thread_index) {
+        for (size_t i = 0; i < options.iterations; ++i) {
+            op(thread_index);
+        }
+    });
+    auto allocations = AllocationCount() - allocations_before;
+
+    // Latency pass; sample buffers are allocated up front.
+    std::vector<std::vector<uint64_t>> samples(threads);
+    for (auto& thread_samples : samples) {
+        thread_samples.resize(options.latency_samples);
+    }
+
+    RunOnThreads(threads, [&op, &options, &samples](size_t thread_index) {
+        auto& thread_samples = samples[thread_index];
+        for (size_t i = 0; i < options.latency_samples; ++i) {
+            auto start = Clock::now();
+            op(thread_index);
+            auto end = Clock::now();
+            thread_samples[i] = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        }
+    });
+
+    std::vector<uint64_t> latencies;
+    latencies.reserve(threads * options.latency_samples);
+    for (const auto& thread_samples : samples) {
+        latencies.insert(latencies.end(), thread_samples.begin(), thread_samples.end());
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    auto total_ops = static_cast<double>(threads * options.iterations);
+    auto elapsed_ns = static_cast<double>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+
+    // ns/op is the wall time divided by operations of all threads, i.e. the reciprocal of the
+    // aggregate throughput.
+    printf("%-44s %8zu %10.1f %10.2f %10llu %10llu %10llu\n",
+           name.c_str(),
+           threads,
+           elapsed_ns / total_ops,
+           static_cast<double>(allocations) / total_ops,
+           static_cast<unsigned long long>(Percentile(latencies, 50)),
+           static_cast<unsigned long long>(Percentile(latencies, 99)),
+           static_cast<unsigned long long>(Percentile(latencies, 99.9)));
+    fflush(stdout);
+}
+
+int RunBenchmarks(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        g_filters.push_back(argv[i]);
+    }
+
+    for (auto family : Families()) {
+        family();
+    }
+
+    return 0;
+}
+
+}   // namespace bench
@@ -0,0 +1,60 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#ifndef KBASE_BENCHMARKS_BENCHMARK_H_
+#define KBASE_BENCHMARKS_BENCHMARK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace bench {
+
+// A minimal harness for micro benchmarks.
+// A family is a function registered by `BENCHMARK_FAMILY`, which sets up its environment and
+// calls `Measure()` for each of its scenarios.
+// Each scenario is run twice: the throughput pass times operations as a whole, which gives
+// ns/op and allocations/op; the latency pass times every single operation, which gives
+// percentiles, including the overhead of reading the clock.
+
+struct MeasureOptions {
+    size_t threads = 1;
+    // Operations per thread in the throughput pass.
+    size_t iterations = 200000;
+    // Operations per thread in the latency pass.
+    size_t latency_samples = 20000;
+};
+
+// `thread_index` is in [0, threads).
+using Operation = std::function<void(size_t thread_index)>;
+
+// Runs the scenario and prints its result, unless `name` is filtered out.
+void Measure(const std::string& name, const MeasureOptions& options, const Operation& op);
+
+// Counted by the replaced global `operator new`.
+uint64_t AllocationCount() noexcept;
+
+// Bytes allocated by `operator new` and not freed yet.
+int64_t LiveAllocatedBytes() noexcept;
+
+// Prints a single metric of a scenario, e.g. memory per entry, unless `name` is filtered out.
+void Report(const std::string& name, const std::string& metric, double value);
+
+using Family = void (*)();
+
+struct FamilyRegistrar {
+    explicit FamilyRegistrar(Family family);
+};
+
+int RunBenchmarks(int argc, char* argv[]);
+
+}   // namespace bench
+
+#define BENCHMARK_FAMILY(family)                                                \
+    void family();                                                              \
+    static const bench::FamilyRegistrar family##_registrar(family);    \
+    void family()
+
+#endif  // KBASE_BENCHMARKS_BENCHMARK_H_
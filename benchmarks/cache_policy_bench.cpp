@@ -0,0 +1,117 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmarks/benchmark.h"
+#include "kbase/lru_cache.h"
+#include "kbase/segmented_lru_cache.h"
+#include "kbase/tiny_lfu_cache.h"
+
+namespace {
+
+constexpr size_t kKeySpace = 1000000;
+constexpr size_t kCacheCapacity = 10000;
+constexpr size_t kTraceLength = 2000000;
+
+// Keys drawn from a Zipf distribution over [0, kKeySpace), where key i has the weight
+// 1 / (i + 1)^skew.
+std::vector<uint64_t> MakeZipfTrace(double skew, size_t length, uint64_t seed)
+{
+    std::vector<double> cdf(kKeySpace);
+    double sum = 0;
+    for (size_t i = 0; i < kKeySpace; ++i) {
+        sum += 1.0 / std::pow(static_cast<double>(i + 1), skew);
+        cdf[i] = sum;
+    }
+
+    std::mt19937_64 engine(seed);
+    std::uniform_real_distribution<double> distribution(0, sum);
+    std::vector<uint64_t> trace(length);
+    for (auto& key : trace) {
+        auto it = std::lower_bound(cdf.begin(), cdf.end(), distribution(engine));
+        key = static_cast<uint64_t>(it - cdf.begin());
+    }
+
+    return trace;
+}
+
+// Interleaves the Zipf trace with sequential scans of keys never seen before: after every
+// `period` accesses comes a scan of `scan_length` keys.
+std::vector<uint64_t> MixScans(const std::vector<uint64_t>& trace, size_t period,
+                               size_t scan_length)
+{
+    std::vector<uint64_t> mixed;
+    uint64_t next_scan_key = kKeySpace;
+    for (size_t i = 0; i < trace.size(); ++i) {
+        if (i % period == 0) {
+            for (size_t j = 0; j < scan_length; ++j) {
+                mixed.push_back(next_scan_key++);
+            }
+        }
+
+        mixed.push_back(trace[i]);
+    }
+
+    return mixed;
+}
+
+// A miss fetches and puts the entry, as a read-through cache does.
+// Accesses of scans, which can never hit, are left out of the hit rate.
+template<typename Cache>
+void ReplayTrace(const std::string& name, const std::vector<uint64_t>& trace)
+{
+    Cache cache(kCacheCapacity);
+    size_t hits = 0;
+    size_t accesses = 0;
+    for (auto key : trace) {
+        bool hit = cache.Get(key) != cache.end();
+        if (!hit) {
+            cache.Put(key, key);
+        }
+
+        if (key < kKeySpace) {
+            ++accesses;
+            hits += hit;
+        }
+    }
+
+    bench::Report(name, "hit rate %", 100.0 * static_cast<double>(hits) / accesses);
+
+    size_t cursor = 0;
+    bench::MeasureOptions options;
+    options.iterations = 1000000;
+    options.latency_samples = 100000;
+    bench::Measure(name + "/access", options, [&](size_t) {
+        auto key = trace[cursor];
+        cursor = (cursor + 1) % trace.size();
+        if (cache.Get(key) == cache.end()) {
+            cache.Put(key, key);
+        }
+    });
+}
+
+void ReplayTraceOnPolicies(const std::string& name, const std::vector<uint64_t>& trace)
+{
+    ReplayTrace<kbase::LRUCache<uint64_t, uint64_t, kbase::HashMap>>(
+        "cache_policy/lru/" + name, trace);
+    ReplayTrace<kbase::SegmentedLRUCache<uint64_t, uint64_t, kbase::HashMap>>(
+        "cache_policy/segmented_lru/" + name, trace);
+    ReplayTrace<kbase::TinyLFUCache<uint64_t, uint64_t, kbase::HashMap>>(
+        "cache_policy/tiny_lfu/" + name, trace);
+}
+
+}   // namespace
+
+BENCHMARK_FAMILY(CachePolicyBenchmarks)
+{
+    auto zipf = MakeZipfTrace(0.9, kTraceLength, 20161017);
+    ReplayTraceOnPolicies("zipf", zipf);
+    ReplayTraceOnPolicies("zipf_with_scans", MixScans(zipf, 20000, 20000));
+}
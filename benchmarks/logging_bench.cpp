@@ -0,0 +1,197 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <utility>
+#include <string>
+#include <thread>
+
+#include "benchmarks/benchmark.h"
+#include "kbase/basic_macros.h"
+#include "kbase/chrono_util.h"
+#include "kbase/file_util.h"
+#include "kbase/logging.h"
+#include "kbase/path.h"
+
+#if defined(OS_POSIX)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using bench::MeasureOptions;
+using kbase::LoggingSettings;
+using kbase::LogItemOptions;
+using kbase::PathString;
+
+#if defined(OS_WIN)
+const PathString kNullDevice = PATH_LITERAL("NUL");
+#else
+const PathString kNullDevice = PATH_LITERAL("/dev/null");
+#endif
+
+size_t ProducerThreads()
+{
+    return std::max<size_t>(2, std::min<size_t>(std::thread::hardware_concurrency(), 8));
+}
+
+// Never deletes the file, which could be the null device.
+LoggingSettings FileSettings(const PathString& path, bool async_logging = false)
+{
+    LoggingSettings settings;
+    settings.log_file_path = path;
+    settings.old_file_disposal_option = kbase::OldFileDisposalOption::AppendToOldFile;
+    settings.async_logging = async_logging;
+    return settings;
+}
+
+PathString TmpfsLogFilePath()
+{
+#if defined(OS_POSIX)
+    if (access("/dev/shm", W_OK) == 0) {
+        return PATH_LITERAL("/dev/shm/kbase_bench.log");
+    }
+#endif
+    return PATH_LITERAL("kbase_bench.log");
+}
+
+void LogTypicalMessage(size_t thread_index)
+{
+    LOG(INFO) << "request " << thread_index << " served in " << 1.25 << " ms";
+}
+
+// Formats the same line as `LogTypicalMessage()` does with the default settings, the way
+// `LogMessage` did before it reused a buffer per thread: into a fresh std::ostringstream,
+// whose string is copied out and written to the null device.
+// It is the reference for ns/op and allocs/op of logging/dev_null.
+void LogTypicalMessageWithOstringstream(size_t thread_index)
+{
+    std::ostringstream stream;
+    auto explode = kbase::TimePointToLocalTimeExplode<std::chrono::milliseconds>(
+        std::chrono::system_clock::now());
+    char timestamp[64] {0};
+    snprintf(timestamp, sizeof(timestamp), "%4d%02d%02d %02d:%02d:%02d,%03d", explode.year,
+             explode.month, explode.day_of_month, explode.hour, explode.minute, explode.second,
+             static_cast<int>(explode.remainder));
+    stream << "[" << timestamp << " INFO " << kbase::internal::ExtractFileName(__FILE__)
+           << '(' << __LINE__ << ")]";
+    stream << "request " << thread_index << " served in " << 1.25 << " ms" << std::endl;
+
+    std::string msg = stream.str();
+#if defined(OS_POSIX)
+    static const int null_fd = open("/dev/null", O_WRONLY);
+    auto written = write(null_fd, msg.data(), msg.size());
+    UNUSED_VAR(written);
+#else
+    static FILE* null_file = _wfopen(kNullDevice.c_str(), L"wb");
+    fwrite(msg.data(), 1, msg.size(), null_file);
+    fflush(null_file);
+#endif
+}
+
+void MeasureWithProducers(const std::string& name, const bench::Operation& op)
+{
+    MeasureOptions options;
+    Measure(name + "/1", options, op);
+
+    options.threads = ProducerThreads();
+    options.iterations /= options.threads;
+    Measure(name + "/N", options, op);
+}
+
+// Silences the standard error stream, to which FATAL messages are always written.
+class ScopedStderrSilencer {
+public:
+    ScopedStderrSilencer()
+    {
+#if defined(OS_POSIX)
+        fflush(stderr);
+        saved_stderr_ = dup(STDERR_FILENO);
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDERR_FILENO);
+        close(null_fd);
+#endif
+    }
+
+    ~ScopedStderrSilencer()
+    {
+#if defined(OS_POSIX)
+        fflush(stderr);
+        dup2(saved_stderr_, STDERR_FILENO);
+        close(saved_stderr_);
+#endif
+    }
+
+    ScopedStderrSilencer(const ScopedStderrSilencer&) = delete;
+
+    ScopedStderrSilencer& operator=(const ScopedStderrSilencer&) = delete;
+
+private:
+#if defined(OS_POSIX)
+    int saved_stderr_;
+#endif
+};
+
+}   // namespace
+
+BENCHMARK_FAMILY(LoggingBenchmarks)
+{
+    // The cost of a message below the threshold, which should be only a load and a compare.
+    auto settings = FileSettings(kNullDevice);
+    settings.min_severity_level = kbase::LogSeverity::LogError;
+    kbase::ConfigureLoggingSettings(settings);
+    MeasureWithProducers("logging/disabled_severity", LogTypicalMessage);
+    MeasureWithProducers("logging/disabled_vlog", [](size_t thread_index) {
+        VLOG(1) << "request " << thread_index << " served in " << 1.25 << " ms";
+    });
+
+    kbase::ConfigureLoggingSettings(FileSettings(kNullDevice));
+    MeasureWithProducers("logging/dev_null", LogTypicalMessage);
+    MeasureWithProducers("logging/dev_null_ostringstream", LogTypicalMessageWithOstringstream);
+
+    kbase::ConfigureLoggingSettings(FileSettings(kNullDevice, true));
+    MeasureWithProducers("logging/dev_null_async", LogTypicalMessage);
+
+    auto tmpfs_path = TmpfsLogFilePath();
+    kbase::RemoveFile(kbase::Path(tmpfs_path), false);
+    kbase::ConfigureLoggingSettings(FileSettings(tmpfs_path));
+    MeasureWithProducers("logging/tmpfs", LogTypicalMessage);
+    kbase::ConfigureLoggingSettings(FileSettings(tmpfs_path, true));
+    MeasureWithProducers("logging/tmpfs_async", LogTypicalMessage);
+
+    const std::pair<const char*, LogItemOptions> header_options[] {
+        {"none", LogItemOptions::EnableNone},
+        {"timestamp", LogItemOptions::EnableTimestamp},
+        {"pid", LogItemOptions::EnableProcessID},
+        {"tid", LogItemOptions::EnableThreadID},
+        {"all", LogItemOptions::EnableAll}
+    };
+
+    for (const auto& option : header_options) {
+        auto header_settings = FileSettings(kNullDevice);
+        header_settings.log_item_options = option.second;
+        kbase::ConfigureLoggingSettings(header_settings);
+        Measure(std::string("logging/header/") + option.first, MeasureOptions(),
+                LogTypicalMessage);
+    }
+
+    // FATAL messages walk and symbolize the stack, which is orders of magnitude slower.
+    kbase::ConfigureLoggingSettings(FileSettings(kNullDevice));
+    {
+        ScopedStderrSilencer silencer;
+        MeasureOptions options;
+        options.iterations = 200;
+        options.latency_samples = 200;
+        Measure("logging/fatal_stack_dump", options, [](size_t) {
+            LOG(FATAL) << "fatal message";
+        });
+    }
+
+    kbase::ConfigureLoggingSettings(LoggingSettings());
+    kbase::RemoveFile(kbase::Path(tmpfs_path), false);
+}
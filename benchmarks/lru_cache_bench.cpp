@@ -0,0 +1,255 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmarks/benchmark.h"
+#include "kbase/concurrent_lru_cache.h"
+#include "kbase/hash_lru_cache.h"
+#include "kbase/lru_cache.h"
+#include "kbase/string_view.h"
+
+namespace {
+
+using bench::MeasureOptions;
+
+constexpr size_t kCacheCapacity = 100000;
+constexpr size_t kKeySequenceSize = 1 << 16;
+
+// Random keys in [0, key_space), which are looked up in turn.
+class KeySequence {
+public:
+    explicit KeySequence(uint64_t key_space, uint64_t offset = 0, uint64_t seed = 20161017)
+        : keys_(kKeySequenceSize)
+    {
+        std::mt19937_64 engine(seed);
+        std::uniform_int_distribution<uint64_t> distribution(0, key_space - 1);
+        for (auto& key : keys_) {
+            key = distribution(engine) + offset;
+        }
+    }
+
+    uint64_t Next() noexcept
+    {
+        auto key = keys_[cursor_];
+        cursor_ = (cursor_ + 1) % keys_.size();
+        return key;
+    }
+
+private:
+    std::vector<uint64_t> keys_;
+    size_t cursor_ = 0;
+};
+
+template<typename Cache>
+void BenchmarkCache(const std::string& name)
+{
+    // Memory per entry is measured on a fresh cache, which includes the index.
+    {
+        auto live_bytes = bench::LiveAllocatedBytes();
+        Cache cache(kCacheCapacity);
+        for (uint64_t key = 0; key < kCacheCapacity; ++key) {
+            cache.Put(key, key);
+        }
+
+        bench::Report(name + "/memory", "bytes/entry",
+                      static_cast<double>(bench::LiveAllocatedBytes() - live_bytes) /
+                      kCacheCapacity);
+    }
+
+    Cache cache(kCacheCapacity);
+    for (uint64_t key = 0; key < kCacheCapacity; ++key) {
+        cache.Put(key, key);
+    }
+
+    MeasureOptions options;
+    options.iterations = 1000000;
+    options.latency_samples = 100000;
+
+    KeySequence hits(kCacheCapacity);
+    uint64_t checksum = 0;
+    bench::Measure(name + "/get_hit", options, [&](size_t) {
+        checksum += cache.Get(hits.Next())->second;
+    });
+
+    KeySequence misses(kCacheCapacity, kCacheCapacity * 1000);
+    bench::Measure(name + "/get_miss", options, [&](size_t) {
+        checksum += cache.Get(misses.Next()) == cache.end();
+    });
+
+    // Every Put misses and evicts the least recently used entry.
+    uint64_t next_key = kCacheCapacity;
+    bench::Measure(name + "/put_evict", options, [&](size_t) {
+        cache.Put(next_key, next_key);
+        ++next_key;
+    });
+
+    if (checksum == 42) {
+        bench::Report(name, "checksum", static_cast<double>(checksum));
+    }
+}
+
+// Every Put evicts an entry with a time-to-live, whose expiry index node is freed as well.
+template<typename Cache>
+void BenchmarkPutEvictWithTTL(const std::string& name)
+{
+    Cache cache(kCacheCapacity);
+    cache.set_default_ttl(std::chrono::hours(1));
+    for (uint64_t key = 0; key < kCacheCapacity; ++key) {
+        cache.Put(key, key);
+    }
+
+    MeasureOptions options;
+    options.iterations = 1000000;
+    options.latency_samples = 100000;
+
+    uint64_t next_key = kCacheCapacity;
+    bench::Measure(name + "/put_evict_ttl", options, [&](size_t) {
+        cache.Put(next_key, next_key);
+        ++next_key;
+    });
+}
+
+// The baseline of concurrent caches: a single cache behind a single lock.
+class LockedLRUCache {
+public:
+    explicit LockedLRUCache(size_t max_size)
+        : cache_(max_size)
+    {}
+
+    void Put(uint64_t key, uint64_t entry)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cache_.Put(key, entry);
+    }
+
+    bool Get(uint64_t key, uint64_t& entry)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = cache_.Get(key);
+        if (it == cache_.end()) {
+            return false;
+        }
+
+        entry = it->second;
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    kbase::HashLRUCache<uint64_t, uint64_t> cache_;
+};
+
+// A read-mostly workload: 1 of 16 operations is a Put, and lookups almost always hit.
+template<typename Cache>
+void BenchmarkReadMostly(const std::string& name, const std::function<Cache*()>& make_cache)
+{
+    std::unique_ptr<Cache> cache(make_cache());
+    for (uint64_t key = 0; key < kCacheCapacity; ++key) {
+        cache->Put(key, key);
+    }
+
+    size_t max_threads = std::max(2U, std::thread::hardware_concurrency());
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        std::vector<KeySequence> keys;
+        for (size_t i = 0; i < threads; ++i) {
+            keys.emplace_back(kCacheCapacity, 0, 20161017 + i);
+        }
+
+        std::vector<uint64_t> counters(threads * 8);
+        MeasureOptions options;
+        options.threads = threads;
+        options.iterations = 1000000;
+        options.latency_samples = 100000;
+        bench::Measure(name + "/" + std::to_string(threads), options, [&](size_t thread_index) {
+            auto& counter = counters[thread_index * 8];
+            auto key = keys[thread_index].Next();
+            if (++counter % 16 == 0) {
+                cache->Put(key, key);
+            } else {
+                uint64_t entry = 0;
+                cache->Get(key, entry);
+            }
+        });
+    }
+}
+
+// Callers often hold keys as string views, e.g. slices of requests; keys are long enough to
+// not fit in the small string buffer.
+void BenchmarkStringKeyLookup()
+{
+    using Cache = kbase::LRUCache<std::string, uint64_t, kbase::HashMap>;
+    Cache cache(kCacheCapacity);
+    std::vector<std::string> keys;
+    for (uint64_t i = 0; i < kCacheCapacity; ++i) {
+        keys.push_back("/api/v1/resources/" + std::to_string(i));
+        cache.Put(keys.back(), i);
+    }
+
+    MeasureOptions options;
+    options.iterations = 1000000;
+    options.latency_samples = 100000;
+
+    KeySequence sequence(kCacheCapacity);
+    uint64_t checksum = 0;
+    bench::Measure("lru_cache/string_keys/get_temporary_string", options, [&](size_t) {
+        kbase::StringView key = keys[sequence.Next()];
+        checksum += cache.Get(key.ToString())->second;
+    });
+
+    bench::Measure("lru_cache/string_keys/get_string_view", options, [&](size_t) {
+        kbase::StringView key = keys[sequence.Next()];
+        checksum += cache.Get(key)->second;
+    });
+
+    if (checksum == 42) {
+        bench::Report("lru_cache/string_keys", "checksum", static_cast<double>(checksum));
+    }
+}
+
+}   // namespace
+
+BENCHMARK_FAMILY(ConcurrentLRUCacheBenchmarks)
+{
+    using kbase::ConcurrentLRUCache;
+    using kbase::LRUPromotion;
+
+    BenchmarkReadMostly<LockedLRUCache>("concurrent_lru_cache/single_lock", [] {
+        return new LockedLRUCache(kCacheCapacity);
+    });
+
+    BenchmarkReadMostly<ConcurrentLRUCache<uint64_t, uint64_t>>(
+        "concurrent_lru_cache/eager", [] {
+            return new ConcurrentLRUCache<uint64_t, uint64_t>(
+                kCacheCapacity, ConcurrentLRUCache<uint64_t, uint64_t>::AutoSegmentCount,
+                LRUPromotion::Eager);
+        });
+
+    BenchmarkReadMostly<ConcurrentLRUCache<uint64_t, uint64_t>>(
+        "concurrent_lru_cache/lazy", [] {
+            return new ConcurrentLRUCache<uint64_t, uint64_t>(
+                kCacheCapacity, ConcurrentLRUCache<uint64_t, uint64_t>::AutoSegmentCount,
+                LRUPromotion::Lazy);
+        });
+}
+
+BENCHMARK_FAMILY(LRUCacheBenchmarks)
+{
+    BenchmarkCache<kbase::LRUCache<uint64_t, uint64_t, kbase::TreeMap>>("lru_cache/tree_map");
+    BenchmarkCache<kbase::LRUCache<uint64_t, uint64_t, kbase::HashMap>>("lru_cache/hash_map");
+    BenchmarkPutEvictWithTTL<kbase::LRUCache<uint64_t, uint64_t, kbase::TreeMap>>(
+        "lru_cache/tree_map");
+    BenchmarkPutEvictWithTTL<kbase::LRUCache<uint64_t, uint64_t, kbase::HashMap>>(
+        "lru_cache/hash_map");
+    BenchmarkCache<kbase::HashLRUCache<uint64_t, uint64_t>>("lru_cache/hash_lru_cache");
+    BenchmarkStringKeyLookup();
+}
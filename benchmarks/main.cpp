@@ -0,0 +1,16 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+// Runs registered benchmarks.
+//
+//   kbase_bench [filter]...
+//
+// Only scenarios whose names contain any of the filters are run, e.g. `kbase_bench logging/`.
+
+#include "benchmarks/benchmark.h"
+
+int main(int argc, char* argv[])
+{
+    return bench::RunBenchmarks(argc, argv);
+}
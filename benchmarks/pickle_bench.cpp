@@ -0,0 +1,89 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "benchmarks/benchmark.h"
+#include "kbase/pickle.h"
+
+namespace {
+
+using bench::MeasureOptions;
+
+constexpr size_t kLargestElementCount = 1000000;
+
+// With amortized growth, the time per element stays flat as the vector grows.
+void BenchmarkVectorSerialization()
+{
+    uint64_t checksum = 0;
+    for (size_t count = 1000; count <= kLargestElementCount; count *= 10) {
+        std::vector<int> values(count);
+        std::iota(values.begin(), values.end(), 0);
+
+        MeasureOptions options;
+        options.iterations = std::max<size_t>(kLargestElementCount * 10 / count, 1);
+        options.latency_samples = std::max<size_t>(options.iterations / 10, 1);
+        bench::Measure("pickle/write_vector_int/" + std::to_string(count), options, [&](size_t) {
+            kbase::Pickle pickle;
+            pickle << values;
+            checksum += pickle.size();
+        });
+
+        kbase::Pickle pickled;
+        pickled << values;
+        bench::Measure("pickle/read_vector_int/" + std::to_string(count), options, [&](size_t) {
+            kbase::PickleReader reader(pickled);
+            std::vector<int> read_values;
+            reader >> read_values;
+            checksum += read_values.size();
+        });
+    }
+
+    if (checksum == 42) {
+        bench::Report("pickle", "checksum", static_cast<double>(checksum));
+    }
+}
+
+// Counts how many times the buffer is reallocated while 1M ints are written.
+void ReportReallocations()
+{
+    std::vector<int> values(kLargestElementCount);
+    std::iota(values.begin(), values.end(), 0);
+
+    auto count_reallocations = [&values](bool reserve) {
+        kbase::Pickle pickle;
+        if (reserve) {
+            pickle.Reserve(kbase::EstimatePickledSize(values));
+        }
+
+        size_t reallocations = 0;
+        auto capacity = pickle.capacity();
+        pickle << values.size();
+        for (auto value : values) {
+            pickle << value;
+            if (pickle.capacity() != capacity) {
+                capacity = pickle.capacity();
+                ++reallocations;
+            }
+        }
+
+        return static_cast<double>(reallocations);
+    };
+
+    bench::Report("pickle/write_1m_ints/element_by_element", "reallocations",
+                  count_reallocations(false));
+    bench::Report("pickle/write_1m_ints/reserved", "reallocations", count_reallocations(true));
+}
+
+}   // namespace
+
+BENCHMARK_FAMILY(PickleBenchmarks)
+{
+    BenchmarkVectorSerialization();
+    ReportReallocations();
+}
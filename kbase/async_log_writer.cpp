@@ -0,0 +1,257 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "kbase/async_log_writer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+#include "kbase/error_exception_util.h"
+
+namespace {
+
+using kbase::internal::AsyncLogWriter;
+
+// The flusher wakes up at this interval even if nobody pokes it.
+constexpr auto kFlushInterval = std::chrono::milliseconds(50);
+
+// Interval for a blocked producer to re-check free space.
+constexpr auto kBlockedProducerRecheckInterval = std::chrono::milliseconds(1);
+
+// Records per batch handed over to the batch writer.
+constexpr size_t kMaxBatchSize = 128;
+
+size_t RoundUpToPowerOf2(size_t num) noexcept
+{
+    size_t result = 1;
+    while (result < num) {
+        result <<= 1;
+    }
+
+    return result;
+}
+
+AsyncLogWriter::Record MakeDroppedNoticeRecord(size_t dropped_count)
+{
+    char buf[128];
+    int len = snprintf(buf, sizeof(buf),
+                       "[WARNING] %zu log messages were dropped due to async logging "
+                       "buffer overflow\n", dropped_count);
+
+    AsyncLogWriter::Record record;
+    record.severity = kbase::LogSeverity::LogWarning;
+    record.message.assign(buf, static_cast<size_t>(len));
+
+    return record;
+}
+
+}   // namespace
+
+namespace kbase {
+
+namespace internal {
+
+AsyncLogWriter::AsyncLogWriter(size_t capacity, AsyncOverflowPolicy overflow_policy,
+                               BatchWriter writer)
+    : cells_(new Cell[RoundUpToPowerOf2(std::max<size_t>(capacity, 2))]),
+      mask_(RoundUpToPowerOf2(std::max<size_t>(capacity, 2)) - 1),
+      overflow_policy_(overflow_policy),
+      writer_(std::move(writer)),
+      enqueue_pos_(0),
+      dequeue_pos_(0),
+      dropped_count_(0),
+      wakeup_pending_(false),
+      stopping_(false)
+{
+    ENSURE(CHECK, !!writer_).Require();
+
+    for (size_t i = 0; i <= mask_; ++i) {
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    batch_.resize(kMaxBatchSize);
+
+    flusher_ = std::thread(&AsyncLogWriter::RunFlusher, this);
+}
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+    Stop();
+}
+
+void AsyncLogWriter::Append(LogSeverity severity, const char* data, size_t size)
+{
+    Append(LogRecord {severity, "", 0, data, size});
+}
+
+void AsyncLogWriter::Append(const LogRecord& record)
+{
+    while (!TryPush(record)) {
+        switch (overflow_policy_) {
+            case AsyncOverflowPolicy::DropNewestOnOverflow:
+                dropped_count_.fetch_add(1, std::memory_order_relaxed);
+                return;
+
+            case AsyncOverflowPolicy::DropOldestOnOverflow: {
+                Record discarded;
+                if (TryPop(discarded)) {
+                    dropped_count_.fetch_add(1, std::memory_order_relaxed);
+                }
+                break;
+            }
+
+            case AsyncOverflowPolicy::BlockOnOverflow:
+            default: {
+                std::unique_lock<std::mutex> lock(wakeup_mutex_);
+                if (stopping_) {
+                    // Nobody would make room for us, do it on our own.
+                    lock.unlock();
+                    Flush();
+                    break;
+                }
+
+                wakeup_pending_ = true;
+                wakeup_cv_.notify_one();
+                space_cv_.wait_for(lock, kBlockedProducerRecheckInterval);
+                break;
+            }
+        }
+    }
+
+    // Don't let the buffer stay half full or an error message linger until the next tick.
+    auto pending = enqueue_pos_.load(std::memory_order_relaxed) -
+                   dequeue_pos_.load(std::memory_order_relaxed);
+    if (record.severity >= LogSeverity::LogError || pending > capacity() / 2) {
+        WakeupFlusher();
+    }
+}
+
+bool AsyncLogWriter::TryPush(const LogRecord& record)
+{
+    Cell* cell;
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+        cell = &cells_[pos & mask_];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->record.severity = record.severity;
+    cell->record.file_name = record.file_name;
+    cell->record.line = record.line;
+    cell->record.message.assign(record.message, record.length);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+
+    return true;
+}
+
+bool AsyncLogWriter::TryPop(Record& record)
+{
+    Cell* cell;
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+        cell = &cells_[pos & mask_];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+        if (diff == 0) {
+            if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = dequeue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    record.severity = cell->record.severity;
+    record.file_name = cell->record.file_name;
+    record.line = cell->record.line;
+    record.message.swap(cell->record.message);
+    cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+
+    return true;
+}
+
+void AsyncLogWriter::Flush()
+{
+    std::lock_guard<std::mutex> lock(drain_mutex_);
+    DrainLocked();
+}
+
+void AsyncLogWriter::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeup_mutex_);
+        stopping_ = true;
+        wakeup_cv_.notify_one();
+    }
+
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+
+    Flush();
+}
+
+void AsyncLogWriter::WakeupFlusher()
+{
+    std::lock_guard<std::mutex> lock(wakeup_mutex_);
+    wakeup_pending_ = true;
+    wakeup_cv_.notify_one();
+}
+
+void AsyncLogWriter::RunFlusher()
+{
+    std::unique_lock<std::mutex> lock(wakeup_mutex_);
+    while (!stopping_) {
+        wakeup_cv_.wait_for(lock, kFlushInterval, [this] {
+            return wakeup_pending_ || stopping_;
+        });
+        wakeup_pending_ = false;
+
+        lock.unlock();
+        Flush();
+        lock.lock();
+
+        space_cv_.notify_all();
+    }
+}
+
+void AsyncLogWriter::DrainLocked()
+{
+    for (;;) {
+        size_t count = 0;
+        while (count < batch_.size() && TryPop(batch_[count])) {
+            ++count;
+        }
+
+        if (count == 0) {
+            break;
+        }
+
+        writer_(batch_.data(), count);
+    }
+
+    auto dropped = dropped_count_.exchange(0, std::memory_order_relaxed);
+    if (dropped != 0) {
+        auto notice = MakeDroppedNoticeRecord(dropped);
+        writer_(&notice, 1);
+    }
+}
+
+}   // namespace internal
+
+}   // namespace kbase
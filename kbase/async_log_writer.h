@@ -0,0 +1,128 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef KBASE_ASYNC_LOG_WRITER_H_
+#define KBASE_ASYNC_LOG_WRITER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "kbase/logging.h"
+
+namespace kbase {
+
+namespace internal {
+
+// AsyncLogWriter decouples producing log messages from writing them out.
+// Producers copy finished messages into a bounded multi-producer multi-consumer ring buffer,
+// and a dedicated flusher thread hands records over to the batch writer in batches, which
+// allows the writer to coalesce them into a few large writes.
+// The ring buffer is the well-known bounded queue by Dmitry Vyukov: each cell carries a
+// sequence number, and producers/consumers claim cells by a CAS on their own position.
+// Message buffers are swapped, rather than copied, between cells and the flusher, so that
+// their capacities keep circulating and no allocation happens in the steady state.
+class AsyncLogWriter {
+public:
+    struct Record {
+        LogSeverity severity = LogSeverity::LogInfo;
+        const char* file_name = "";
+        int line = 0;
+        std::string message;
+    };
+
+    // Writes `count` records in a row. It is always invoked by one thread at a time.
+    using BatchWriter = std::function<void(const Record* records, size_t count)>;
+
+    // `capacity` is rounded up to the nearest power of 2.
+    AsyncLogWriter(size_t capacity, AsyncOverflowPolicy overflow_policy, BatchWriter writer);
+
+    ~AsyncLogWriter();
+
+    AsyncLogWriter(const AsyncLogWriter&) = delete;
+
+    AsyncLogWriter& operator=(const AsyncLogWriter&) = delete;
+
+    AsyncLogWriter(AsyncLogWriter&&) = delete;
+
+    AsyncLogWriter& operator=(AsyncLogWriter&&) = delete;
+
+    // Enqueues a message; what happens when the buffer is full depends on the overflow policy.
+    void Append(const LogRecord& record);
+
+    void Append(LogSeverity severity, const char* data, size_t size);
+
+    // Synchronously writes out all pending records on the calling thread.
+    void Flush();
+
+    // Stops the flusher thread, and then drains what is left.
+    // It is safe to call this function more than once.
+    void Stop();
+
+    size_t capacity() const noexcept
+    {
+        return mask_ + 1;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        Record record;
+    };
+
+    bool TryPush(const LogRecord& record);
+
+    bool TryPop(Record& record);
+
+    void WakeupFlusher();
+
+    void RunFlusher();
+
+    // Requires `drain_mutex_` being held.
+    void DrainLocked();
+
+private:
+    // Paddings keep hot positions from sharing a cache line; we can't rely on over-aligned
+    // allocations prior to C++ 17.
+    static constexpr size_t kCacheLineSize = 64;
+    using CacheLinePadding = char[kCacheLineSize];
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    AsyncOverflowPolicy overflow_policy_;
+    BatchWriter writer_;
+
+    CacheLinePadding padding0_;
+    std::atomic<size_t> enqueue_pos_;
+    CacheLinePadding padding1_;
+    std::atomic<size_t> dequeue_pos_;
+    CacheLinePadding padding2_;
+    std::atomic<size_t> dropped_count_;
+    CacheLinePadding padding3_;
+
+    std::mutex drain_mutex_;
+    std::vector<Record> batch_;
+
+    std::mutex wakeup_mutex_;
+    std::condition_variable wakeup_cv_;
+    std::condition_variable space_cv_;
+    bool wakeup_pending_;
+    bool stopping_;
+    std::thread flusher_;
+};
+
+}   // namespace internal
+
+}   // namespace kbase
+
+#endif  // KBASE_ASYNC_LOG_WRITER_H_
@@ -0,0 +1,530 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "kbase/binary_logging.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+#include "kbase/chrono_util.h"
+
+#if defined(OS_WIN)
+#include <Windows.h>
+#elif defined(OS_POSIX)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using kbase::LogSeverity;
+using kbase::Pickle;
+using kbase::PickleReader;
+using kbase::internal::BinaryLogRecordKind;
+using kbase::internal::BinaryLogSite;
+
+#if defined(OS_WIN)
+using FileHandle = HANDLE;
+const FileHandle kInvalidFileHandle = INVALID_HANDLE_VALUE;
+#else
+using FileHandle = int;
+constexpr FileHandle kInvalidFileHandle = -1;
+#endif
+
+// Every binary log file starts with it.
+constexpr char kBinaryLogMagic[] {'K', 'B', 'L', 'O', 'G', '\0', '\0', '\1'};
+
+struct RegisteredSite {
+    const BinaryLogSite* site;
+    uint32_t id;
+};
+
+// Guards site registration and the binary log file switching.
+std::mutex g_registry_mutex;
+std::vector<RegisteredSite> g_registered_sites;
+
+std::atomic<FileHandle> g_binary_log_file {kInvalidFileHandle};
+
+// A record buffer grown larger than this is released at the next record, rather than being
+// kept for the thread.
+constexpr size_t kMaxRetainedRecordCapacity = 64 * 1024;
+
+// Each thread encodes its records into its own buffer; the holder is destroyed on thread exit,
+// after which messages from the thread are logged as text messages.
+thread_local bool tls_record_buffer_destroyed = false;
+
+struct ThreadRecordBufferHolder {
+    ~ThreadRecordBufferHolder()
+    {
+        tls_record_buffer_destroyed = true;
+    }
+
+    Pickle record;
+};
+
+bool IsFileHandleValid(FileHandle handle)
+{
+#if defined(OS_WIN)
+    return handle != INVALID_HANDLE_VALUE && handle != nullptr;
+#else
+    return handle != -1;
+#endif
+}
+
+void WriteToFile(FileHandle file, const void* data, size_t size)
+{
+#if defined(OS_WIN)
+    DWORD bytes_written = 0;
+    WriteFile(file, data, static_cast<DWORD>(size), &bytes_written, nullptr);
+#else
+    IGNORE_RESULT(write(file, data, size));
+#endif
+}
+
+// A record is exactly a serialized pickle, which is prefixed with its payload size.
+void WriteRecord(FileHandle file, const Pickle& record)
+{
+    WriteToFile(file, record.data(), record.size());
+}
+
+Pickle MakeSiteDefinitionRecord(const BinaryLogSite& site, uint32_t id)
+{
+    Pickle record;
+    record << static_cast<uint32_t>(BinaryLogRecordKind::SiteDefinition)
+           << id
+           << static_cast<int>(site.log_site.severity)
+           << site.log_site.line;
+    kbase::internal::WriteBinaryLogString(record, site.log_site.file_name);
+    kbase::internal::WriteBinaryLogString(record, site.format);
+    kbase::internal::WriteBinaryLogString(record, site.arg_types);
+
+    return record;
+}
+
+FileHandle OpenBinaryLogFile(const kbase::PathString& path)
+{
+#if defined(OS_WIN)
+    auto file = CreateFileW(path.c_str(),
+                            FILE_APPEND_DATA,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE,
+                            nullptr,
+                            OPEN_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+    LARGE_INTEGER size {};
+    bool empty = IsFileHandleValid(file) && GetFileSizeEx(file, &size) && size.QuadPart == 0;
+#else
+    auto file = open(path.c_str(), O_CREAT | O_WRONLY | O_APPEND, 0666);
+    struct stat file_stat {};
+    bool empty = IsFileHandleValid(file) && fstat(file, &file_stat) == 0 &&
+                 file_stat.st_size == 0;
+#endif
+
+    if (empty) {
+        WriteToFile(file, kBinaryLogMagic, sizeof(kBinaryLogMagic));
+    }
+
+    return file;
+}
+
+void CloseBinaryLogFile(FileHandle file)
+{
+#if defined(OS_WIN)
+    CloseHandle(file);
+#else
+    close(file);
+#endif
+}
+
+// Reads a value in fixed size; returns false if the record has not enough bytes left.
+template<typename T>
+bool ReadFixed(PickleReader& reader, T& value)
+{
+    if (reader.remaining_size() < sizeof(T)) {
+        return false;
+    }
+
+    reader >> value;
+    return true;
+}
+
+// Returns false if the string runs past the end of the record.
+bool ReadString(PickleReader& reader, std::string& value)
+{
+    PickleReader probe = reader;
+    size_t length;
+    if (!ReadFixed(probe, length) || length > probe.remaining_size()) {
+        return false;
+    }
+
+    reader >> value;
+    return true;
+}
+
+// Reads arguments in accordance with `arg_types`, and renders them in the same way as
+// `BinaryLogArgTraits::ToText()`.
+// Returns false if arguments are incomplete or of unknown types.
+bool ReadMessageArgs(const char* arg_types, PickleReader& reader, std::vector<std::string>& args)
+{
+    for (const char* type = arg_types; *type != '\0'; ++type) {
+        switch (*type) {
+            case 'b': {
+                bool value;
+                if (!ReadFixed(reader, value)) {
+                    return false;
+                }
+
+                args.push_back(value ? "true" : "false");
+                break;
+            }
+
+            case 'c': {
+                int8_t value;
+                if (!ReadFixed(reader, value)) {
+                    return false;
+                }
+
+                args.push_back(std::string(1, static_cast<char>(value)));
+                break;
+            }
+
+            case 'i': {
+                int64_t value;
+                if (!ReadFixed(reader, value)) {
+                    return false;
+                }
+
+                args.push_back(std::to_string(value));
+                break;
+            }
+
+            case 'u': {
+                uint64_t value;
+                if (!ReadFixed(reader, value)) {
+                    return false;
+                }
+
+                args.push_back(std::to_string(value));
+                break;
+            }
+
+            case 'f': {
+                double value;
+                if (!ReadFixed(reader, value)) {
+                    return false;
+                }
+
+                args.push_back(kbase::internal::FormatBinaryLogFloat(value));
+                break;
+            }
+
+            case 's': {
+                std::string value;
+                if (!ReadString(reader, value)) {
+                    return false;
+                }
+
+                args.push_back(std::move(value));
+                break;
+            }
+
+            default:
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// Substitutes rendered arguments into `format`.
+std::string SubstituteArgs(const char* format, const std::vector<std::string>& args)
+{
+    std::string text;
+    for (const char* p = format; *p != '\0'; ++p) {
+        if ((*p == '{' || *p == '}') && *(p + 1) == *p) {
+            text += *p++;
+            continue;
+        }
+
+        if (*p == '{') {
+            char* end = nullptr;
+            auto index = strtoul(p + 1, &end, 10);
+            if (end != p + 1 && *end == '}' && index < args.size()) {
+                text += args[index];
+                p = end;
+                continue;
+            }
+        }
+
+        text += *p;
+    }
+
+    return text;
+}
+
+struct SiteDefinition {
+    LogSeverity severity;
+    int line;
+    std::string file_name;
+    std::string format;
+    std::string arg_types;
+};
+
+// Keep in line with `LogMessage::InitMessageHeader()`.
+void RenderMessageHeader(const SiteDefinition& site, int64_t timestamp_ticks, uint64_t pid,
+                         uint64_t tid, kbase::LogItemOptions options, std::ostream& out)
+{
+    out << "[";
+
+    if (options & kbase::LogItemOptions::EnableTimestamp) {
+        kbase::TimePoint timestamp {std::chrono::microseconds(timestamp_ticks)};
+        auto explode = kbase::TimePointToLocalTimeExplode<std::chrono::milliseconds>(timestamp);
+        // Fits seven fields of any int value, even though a sane timestamp takes 22 bytes.
+        char buf[96] {0};
+        snprintf(buf, sizeof(buf), "%4d%02d%02d %02d:%02d:%02d,%03d", explode.year,
+                 explode.month, explode.day_of_month, explode.hour, explode.minute,
+                 explode.second, static_cast<int>(explode.remainder));
+        out << buf;
+    }
+
+    if (options & kbase::LogItemOptions::EnableProcessID) {
+        out << " " << pid;
+    }
+
+    if (options & kbase::LogItemOptions::EnableThreadID) {
+        out << " " << tid;
+    }
+
+    out << " " << kbase::internal::LogSeverityName(site.severity)
+        << " " << site.file_name << '(' << site.line << ")]";
+}
+
+}   // namespace
+
+namespace kbase {
+
+bool DecodeBinaryLog(const void* data, size_t size, LogItemOptions options, std::ostream& out)
+{
+    auto bytes = static_cast<const byte*>(data);
+    if (size < sizeof(kBinaryLogMagic) ||
+        memcmp(bytes, kBinaryLogMagic, sizeof(kBinaryLogMagic)) != 0) {
+        return false;
+    }
+
+    std::unordered_map<uint32_t, SiteDefinition> sites;
+    uint64_t pid = 0;
+
+    for (size_t offset = sizeof(kBinaryLogMagic); offset < size;) {
+        uint32_t payload_size;
+        if (size - offset < sizeof(payload_size)) {
+            return false;
+        }
+
+        memcpy(&payload_size, bytes + offset, sizeof(payload_size));
+        size_t record_size = sizeof(payload_size) + payload_size;
+        if (payload_size == 0 || record_size > size - offset) {
+            return false;
+        }
+
+        // Records are not necessarily aligned in the file.
+        Pickle record(bytes + offset, record_size);
+        offset += record_size;
+
+        // Every read is checked against bytes left in the record, since the data may be
+        // corrupted.
+        PickleReader reader(record);
+        uint32_t kind;
+        if (!ReadFixed(reader, kind)) {
+            return false;
+        }
+
+        switch (static_cast<BinaryLogRecordKind>(kind)) {
+            case BinaryLogRecordKind::Session:
+                // Site ids are scoped in a session.
+                if (!ReadFixed(reader, pid)) {
+                    return false;
+                }
+
+                sites.clear();
+                break;
+
+            case BinaryLogRecordKind::SiteDefinition: {
+                uint32_t id;
+                int severity;
+                SiteDefinition site;
+                if (!ReadFixed(reader, id) || !ReadFixed(reader, severity) ||
+                    !ReadFixed(reader, site.line) || !ReadString(reader, site.file_name) ||
+                    !ReadString(reader, site.format) || !ReadString(reader, site.arg_types)) {
+                    return false;
+                }
+
+                if (severity < static_cast<int>(LogSeverity::LogInfo) ||
+                    severity > static_cast<int>(LogSeverity::LogFatal)) {
+                    return false;
+                }
+
+                site.severity = static_cast<LogSeverity>(severity);
+                sites[id] = std::move(site);
+                break;
+            }
+
+            case BinaryLogRecordKind::Message: {
+                uint32_t id;
+                int64_t timestamp_ticks;
+                uint64_t tid;
+                if (!ReadFixed(reader, id) || !ReadFixed(reader, timestamp_ticks) ||
+                    !ReadFixed(reader, tid)) {
+                    return false;
+                }
+
+                auto site_it = sites.find(id);
+                if (site_it == sites.end()) {
+                    return false;
+                }
+
+                const auto& site = site_it->second;
+                std::vector<std::string> args;
+                if (!ReadMessageArgs(site.arg_types.c_str(), reader, args)) {
+                    return false;
+                }
+
+                RenderMessageHeader(site, timestamp_ticks, pid, tid, options, out);
+                out << SubstituteArgs(site.format.c_str(), args) << "\n";
+                break;
+            }
+
+            default:
+                return false;
+        }
+    }
+
+    return true;
+}
+
+namespace internal {
+
+void WriteBinaryLogString(Pickle& pickle, StringView str)
+{
+    pickle << str.size();
+    if (!str.empty()) {
+        pickle.Write(str.data(), str.size());
+    }
+}
+
+uint32_t RegisterBinaryLogSite(BinaryLogSite& site, const char* format, const char* arg_types)
+{
+    std::lock_guard<std::mutex> lock(g_registry_mutex);
+
+    auto id = site.id.load(std::memory_order_relaxed);
+    if (id != 0) {
+        return id;
+    }
+
+    id = static_cast<uint32_t>(g_registered_sites.size() + 1);
+    site.format = format;
+    site.arg_types = arg_types;
+    g_registered_sites.push_back({&site, id});
+
+    auto file = g_binary_log_file.load(std::memory_order_acquire);
+    if (IsFileHandleValid(file)) {
+        WriteRecord(file, MakeSiteDefinitionRecord(site, id));
+    }
+
+    site.id.store(id, std::memory_order_release);
+
+    return id;
+}
+
+std::string FormatBinaryLogFloat(double value)
+{
+    std::ostringstream stream;
+    stream << value;
+    return stream.str();
+}
+
+Pickle* BeginBinaryLogRecord(uint32_t site_id)
+{
+    if (tls_record_buffer_destroyed) {
+        return nullptr;
+    }
+
+    thread_local ThreadRecordBufferHolder holder;
+    auto& record = holder.record;
+    if (record.capacity() > kMaxRetainedRecordCapacity) {
+        record = Pickle();
+    } else {
+        record.Clear();
+    }
+
+    auto ticks = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record << static_cast<uint32_t>(BinaryLogRecordKind::Message)
+           << site_id
+           << static_cast<int64_t>(ticks)
+           << kbase::GetCurrentOSThreadID();
+
+    return &record;
+}
+
+bool HasBinaryLogFile() noexcept
+{
+    return IsFileHandleValid(g_binary_log_file.load(std::memory_order_relaxed));
+}
+
+bool SubmitBinaryLogRecord(const Pickle& record)
+{
+    auto file = g_binary_log_file.load(std::memory_order_acquire);
+    if (!IsFileHandleValid(file)) {
+        return false;
+    }
+
+    WriteRecord(file, record);
+    return true;
+}
+
+void LogBinaryLogAsText(const BinaryLogSite& site, const char* format,
+                        const std::vector<std::string>& args)
+{
+    LogMessage(site.log_site).stream() << SubstituteArgs(format, args);
+}
+
+void ConfigureBinaryLogFile(const PathString& path)
+{
+    std::lock_guard<std::mutex> lock(g_registry_mutex);
+
+    auto old_file = g_binary_log_file.exchange(kInvalidFileHandle, std::memory_order_acq_rel);
+    if (IsFileHandleValid(old_file)) {
+        CloseBinaryLogFile(old_file);
+    }
+
+    if (path.empty()) {
+        return;
+    }
+
+    auto file = OpenBinaryLogFile(path);
+    if (!IsFileHandleValid(file)) {
+        return;
+    }
+
+    Pickle session;
+    session << static_cast<uint32_t>(BinaryLogRecordKind::Session) << kbase::GetCurrentOSProcessID();
+    WriteRecord(file, session);
+
+    // Sites registered before are still in use.
+    for (const auto& registered : g_registered_sites) {
+        WriteRecord(file, MakeSiteDefinitionRecord(*registered.site, registered.id));
+    }
+
+    g_binary_log_file.store(file, std::memory_order_release);
+}
+
+}   // namespace internal
+
+}   // namespace kbase
@@ -0,0 +1,319 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef KBASE_BINARY_LOGGING_H_
+#define KBASE_BINARY_LOGGING_H_
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "kbase/basic_types.h"
+#include "kbase/flight_recorder.h"
+#include "kbase/logging.h"
+#include "kbase/pickle.h"
+#include "kbase/string_view.h"
+
+namespace kbase {
+
+// Structured binary logging.
+// A call site registers its format string and argument types only once, and then each message
+// appends merely a compact binary record, which consists of the call-site id, timestamp,
+// thread id and raw argument bytes, to the binary log file specified by
+// `LoggingSettings::binary_log_file_path`. Records can be rendered back to text messages by
+// `DecodeBinaryLog()`, or the `kbase_logdecode` tool.
+// If no binary log file was specified, messages are formatted and logged as text messages.
+//
+// The format string must be a string literal, and each `{n}` in it is replaced by the n-th
+// argument, `{{` and `}}` are for literal braces. Supported argument types are bool, char,
+// integers, floating-points and strings.
+//
+//   BLOG(INFO, "request {0} served in {1} ms", request_id, elapsed_ms);
+//
+// Note that each process should use its own binary log file.
+
+#define BINARY_LOG_CALL_SITE(severity_value)                                            \
+    ([]() -> kbase::internal::BinaryLogSite& {                                          \
+        static kbase::internal::BinaryLogSite kbase_binary_log_site {                   \
+            kbase::internal::ExtractFileName(__FILE__), __LINE__, severity_value        \
+        };                                                                              \
+        return kbase_binary_log_site;                                                   \
+    }())
+
+// Filtered messages still reach `BinaryLog()` while the flight recorder is enabled.
+#define BINARY_LOG_IS_ON(severity) \
+    (LOG_IS_ON(severity) || kbase::internal::IsFlightRecorderEnabled())
+
+#define BLOG(severity, ...)                                                             \
+    !BINARY_LOG_IS_ON(severity) ? (void)0 :                                             \
+        kbase::internal::BinaryLog(BINARY_LOG_CALL_SITE(LOG_SEVERITY_FOR_##severity),   \
+                                   __VA_ARGS__)
+
+#define BLOG_IF(severity, condition, ...)                                               \
+    !(BINARY_LOG_IS_ON(severity) && (condition)) ? (void)0 :                            \
+        kbase::internal::BinaryLog(BINARY_LOG_CALL_SITE(LOG_SEVERITY_FOR_##severity),   \
+                                   __VA_ARGS__)
+
+// Renders records in binary log data, i.e. the content of a binary log file, back to text
+// messages in the same layout of text log files. `options` decides items of message headers.
+// Returns false if the data is malformed; records before the malformed one are still rendered.
+bool DecodeBinaryLog(const void* data, size_t size, LogItemOptions options, std::ostream& out);
+
+namespace internal {
+
+enum class BinaryLogRecordKind : uint32_t {
+    Session = 1,
+    SiteDefinition,
+    Message
+};
+
+struct BinaryLogSite {
+    constexpr BinaryLogSite(const char* file_name, int line, LogSeverity severity) noexcept
+        : log_site {file_name, line, severity}, format(nullptr), arg_types(nullptr), id(0)
+    {}
+
+    LogSite log_site;
+    // Both are set before `id` is published.
+    const char* format;
+    const char* arg_types;
+    // Assigned on the first message; 0 means unregistered.
+    std::atomic<uint32_t> id;
+};
+
+// Strings are encoded in the same way of `Pickle` encoding `std::string`.
+void WriteBinaryLogString(Pickle& pickle, StringView str);
+
+// Keeps in line with what a text message would print.
+std::string FormatBinaryLogFloat(double value);
+
+// Type tags of arguments, which are recorded in the site definition.
+// `ToText()` renders an argument exactly as decoding its record does, for messages logged as
+// text messages.
+
+template<typename T, typename = void>
+struct BinaryLogArgTraits;
+
+template<>
+struct BinaryLogArgTraits<bool> {
+    static constexpr char kTag = 'b';
+
+    static void Write(Pickle& pickle, bool value)
+    {
+        pickle << value;
+    }
+
+    static void Record(FlightRecordPayload& payload, bool value) noexcept
+    {
+        payload.AppendValue(value);
+    }
+
+    static std::string ToText(bool value)
+    {
+        return value ? "true" : "false";
+    }
+};
+
+template<>
+struct BinaryLogArgTraits<char> {
+    static constexpr char kTag = 'c';
+
+    static void Write(Pickle& pickle, char value)
+    {
+        pickle << static_cast<int8_t>(value);
+    }
+
+    static void Record(FlightRecordPayload& payload, char value) noexcept
+    {
+        payload.AppendValue(value);
+    }
+
+    static std::string ToText(char value)
+    {
+        return std::string(1, value);
+    }
+};
+
+template<typename T>
+struct BinaryLogArgTraits<T, std::enable_if_t<std::is_integral<T>::value &&
+                                              std::is_signed<T>::value &&
+                                              !std::is_same<T, char>::value>> {
+    static constexpr char kTag = 'i';
+
+    static void Write(Pickle& pickle, T value)
+    {
+        pickle << static_cast<int64_t>(value);
+    }
+
+    static void Record(FlightRecordPayload& payload, T value) noexcept
+    {
+        payload.AppendValue(static_cast<int64_t>(value));
+    }
+
+    static std::string ToText(T value)
+    {
+        return std::to_string(static_cast<int64_t>(value));
+    }
+};
+
+template<typename T>
+struct BinaryLogArgTraits<T, std::enable_if_t<std::is_integral<T>::value &&
+                                              std::is_unsigned<T>::value &&
+                                              !std::is_same<T, bool>::value &&
+                                              !std::is_same<T, char>::value>> {
+    static constexpr char kTag = 'u';
+
+    static void Write(Pickle& pickle, T value)
+    {
+        pickle << static_cast<uint64_t>(value);
+    }
+
+    static void Record(FlightRecordPayload& payload, T value) noexcept
+    {
+        payload.AppendValue(static_cast<uint64_t>(value));
+    }
+
+    static std::string ToText(T value)
+    {
+        return std::to_string(static_cast<uint64_t>(value));
+    }
+};
+
+template<typename T>
+struct BinaryLogArgTraits<T, std::enable_if_t<std::is_floating_point<T>::value>> {
+    static constexpr char kTag = 'f';
+
+    static void Write(Pickle& pickle, T value)
+    {
+        pickle << static_cast<double>(value);
+    }
+
+    static void Record(FlightRecordPayload& payload, T value) noexcept
+    {
+        payload.AppendValue(static_cast<double>(value));
+    }
+
+    static std::string ToText(T value)
+    {
+        return FormatBinaryLogFloat(static_cast<double>(value));
+    }
+};
+
+template<typename T>
+struct BinaryLogArgTraits<T, std::enable_if_t<std::is_same<T, const char*>::value ||
+                                              std::is_same<T, char*>::value ||
+                                              std::is_same<T, std::string>::value ||
+                                              std::is_same<T, StringView>::value>> {
+    static constexpr char kTag = 's';
+
+    static void Write(Pickle& pickle, StringView value)
+    {
+        WriteBinaryLogString(pickle, value);
+    }
+
+    static void Record(FlightRecordPayload& payload, StringView value) noexcept
+    {
+        payload.AppendString(value);
+    }
+
+    static std::string ToText(StringView value)
+    {
+        return value.ToString();
+    }
+};
+
+template<typename... Args>
+struct BinaryLogArgTypes {
+    static constexpr char value[] {BinaryLogArgTraits<std::decay_t<Args>>::kTag..., '\0'};
+};
+
+template<typename... Args>
+constexpr char BinaryLogArgTypes<Args...>::value[];
+
+inline void WriteBinaryLogArgs(Pickle&)
+{}
+
+template<typename Arg, typename... Args>
+void WriteBinaryLogArgs(Pickle& pickle, const Arg& arg, const Args&... args)
+{
+    BinaryLogArgTraits<std::decay_t<Arg>>::Write(pickle, arg);
+    WriteBinaryLogArgs(pickle, args...);
+}
+
+inline void RecordBinaryLogArgs(FlightRecordPayload&) noexcept
+{}
+
+template<typename Arg, typename... Args>
+void RecordBinaryLogArgs(FlightRecordPayload& payload, const Arg& arg,
+                         const Args&... args) noexcept
+{
+    BinaryLogArgTraits<std::decay_t<Arg>>::Record(payload, arg);
+    RecordBinaryLogArgs(payload, args...);
+}
+
+bool HasBinaryLogFile() noexcept;
+
+// Returns the id of the site; the site definition is emitted before the id is published.
+uint32_t RegisterBinaryLogSite(BinaryLogSite& site, const char* format, const char* arg_types);
+
+// Returns the record buffer of the calling thread, which is reused for every record and has
+// the record kind, the site id, the timestamp and the thread id written already.
+// Returns nullptr if the buffer is unavailable, e.g. the thread is exiting.
+Pickle* BeginBinaryLogRecord(uint32_t site_id);
+
+// Returns false if there is no binary log file to write to.
+bool SubmitBinaryLogRecord(const Pickle& record);
+
+// Logs the message as a text message, with `args` rendered by `ToText()`.
+void LogBinaryLogAsText(const BinaryLogSite& site, const char* format,
+                        const std::vector<std::string>& args);
+
+template<typename... Args>
+void BinaryLog(BinaryLogSite& site, const char* format, const Args&... args)
+{
+    bool is_on = site.log_site.severity >= GetMinSeverityLevel();
+
+    // A message logged as text is recorded as text by `LogMessage`.
+    if (IsFlightRecorderEnabled() && (!is_on || HasBinaryLogFile())) {
+        FlightRecordPayload payload;
+        RecordBinaryLogArgs(payload, args...);
+        RecordFlightBinary(site.log_site, format, BinaryLogArgTypes<Args...>::value, payload);
+    }
+
+    if (!is_on) {
+        return;
+    }
+
+    auto site_id = site.id.load(std::memory_order_acquire);
+    if (site_id == 0) {
+        site_id = RegisterBinaryLogSite(site, format, BinaryLogArgTypes<Args...>::value);
+    }
+
+    if (HasBinaryLogFile()) {
+        auto record = BeginBinaryLogRecord(site_id);
+        if (record) {
+            WriteBinaryLogArgs(*record, args...);
+            if (SubmitBinaryLogRecord(*record)) {
+                return;
+            }
+        }
+    }
+
+    LogBinaryLogAsText(site, format, {BinaryLogArgTraits<std::decay_t<Args>>::ToText(args)...});
+}
+
+// Called by `ConfigureLoggingSettings()`; an empty path disables the binary log file.
+void ConfigureBinaryLogFile(const PathString& path);
+
+}   // namespace internal
+
+}   // namespace kbase
+
+#endif  // KBASE_BINARY_LOGGING_H_
@@ -0,0 +1,210 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef KBASE_CACHE_STATS_H_
+#define KBASE_CACHE_STATS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace kbase {
+
+enum class EvictionReason : size_t {
+    // Evicted to make room, or rejected for weighing more than the cache can hold.
+    Capacity = 0,
+    // The time-to-live of the entry elapsed.
+    Expired,
+    // Erased by the user.
+    Erased,
+    // The entry was replaced by a new one of the same key.
+    Replaced,
+    ReasonCount
+};
+
+// A snapshot of cache statistics.
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t insertions = 0;
+    uint64_t updates = 0;
+    uint64_t evictions[static_cast<size_t>(EvictionReason::ReasonCount)] {};
+    uint64_t peak_size = 0;
+
+    uint64_t eviction_count(EvictionReason reason) const noexcept
+    {
+        return evictions[static_cast<size_t>(reason)];
+    }
+
+    // Returns 0 if there was no lookup.
+    double hit_rate() const noexcept
+    {
+        auto lookups = hits + misses;
+        return lookups == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(lookups);
+    }
+};
+
+// Stats policies of caches, which record events and add themselves to a snapshot.
+// Only lookups marking entries as recently used, i.e. `Get()`, count as hits or misses.
+
+// Records nothing, and costs nothing.
+class NoCacheStats {
+public:
+    void RecordHit() noexcept {}
+
+    void RecordMiss() noexcept {}
+
+    void RecordInsertion(size_t) noexcept {}
+
+    void RecordUpdate() noexcept {}
+
+    void RecordEviction(EvictionReason) noexcept {}
+
+    void AddTo(CacheStats&) const noexcept {}
+};
+
+// Records with plain integers, for caches used by one thread at a time.
+class CacheStatsRecorder {
+public:
+    void RecordHit() noexcept
+    {
+        ++stats_.hits;
+    }
+
+    void RecordMiss() noexcept
+    {
+        ++stats_.misses;
+    }
+
+    // `size` is the number of entries after the insertion.
+    void RecordInsertion(size_t size) noexcept
+    {
+        ++stats_.insertions;
+        if (size > stats_.peak_size) {
+            stats_.peak_size = size;
+        }
+    }
+
+    void RecordUpdate() noexcept
+    {
+        ++stats_.updates;
+    }
+
+    void RecordEviction(EvictionReason reason) noexcept
+    {
+        ++stats_.evictions[static_cast<size_t>(reason)];
+    }
+
+    void AddTo(CacheStats& stats) const noexcept
+    {
+        stats.hits += stats_.hits;
+        stats.misses += stats_.misses;
+        stats.insertions += stats_.insertions;
+        stats.updates += stats_.updates;
+        for (size_t i = 0; i < static_cast<size_t>(EvictionReason::ReasonCount); ++i) {
+            stats.evictions[i] += stats_.evictions[i];
+        }
+
+        stats.peak_size += stats_.peak_size;
+    }
+
+private:
+    CacheStats stats_;
+};
+
+// Records with relaxed atomics, for a part of a concurrent cache, e.g. a segment of
+// `ConcurrentLRUCache`, so that the snapshot can be taken while the cache is in use.
+// Since each part records its own peak size, the peak size of a snapshot adding up parts is an
+// upper bound of the real one.
+class AtomicCacheStatsRecorder {
+public:
+    AtomicCacheStatsRecorder() noexcept = default;
+
+    AtomicCacheStatsRecorder(const AtomicCacheStatsRecorder& other) noexcept
+    {
+        for (size_t i = 0; i < kCounterCount; ++i) {
+            counters_[i].store(other.counters_[i].load(std::memory_order_relaxed),
+                               std::memory_order_relaxed);
+        }
+    }
+
+    AtomicCacheStatsRecorder& operator=(const AtomicCacheStatsRecorder&) = delete;
+
+    void RecordHit() noexcept
+    {
+        Increment(Hits);
+    }
+
+    void RecordMiss() noexcept
+    {
+        Increment(Misses);
+    }
+
+    // `size` is the number of entries after the insertion.
+    void RecordInsertion(size_t size) noexcept
+    {
+        Increment(Insertions);
+        auto& peak = counters_[PeakSize];
+        auto peak_size = peak.load(std::memory_order_relaxed);
+        while (size > peak_size &&
+               !peak.compare_exchange_weak(peak_size, size, std::memory_order_relaxed)) {}
+    }
+
+    void RecordUpdate() noexcept
+    {
+        Increment(Updates);
+    }
+
+    void RecordEviction(EvictionReason reason) noexcept
+    {
+        Increment(Evictions + static_cast<size_t>(reason));
+    }
+
+    void AddTo(CacheStats& stats) const noexcept
+    {
+        stats.hits += Load(Hits);
+        stats.misses += Load(Misses);
+        stats.insertions += Load(Insertions);
+        stats.updates += Load(Updates);
+        for (size_t i = 0; i < static_cast<size_t>(EvictionReason::ReasonCount); ++i) {
+            stats.evictions[i] += Load(Evictions + i);
+        }
+
+        stats.peak_size += Load(PeakSize);
+    }
+
+private:
+    enum Counter : size_t {
+        Hits = 0,
+        Misses,
+        Insertions,
+        Updates,
+        PeakSize,
+        Evictions
+    };
+
+    static constexpr size_t kCounterCount =
+        Evictions + static_cast<size_t>(EvictionReason::ReasonCount);
+
+    void Increment(size_t counter) noexcept
+    {
+        counters_[counter].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t Load(size_t counter) const noexcept
+    {
+        return counters_[counter].load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> counters_[kCounterCount] {};
+};
+
+}   // namespace kbase
+
+#endif  // KBASE_CACHE_STATS_H_
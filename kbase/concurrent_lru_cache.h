@@ -0,0 +1,328 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef KBASE_CONCURRENT_LRU_CACHE_H_
+#define KBASE_CONCURRENT_LRU_CACHE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "kbase/basic_macros.h"
+#include "kbase/cache_stats.h"
+#include "kbase/hash_lru_cache.h"
+
+namespace kbase {
+
+enum class LRUPromotion {
+    // A hit moves the entry to the most recently used end at once, under an exclusive lock.
+    Eager,
+    // A hit only sets the access bit of the entry, under a shared lock; the eviction gives
+    // entries with the bit set a second chance, as the CLOCK algorithm does.
+    Lazy
+};
+
+// A thread-safe LRU cache, which shards entries by their key hashes into segments, each of
+// which is a `HashLRUCache` with a lock of its own.
+// `max_size` is divided evenly among segments, and each segment evicts its own least recently
+// used entry; the eviction therefore approximates the global LRU order.
+// Since entries may be evicted or updated by other threads at any time, lookups copy entries
+// out instead of returning iterators.
+// Each segment records statistics with a `Stats` policy of its own, which is updated under a
+// shared lock as well, and therefore must be `AtomicCacheStatsRecorder` unless `NoCacheStats`;
+// any other policy fails to compile.
+template<typename Key, typename Entry, typename Hash = std::hash<Key>,
+         typename KeyEqual = std::equal_to<Key>, typename Stats = NoCacheStats>
+class ConcurrentLRUCache {
+    static_assert(std::is_same<Stats, NoCacheStats>::value ||
+                  std::is_same<Stats, AtomicCacheStatsRecorder>::value,
+                  "Stats must be NoCacheStats or AtomicCacheStatsRecorder");
+
+private:
+    struct Slot {
+        explicit Slot(const Entry& e)
+            : entry(e), referenced(false)
+        {}
+
+        explicit Slot(Entry&& e)
+            : entry(std::move(e)), referenced(false)
+        {}
+
+        Slot(Slot&& other)
+            : entry(std::move(other.entry)),
+              referenced(other.referenced.load(std::memory_order_relaxed))
+        {}
+
+        Slot& operator=(Slot&& rhs)
+        {
+            entry = std::move(rhs.entry);
+            referenced.store(rhs.referenced.load(std::memory_order_relaxed),
+                             std::memory_order_relaxed);
+            return *this;
+        }
+
+        Entry entry;
+        // Set by readers holding the shared lock.
+        mutable std::atomic<bool> referenced;
+    };
+
+    using SegmentCache = HashLRUCache<Key, Slot, Hash, KeyEqual>;
+
+    struct Segment {
+        Segment(size_t capacity, const Hash& hash, const KeyEqual& key_equal)
+            : max_size(capacity), cache(SegmentCache::NoAutoEvict, hash, key_equal)
+        {}
+
+        mutable std::shared_timed_mutex mutex;
+        size_t max_size;
+        SegmentCache cache;
+        Stats stats;
+    };
+
+public:
+    using key_type = Key;
+    using size_type = size_t;
+
+    enum : size_type {
+        NoAutoEvict = 0
+    };
+
+    // Chooses the number of segments based on the number of processors.
+    enum : size_t {
+        AutoSegmentCount = 0
+    };
+
+    // `segment_count` is rounded up to a power of 2, and is limited by `max_size`.
+    explicit ConcurrentLRUCache(size_type max_size,
+                                size_t segment_count = AutoSegmentCount,
+                                LRUPromotion promotion = LRUPromotion::Eager,
+                                const Hash& hash = Hash(),
+                                const KeyEqual& key_equal = KeyEqual())
+        : max_size_(max_size), promotion_(promotion), hash_(hash)
+    {
+        if (segment_count == AutoSegmentCount) {
+            segment_count = std::max(std::thread::hardware_concurrency(), 1U) * 4;
+        }
+
+        size_t count = 1;
+        while (count < segment_count && (max_size == NoAutoEvict || count * 2 <= max_size)) {
+            count *= 2;
+        }
+
+        auto segment_max_size = max_size == NoAutoEvict ? 0 : (max_size + count - 1) / count;
+        segments_.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            segments_.push_back(std::make_unique<Segment>(segment_max_size, hash, key_equal));
+        }
+    }
+
+    ConcurrentLRUCache(const ConcurrentLRUCache&) = delete;
+
+    ConcurrentLRUCache& operator=(const ConcurrentLRUCache&) = delete;
+
+    // Add a pair of <key, entry> into the cache. If the key already exists, update
+    // the entry.
+    // If the segment of the key runs out its free storage, one of its entries is evicted.
+
+    void Put(const Key& key, const Entry& entry)
+    {
+        PutInternal(key, entry);
+    }
+
+    void Put(const Key& key, Entry&& entry)
+    {
+        PutInternal(key, std::move(entry));
+    }
+
+    // Copies the entry associated with `key` into `entry`, and marks the entry as recently used.
+    // Returns false if no matched entry was found, and `entry` is left intact.
+    bool Get(const Key& key, Entry& entry)
+    {
+        auto& segment = SegmentOf(key);
+        if (promotion_ == LRUPromotion::Lazy) {
+            std::shared_lock<std::shared_timed_mutex> lock(segment.mutex);
+            auto it = segment.cache.find(key);
+            if (it == segment.cache.end()) {
+                segment.stats.RecordMiss();
+                return false;
+            }
+
+            segment.stats.RecordHit();
+            // Avoids dirtying the cache line shared with other readers.
+            if (!it->second.referenced.load(std::memory_order_relaxed)) {
+                it->second.referenced.store(true, std::memory_order_relaxed);
+            }
+
+            entry = it->second.entry;
+            return true;
+        }
+
+        std::lock_guard<std::shared_timed_mutex> lock(segment.mutex);
+        auto it = segment.cache.Get(key);
+        if (it == segment.cache.end()) {
+            segment.stats.RecordMiss();
+            return false;
+        }
+
+        segment.stats.RecordHit();
+        entry = it->second.entry;
+        return true;
+    }
+
+    // Does not mark the entry as recently used.
+    bool Contains(const Key& key) const
+    {
+        auto& segment = SegmentOf(key);
+        std::shared_lock<std::shared_timed_mutex> lock(segment.mutex);
+        return segment.cache.find(key) != segment.cache.end();
+    }
+
+    // Returns true if the entry associated with `key` was erased.
+    bool Erase(const Key& key)
+    {
+        auto& segment = SegmentOf(key);
+        std::lock_guard<std::shared_timed_mutex> lock(segment.mutex);
+        auto it = segment.cache.find(key);
+        if (it == segment.cache.end()) {
+            return false;
+        }
+
+        segment.cache.erase(it);
+        segment.stats.RecordEviction(EvictionReason::Erased);
+        return true;
+    }
+
+    void clear()
+    {
+        for (auto& segment : segments_) {
+            std::lock_guard<std::shared_timed_mutex> lock(segment->mutex);
+            segment->cache.clear();
+        }
+    }
+
+    // Segments are counted one after another, and the result is only a snapshot if other
+    // threads are modifying the cache.
+    size_type size() const
+    {
+        size_type count = 0;
+        for (auto& segment : segments_) {
+            std::shared_lock<std::shared_timed_mutex> lock(segment->mutex);
+            count += segment->cache.size();
+        }
+
+        return count;
+    }
+
+    // The sum of sizes of segments, which may be slightly larger than the one requested.
+    size_type max_size() const noexcept
+    {
+        return max_size_ == NoAutoEvict ? NoAutoEvict : segments_[0]->max_size * segments_.size();
+    }
+
+    bool auto_evict() const noexcept
+    {
+        return max_size_ != NoAutoEvict;
+    }
+
+    size_t segment_count() const noexcept
+    {
+        return segments_.size();
+    }
+
+    LRUPromotion promotion() const noexcept
+    {
+        return promotion_;
+    }
+
+    // Adds up statistics of all segments, without taking their locks; the result is only a
+    // snapshot if other threads are using the cache.
+    CacheStats stats() const
+    {
+        CacheStats snapshot;
+        for (auto& segment : segments_) {
+            segment->stats.AddTo(snapshot);
+        }
+
+        return snapshot;
+    }
+
+private:
+    // The segment cache indexes buckets with high bits of the hash multiplied by a constant;
+    // segments are indexed with low bits of a differently mixed hash, so that keys within a
+    // segment still spread over all its buckets.
+    Segment& SegmentOf(const Key& key) const
+    {
+        auto h = static_cast<uint64_t>(hash_(key));
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        return *segments_[static_cast<size_t>(h) & (segments_.size() - 1)];
+    }
+
+    // Makes room for a new entry with the exclusive lock held.
+    void EvictInSegment(Segment& segment)
+    {
+        auto& cache = segment.cache;
+        if (promotion_ == LRUPromotion::Lazy) {
+            // Every entry is examined at most once, since examined ones lose their bits.
+            for (auto n = cache.size(); n > 0; --n) {
+                auto it = cache.begin();
+                if (!it->second.referenced.load(std::memory_order_relaxed)) {
+                    break;
+                }
+
+                it->second.referenced.store(false, std::memory_order_relaxed);
+                cache.Touch(it);
+            }
+        }
+
+        cache.Evict();
+        segment.stats.RecordEviction(EvictionReason::Capacity);
+    }
+
+    template<typename EntryType>
+    void PutInternal(const Key& key, EntryType&& entry)
+    {
+        auto& segment = SegmentOf(key);
+        std::lock_guard<std::shared_timed_mutex> lock(segment.mutex);
+        auto& cache = segment.cache;
+        auto it = cache.find(key);
+        if (it != cache.end()) {
+            it->second.entry = std::forward<EntryType>(entry);
+            cache.Touch(it);
+            segment.stats.RecordUpdate();
+            segment.stats.RecordEviction(EvictionReason::Replaced);
+            return;
+        }
+
+        if (segment.max_size != 0 && cache.size() == segment.max_size) {
+            EvictInSegment(segment);
+        }
+
+        cache.Put(key, Slot(std::forward<EntryType>(entry)));
+        segment.stats.RecordInsertion(cache.size());
+    }
+
+private:
+    size_type max_size_;
+    LRUPromotion promotion_;
+    Hash hash_;
+    std::vector<std::unique_ptr<Segment>> segments_;
+};
+
+}   // namespace kbase
+
+#endif  // KBASE_CONCURRENT_LRU_CACHE_H_
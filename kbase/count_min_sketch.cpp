@@ -0,0 +1,109 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "kbase/count_min_sketch.h"
+
+namespace {
+
+constexpr int kRows = 4;
+
+constexpr uint64_t kRowSeeds[kRows] {
+    0xC3A5C85C97CB3127ULL, 0xB492B66FBE98F273ULL, 0x9AE16A3B2F90404FULL, 0xCBF29CE484222325ULL
+};
+
+// Clears the high bit of each counter after the whole word was shifted right by 1.
+constexpr uint64_t kHalvingMask = 0x7777777777777777ULL;
+
+// Hashes of integers are usually the integers themselves.
+uint64_t Spread(size_t hash) noexcept
+{
+    auto h = static_cast<uint64_t>(hash);
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Returns the index of the word holding the counter of the row, and the bit offset of the
+// counter in the word.
+size_t LocateCounter(uint64_t spread, int row, size_t table_mask, unsigned& shift) noexcept
+{
+    auto h = (spread + kRowSeeds[row]) * kRowSeeds[row];
+    h += h >> 32;
+    shift = static_cast<unsigned>(h >> 60) * 4;
+    return static_cast<size_t>(h) & table_mask;
+}
+
+}   // namespace
+
+namespace kbase {
+
+constexpr unsigned CountMinSketch::kMaxFrequency;
+
+CountMinSketch::CountMinSketch(size_t expected_entries)
+    : sample_size_(expected_entries < 1 ? 10 : expected_entries * 10)
+{
+    size_t words = 8;
+    while (words < expected_entries) {
+        words *= 2;
+    }
+
+    table_.resize(words);
+}
+
+void CountMinSketch::Increment(size_t hash) noexcept
+{
+    auto spread = Spread(hash);
+    bool added = false;
+    for (int row = 0; row < kRows; ++row) {
+        unsigned shift = 0;
+        auto& word = table_[LocateCounter(spread, row, table_.size() - 1, shift)];
+        if (((word >> shift) & kMaxFrequency) != kMaxFrequency) {
+            word += uint64_t(1) << shift;
+            added = true;
+        }
+    }
+
+    if (added && ++additions_ == sample_size_) {
+        Age();
+    }
+}
+
+unsigned CountMinSketch::Frequency(size_t hash) const noexcept
+{
+    auto spread = Spread(hash);
+    auto frequency = kMaxFrequency;
+    for (int row = 0; row < kRows; ++row) {
+        unsigned shift = 0;
+        auto word = table_[LocateCounter(spread, row, table_.size() - 1, shift)];
+        auto count = static_cast<unsigned>((word >> shift) & kMaxFrequency);
+        if (count < frequency) {
+            frequency = count;
+        }
+    }
+
+    return frequency;
+}
+
+void CountMinSketch::Clear() noexcept
+{
+    for (auto& word : table_) {
+        word = 0;
+    }
+
+    additions_ = 0;
+}
+
+void CountMinSketch::Age() noexcept
+{
+    for (auto& word : table_) {
+        word = (word >> 1) & kHalvingMask;
+    }
+
+    additions_ /= 2;
+}
+
+}   // namespace kbase
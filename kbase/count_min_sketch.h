@@ -0,0 +1,54 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef KBASE_COUNT_MIN_SKETCH_H_
+#define KBASE_COUNT_MIN_SKETCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace kbase {
+
+// A count-min sketch estimating how often a hash was seen recently, with 4-bit counters, i.e.
+// estimates saturate at 15, and 4 rows.
+// Every counter is halved once the number of increments reaches 10 times `expected_entries`,
+// so that the history ages and formerly popular items fade out.
+class CountMinSketch {
+public:
+    static constexpr unsigned kMaxFrequency = 15;
+
+    // The table takes about 8 bytes per expected entry.
+    explicit CountMinSketch(size_t expected_entries);
+
+    // Does nothing once all counters for the hash are saturated.
+    void Increment(size_t hash) noexcept;
+
+    unsigned Frequency(size_t hash) const noexcept;
+
+    void Clear() noexcept;
+
+    // The number of increments after which counters are halved.
+    size_t sample_size() const noexcept
+    {
+        return sample_size_;
+    }
+
+private:
+    void Age() noexcept;
+
+private:
+    // Each word holds 16 counters.
+    std::vector<uint64_t> table_;
+    size_t sample_size_;
+    size_t additions_ = 0;
+};
+
+}   // namespace kbase
+
+#endif  // KBASE_COUNT_MIN_SKETCH_H_
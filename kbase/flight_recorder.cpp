@@ -0,0 +1,656 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "kbase/flight_recorder.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+#include "kbase/stack_walker.h"
+
+#if defined(OS_WIN)
+#include <io.h>
+#elif defined(OS_POSIX)
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using kbase::LogSeverity;
+using kbase::internal::FlightRecordKind;
+using kbase::internal::FlightRecordOutput;
+using kbase::internal::FlightRecordPayload;
+using kbase::internal::kFlightRecordPayloadSize;
+using kbase::internal::LogSite;
+
+// A record is guarded by its version in the manner of a seqlock: the version is odd while the
+// owner thread is writing the record, and a dumper discards a record whose version was odd
+// or has changed during the copying.
+struct FlightRecord {
+    std::atomic<uint32_t> version {0};
+    FlightRecordKind kind = FlightRecordKind::Text;
+    LogSeverity severity = LogSeverity::LogInfo;
+    uint16_t payload_size = 0;
+    int line = 0;
+    const char* file_name = nullptr;
+    const char* format = nullptr;
+    const char* arg_types = nullptr;
+    int64_t timestamp_us = 0;
+    char payload[kFlightRecordPayloadSize];
+};
+
+// Rings are never freed, so that a signal handler can walk the list at any time. A ring is
+// released when its thread exits, and is reused by a later thread.
+struct FlightRing {
+    explicit FlightRing(size_t ring_capacity)
+        : capacity(ring_capacity), records(new FlightRecord[ring_capacity])
+    {}
+
+    FlightRing* next = nullptr;
+    std::atomic<bool> in_use {true};
+    std::atomic<uint64_t> thread_id {0};
+    const size_t capacity;
+    // Only the owner thread advances it.
+    std::atomic<uint64_t> next_index {0};
+    std::unique_ptr<FlightRecord[]> records;
+};
+
+std::atomic<size_t> g_flight_recorder_capacity {0};
+std::atomic<FlightRing*> g_flight_rings {nullptr};
+
+FlightRing* AcquireFlightRing(size_t capacity)
+{
+    for (auto ring = g_flight_rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+        bool in_use = false;
+        if (ring->capacity == capacity && !ring->in_use.load(std::memory_order_relaxed) &&
+            ring->in_use.compare_exchange_strong(in_use, true)) {
+            ring->next_index.store(0, std::memory_order_release);
+            return ring;
+        }
+    }
+
+    auto ring = new FlightRing(capacity);
+    auto head = g_flight_rings.load(std::memory_order_relaxed);
+    do {
+        ring->next = head;
+    } while (!g_flight_rings.compare_exchange_weak(head, ring, std::memory_order_release,
+                                                   std::memory_order_relaxed));
+
+    return ring;
+}
+
+class ThreadFlightRing {
+public:
+    ThreadFlightRing() noexcept = default;
+
+    ~ThreadFlightRing()
+    {
+        if (ring_) {
+            ring_->in_use.store(false, std::memory_order_release);
+        }
+    }
+
+    ThreadFlightRing(const ThreadFlightRing&) = delete;
+
+    ThreadFlightRing& operator=(const ThreadFlightRing&) = delete;
+
+    // Returns null if the recorder is disabled.
+    FlightRing* Get()
+    {
+        auto capacity = g_flight_recorder_capacity.load(std::memory_order_relaxed);
+        if (ring_ && ring_->capacity == capacity) {
+            // The thread id changes in a forked child.
+            auto thread_id = kbase::GetCurrentOSThreadID();
+            if (ring_->thread_id.load(std::memory_order_relaxed) != thread_id) {
+                ring_->thread_id.store(thread_id, std::memory_order_relaxed);
+            }
+
+            return ring_;
+        }
+
+        if (ring_) {
+            ring_->next_index.store(0, std::memory_order_release);
+            ring_->in_use.store(false, std::memory_order_release);
+            ring_ = nullptr;
+        }
+
+        if (capacity != 0) {
+            ring_ = AcquireFlightRing(capacity);
+            ring_->thread_id.store(kbase::GetCurrentOSThreadID(), std::memory_order_relaxed);
+        }
+
+        return ring_;
+    }
+
+private:
+    FlightRing* ring_ = nullptr;
+};
+
+thread_local ThreadFlightRing tls_flight_ring;
+
+int64_t FlightRecorderNowMicroseconds() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void Record(const LogSite& site, FlightRecordKind kind, const char* format,
+            const char* arg_types, const char* payload, size_t payload_size) noexcept
+{
+    FlightRing* ring;
+    try {
+        ring = tls_flight_ring.Get();
+    } catch (...) {
+        return;
+    }
+
+    if (!ring) {
+        return;
+    }
+
+    auto index = ring->next_index.load(std::memory_order_relaxed);
+    auto& record = ring->records[index % ring->capacity];
+    auto version = record.version.load(std::memory_order_relaxed);
+    record.version.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    payload_size = payload_size < kFlightRecordPayloadSize ? payload_size
+                                                           : kFlightRecordPayloadSize;
+    record.kind = kind;
+    record.severity = site.severity;
+    record.payload_size = static_cast<uint16_t>(payload_size);
+    record.line = site.line;
+    record.file_name = site.file_name;
+    record.format = format;
+    record.arg_types = arg_types;
+    record.timestamp_us = FlightRecorderNowMicroseconds();
+    if (payload_size != 0) {
+        memcpy(record.payload, payload, payload_size);
+    }
+
+    record.version.store(version + 2, std::memory_order_release);
+    ring->next_index.store(index + 1, std::memory_order_release);
+}
+
+// Formats into a fixed buffer, and hands full buffers to the output; it neither allocates
+// memory nor calls anything not async-signal-safe.
+class SignalSafeWriter {
+public:
+    SignalSafeWriter(FlightRecordOutput output, void* context) noexcept
+        : output_(output), context_(context)
+    {}
+
+    ~SignalSafeWriter()
+    {
+        Flush();
+    }
+
+    SignalSafeWriter(const SignalSafeWriter&) = delete;
+
+    SignalSafeWriter& operator=(const SignalSafeWriter&) = delete;
+
+    void Append(const char* data, size_t size) noexcept
+    {
+        while (size != 0) {
+            if (size_ == sizeof(buf_)) {
+                Flush();
+            }
+
+            auto count = size < sizeof(buf_) - size_ ? size : sizeof(buf_) - size_;
+            memcpy(buf_ + size_, data, count);
+            size_ += count;
+            data += count;
+            size -= count;
+        }
+    }
+
+    void Append(const char* str) noexcept
+    {
+        Append(str, strlen(str));
+    }
+
+    void Append(char ch) noexcept
+    {
+        Append(&ch, 1);
+    }
+
+    void AppendUnsigned(uint64_t value, int min_digits = 1) noexcept
+    {
+        char digits[20];
+        int count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0 || count < min_digits);
+
+        while (count != 0) {
+            Append(digits[--count]);
+        }
+    }
+
+    void AppendSigned(int64_t value) noexcept
+    {
+        if (value < 0) {
+            Append('-');
+            AppendUnsigned(0 - static_cast<uint64_t>(value));
+        } else {
+            AppendUnsigned(static_cast<uint64_t>(value));
+        }
+    }
+
+    // In fixed notation with 6 decimal places; magnitudes beyond 2^64 are not rendered.
+    void AppendDouble(double value) noexcept
+    {
+        if (value != value) {
+            Append("nan");
+            return;
+        }
+
+        if (value < 0) {
+            Append('-');
+            value = -value;
+        }
+
+        if (value - value != 0) {
+            Append("inf");
+            return;
+        }
+
+        if (value >= 18446744073709551616.0) {
+            Append("<out of range>");
+            return;
+        }
+
+        auto integral = static_cast<uint64_t>(value);
+        auto fraction = static_cast<uint64_t>((value - static_cast<double>(integral)) * 1e6 +
+                                              0.5);
+        if (fraction >= 1000000) {
+            ++integral;
+            fraction -= 1000000;
+        }
+
+        AppendUnsigned(integral);
+        Append('.');
+        AppendUnsigned(fraction, 6);
+    }
+
+    void Flush() noexcept
+    {
+        if (size_ != 0) {
+            output_(context_, buf_, size_);
+            size_ = 0;
+        }
+    }
+
+private:
+    FlightRecordOutput output_;
+    void* context_;
+    char buf_[512];
+    size_t size_ = 0;
+};
+
+template<typename T>
+bool ReadPayloadValue(const char*& cur, const char* end, T& value) noexcept
+{
+    if (static_cast<size_t>(end - cur) < sizeof(value)) {
+        return false;
+    }
+
+    memcpy(&value, cur, sizeof(value));
+    cur += sizeof(value);
+
+    return true;
+}
+
+// Renders the argument of tag `type` at `cur`, or skips it if `writer` is null; returns false
+// if the argument was dropped.
+bool RenderPayloadArg(char type, const char*& cur, const char* end, SignalSafeWriter* writer)
+{
+    switch (type) {
+        case 'b': {
+            bool value;
+            if (!ReadPayloadValue(cur, end, value)) {
+                return false;
+            }
+
+            if (writer) {
+                writer->Append(value ? "true" : "false");
+            }
+
+            return true;
+        }
+
+        case 'c': {
+            char value;
+            if (!ReadPayloadValue(cur, end, value)) {
+                return false;
+            }
+
+            if (writer) {
+                writer->Append(value);
+            }
+
+            return true;
+        }
+
+        case 'i': {
+            int64_t value;
+            if (!ReadPayloadValue(cur, end, value)) {
+                return false;
+            }
+
+            if (writer) {
+                writer->AppendSigned(value);
+            }
+
+            return true;
+        }
+
+        case 'u': {
+            uint64_t value;
+            if (!ReadPayloadValue(cur, end, value)) {
+                return false;
+            }
+
+            if (writer) {
+                writer->AppendUnsigned(value);
+            }
+
+            return true;
+        }
+
+        case 'f': {
+            double value;
+            if (!ReadPayloadValue(cur, end, value)) {
+                return false;
+            }
+
+            if (writer) {
+                writer->AppendDouble(value);
+            }
+
+            return true;
+        }
+
+        case 's': {
+            uint16_t length;
+            if (!ReadPayloadValue(cur, end, length) ||
+                static_cast<size_t>(end - cur) < length) {
+                return false;
+            }
+
+            if (writer) {
+                writer->Append(cur, length);
+            }
+
+            cur += length;
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+void RenderBinaryRecord(const FlightRecord& record, SignalSafeWriter& writer)
+{
+    constexpr size_t kMaxArgs = 16;
+    const char* args[kMaxArgs] {};
+
+    // Locates arguments first, since the format string may refer to them in any order.
+    auto cur = record.payload;
+    auto end = record.payload + record.payload_size;
+    size_t arg_count = 0;
+    for (auto type = record.arg_types; *type && arg_count < kMaxArgs; ++type) {
+        args[arg_count] = cur;
+        if (!RenderPayloadArg(*type, cur, end, nullptr)) {
+            break;
+        }
+
+        ++arg_count;
+    }
+
+    for (auto fmt = record.format; *fmt; ++fmt) {
+        if ((fmt[0] == '{' && fmt[1] == '{') || (fmt[0] == '}' && fmt[1] == '}')) {
+            writer.Append(*fmt++);
+            continue;
+        }
+
+        if (fmt[0] != '{') {
+            writer.Append(*fmt);
+            continue;
+        }
+
+        size_t index = 0;
+        auto placeholder = fmt + 1;
+        while (*placeholder >= '0' && *placeholder <= '9') {
+            index = index * 10 + static_cast<size_t>(*placeholder - '0');
+            ++placeholder;
+        }
+
+        if (*placeholder != '}' || placeholder == fmt + 1) {
+            writer.Append(*fmt);
+            continue;
+        }
+
+        fmt = placeholder;
+        if (index >= arg_count) {
+            writer.Append("<dropped>");
+            continue;
+        }
+
+        auto arg = args[index];
+        RenderPayloadArg(record.arg_types[index], arg, end, &writer);
+    }
+}
+
+void RenderRecord(const FlightRecord& record, SignalSafeWriter& writer)
+{
+    auto seconds = record.timestamp_us / 1000000;
+    auto microseconds = record.timestamp_us % 1000000;
+    writer.Append('[');
+    writer.AppendSigned(seconds);
+    writer.Append('.');
+    writer.AppendUnsigned(static_cast<uint64_t>(microseconds), 6);
+    writer.Append(' ');
+    writer.Append(kbase::internal::LogSeverityName(record.severity));
+    writer.Append(' ');
+    writer.Append(record.file_name);
+    writer.Append('(');
+    writer.AppendSigned(record.line);
+    writer.Append(")]");
+
+    switch (record.kind) {
+        case FlightRecordKind::Text:
+            writer.Append(record.payload, record.payload_size);
+            break;
+
+        case FlightRecordKind::Filtered:
+            writer.Append("<filtered>");
+            break;
+
+        case FlightRecordKind::Binary:
+            RenderBinaryRecord(record, writer);
+            break;
+    }
+
+    writer.Append('\n');
+}
+
+// Copies the record out, if it was not being written.
+bool SnapshotRecord(const FlightRecord& record, FlightRecord& snapshot) noexcept
+{
+    auto version = record.version.load(std::memory_order_acquire);
+    if (version % 2 != 0) {
+        return false;
+    }
+
+    snapshot.kind = record.kind;
+    snapshot.severity = record.severity;
+    snapshot.payload_size = record.payload_size < kFlightRecordPayloadSize ?
+                                record.payload_size :
+                                static_cast<uint16_t>(kFlightRecordPayloadSize);
+    snapshot.line = record.line;
+    snapshot.file_name = record.file_name;
+    snapshot.format = record.format;
+    snapshot.arg_types = record.arg_types;
+    snapshot.timestamp_us = record.timestamp_us;
+    memcpy(snapshot.payload, record.payload, snapshot.payload_size);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return record.version.load(std::memory_order_relaxed) == version;
+}
+
+void WriteToFileDescriptor(void* context, const char* data, size_t size)
+{
+    auto fd = *static_cast<int*>(context);
+    while (size != 0) {
+#if defined(OS_WIN)
+        auto written = _write(fd, data, static_cast<unsigned int>(size));
+#else
+        auto written = write(fd, data, size);
+#endif
+        if (written <= 0) {
+            return;
+        }
+
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+#if defined(OS_POSIX)
+
+struct FatalSignal {
+    int number;
+    const char* name;
+};
+
+constexpr FatalSignal kFatalSignals[] {
+    {SIGSEGV, "SIGSEGV"},
+    {SIGBUS, "SIGBUS"},
+    {SIGFPE, "SIGFPE"},
+    {SIGILL, "SIGILL"},
+    {SIGABRT, "SIGABRT"}
+};
+
+constexpr size_t kAlternateStackSize = 64 * 1024;
+
+alignas(16) char g_alternate_stack[kAlternateStackSize];
+
+void OnFatalSignal(int signal_number)
+{
+    {
+        int fd = STDERR_FILENO;
+        SignalSafeWriter writer(WriteToFileDescriptor, &fd);
+        writer.Append("*** Received fatal signal ");
+        for (const auto& signal : kFatalSignals) {
+            if (signal.number == signal_number) {
+                writer.Append(signal.name);
+            }
+        }
+
+        writer.Append(" ***\n");
+    }
+
+    kbase::StackWalker walker;
+    walker.DumpCallStack(STDERR_FILENO);
+    kbase::DumpFlightRecords(STDERR_FILENO);
+
+    // The signal is blocked until the handler returns, and then it terminates the process.
+    signal(signal_number, SIG_DFL);
+    raise(signal_number);
+}
+
+#endif
+
+}   // namespace
+
+namespace kbase {
+
+void DumpFlightRecords(int fd) noexcept
+{
+    internal::DumpFlightRecords(WriteToFileDescriptor, &fd);
+}
+
+#if defined(OS_POSIX)
+
+void InstallFatalSignalHandler()
+{
+    stack_t alternate_stack {};
+    alternate_stack.ss_sp = g_alternate_stack;
+    alternate_stack.ss_size = sizeof(g_alternate_stack);
+    sigaltstack(&alternate_stack, nullptr);
+
+    // The first `backtrace()` may load libgcc, which allocates memory.
+    StackWalker warm_up;
+    UNUSED_VAR(warm_up);
+
+    struct sigaction action {};
+    action.sa_handler = OnFatalSignal;
+    action.sa_flags = SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    for (const auto& signal : kFatalSignals) {
+        sigaction(signal.number, &action, nullptr);
+    }
+}
+
+#endif
+
+namespace internal {
+
+bool IsFlightRecorderEnabled() noexcept
+{
+    return g_flight_recorder_capacity.load(std::memory_order_relaxed) != 0;
+}
+
+void RecordFlightText(const LogSite& site, const char* text, size_t length) noexcept
+{
+    Record(site, FlightRecordKind::Text, nullptr, nullptr, text, length);
+}
+
+void RecordFlightFiltered(const LogSite& site) noexcept
+{
+    Record(site, FlightRecordKind::Filtered, nullptr, nullptr, nullptr, 0);
+}
+
+void RecordFlightBinary(const LogSite& site, const char* format, const char* arg_types,
+                        const FlightRecordPayload& payload) noexcept
+{
+    Record(site, FlightRecordKind::Binary, format, arg_types, payload.data(), payload.size());
+}
+
+void DumpFlightRecords(FlightRecordOutput output, void* context) noexcept
+{
+    SignalSafeWriter writer(output, context);
+    FlightRecord snapshot;
+    for (auto ring = g_flight_rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+        auto end = ring->next_index.load(std::memory_order_acquire);
+        if (end == 0) {
+            continue;
+        }
+
+        writer.Append("Flight records of thread ");
+        writer.AppendUnsigned(ring->thread_id.load(std::memory_order_relaxed));
+        writer.Append(":\n");
+
+        auto begin = end > ring->capacity ? end - ring->capacity : 0;
+        for (auto index = begin; index < end; ++index) {
+            if (SnapshotRecord(ring->records[index % ring->capacity], snapshot)) {
+                RenderRecord(snapshot, writer);
+            }
+        }
+    }
+}
+
+void ConfigureFlightRecorder(size_t capacity)
+{
+    g_flight_recorder_capacity.store(capacity, std::memory_order_relaxed);
+}
+
+}   // namespace internal
+
+}   // namespace kbase
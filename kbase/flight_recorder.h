@@ -0,0 +1,136 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef KBASE_FLIGHT_RECORDER_H_
+#define KBASE_FLIGHT_RECORDER_H_
+
+#include <cstdint>
+#include <cstring>
+
+#include "kbase/basic_macros.h"
+#include "kbase/logging.h"
+#include "kbase/string_view.h"
+
+namespace kbase {
+
+// The flight recorder keeps the last messages of each thread in memory, including messages
+// filtered out by the severity threshold, so that a crash report carries the context that
+// preceded the crash. It is enabled by `LoggingSettings::flight_recorder_capacity`.
+//
+// No message is formatted for the recorder:
+//   - an admitted `LOG` message has its text copied, since it was formatted anyway;
+//   - a filtered `LOG`, `LOG_IF`, `DLOG` or `DLOG_IF` message records only its call site, as
+//     neither its operands nor its condition are evaluated;
+//   - a `BLOG` message records its format string and raw argument bytes, even if filtered;
+//     arguments of a filtered `BLOG` are therefore evaluated while the recorder is enabled.
+// Long texts and arguments are truncated.
+//
+// Each thread writes into a ring buffer of its own without any lock, and the records are
+// dumped by FATAL messages, next to the callstack, and by the handler installed by
+// `InstallFatalSignalHandler()`.
+
+// Writes records of all threads, each from the oldest to the newest, to the file descriptor.
+// It is async-signal-safe; records being written concurrently are skipped.
+void DumpFlightRecords(int fd) noexcept;
+
+#if defined(OS_POSIX)
+// Installs a handler for SIGSEGV, SIGBUS, SIGFPE, SIGILL and SIGABRT, which writes the callstack
+// and flight records to the standard error stream, and then lets the default action of the
+// signal take place. The calling thread also gets an alternate signal stack, to survive its
+// stack overflow.
+void InstallFatalSignalHandler();
+#endif
+
+namespace internal {
+
+constexpr size_t kFlightRecordPayloadSize = 192;
+
+enum class FlightRecordKind : uint8_t {
+    // The payload is the text of the message.
+    Text,
+    // A message filtered out; the payload is empty.
+    Filtered,
+    // The payload contains arguments for the format string, see `FlightRecordPayload`.
+    Binary
+};
+
+// Arguments of a binary record are encoded per their type tags of `BinaryLogArgTraits`, in
+// native byte order: 'b' and 'c' take 1 byte; 'i', 'u' and 'f' take 8 bytes; and 's' is a
+// uint16_t length followed by the bytes. Arguments not fitting in are dropped.
+class FlightRecordPayload {
+public:
+    FlightRecordPayload() noexcept = default;
+
+    FlightRecordPayload(const FlightRecordPayload&) = delete;
+
+    FlightRecordPayload& operator=(const FlightRecordPayload&) = delete;
+
+    template<typename T>
+    void AppendValue(T value) noexcept
+    {
+        if (sizeof(value) <= kFlightRecordPayloadSize - size_) {
+            memcpy(data_ + size_, &value, sizeof(value));
+            size_ += sizeof(value);
+        } else {
+            size_ = kFlightRecordPayloadSize;
+        }
+    }
+
+    // Truncates the string to the remaining room.
+    void AppendString(StringView str) noexcept
+    {
+        if (kFlightRecordPayloadSize - size_ <= sizeof(uint16_t)) {
+            size_ = kFlightRecordPayloadSize;
+            return;
+        }
+
+        auto room = kFlightRecordPayloadSize - size_ - sizeof(uint16_t);
+        auto length = static_cast<uint16_t>(str.size() < room ? str.size() : room);
+        AppendValue(length);
+        memcpy(data_ + size_, str.data(), length);
+        size_ += length;
+    }
+
+    const char* data() const noexcept
+    {
+        return data_;
+    }
+
+    size_t size() const noexcept
+    {
+        return size_;
+    }
+
+private:
+    char data_[kFlightRecordPayloadSize];
+    size_t size_ = 0;
+};
+
+bool IsFlightRecorderEnabled() noexcept;
+
+void RecordFlightText(const LogSite& site, const char* text, size_t length) noexcept;
+
+void RecordFlightFiltered(const LogSite& site) noexcept;
+
+void RecordFlightBinary(const LogSite& site, const char* format, const char* arg_types,
+                        const FlightRecordPayload& payload) noexcept;
+
+// Receives rendered records in pieces.
+using FlightRecordOutput = void (*)(void* context, const char* data, size_t size);
+
+// Renders records without allocating memory or taking any lock.
+void DumpFlightRecords(FlightRecordOutput output, void* context) noexcept;
+
+// Called by `ConfigureLoggingSettings()`; 0 disables the recorder.
+void ConfigureFlightRecorder(size_t capacity);
+
+}   // namespace internal
+
+}   // namespace kbase
+
+#endif  // KBASE_FLIGHT_RECORDER_H_
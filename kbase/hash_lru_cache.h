@@ -0,0 +1,461 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef KBASE_HASH_LRU_CACHE_H_
+#define KBASE_HASH_LRU_CACHE_H_
+
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "kbase/basic_macros.h"
+#include "kbase/error_exception_util.h"
+
+namespace kbase {
+
+// A hash-based LRU cache with the same interface of `LRUCache`, whose entries are intrusive
+// nodes: each entry is a single allocation, holding the key, the entry, the link of its hash
+// chain and links of the LRU list, and the key is stored only once.
+// The bucket array doubles when the load factor exceeds 1, and thus never grows beyond what
+// `max_size` entries need if auto eviction is enabled.
+template<typename Key, typename Entry, typename Hash = std::hash<Key>,
+         typename KeyEqual = std::equal_to<Key>>
+class HashLRUCache {
+public:
+    using key_type = Key;
+    using value_type = std::pair<const Key, Entry>;
+    using size_type = size_t;
+
+private:
+    struct Link {
+        Link* prev;
+        Link* next;
+    };
+
+    struct Node : Link {
+        template<typename KeyType, typename EntryType>
+        Node(size_t key_hash, KeyType&& key, EntryType&& entry)
+            : value(std::forward<KeyType>(key), std::forward<EntryType>(entry)),
+              hash(key_hash),
+              chain_next(nullptr)
+        {}
+
+        value_type value;
+        size_t hash;
+        Node* chain_next;
+    };
+
+    template<typename T>
+    class Iterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = std::remove_const_t<T>;
+        using difference_type = ptrdiff_t;
+        using pointer = T*;
+        using reference = T&;
+
+        Iterator() noexcept
+            : link_(nullptr)
+        {}
+
+        // Allows converting an iterator to a const_iterator.
+        template<typename U, typename = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+        Iterator(const Iterator<U>& other) noexcept
+            : link_(other.link_)
+        {}
+
+        reference operator*() const noexcept
+        {
+            return static_cast<Node*>(link_)->value;
+        }
+
+        pointer operator->() const noexcept
+        {
+            return &static_cast<Node*>(link_)->value;
+        }
+
+        Iterator& operator++() noexcept
+        {
+            link_ = link_->next;
+            return *this;
+        }
+
+        Iterator operator++(int) noexcept
+        {
+            auto tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        Iterator& operator--() noexcept
+        {
+            link_ = link_->prev;
+            return *this;
+        }
+
+        Iterator operator--(int) noexcept
+        {
+            auto tmp = *this;
+            --*this;
+            return tmp;
+        }
+
+        friend bool operator==(const Iterator& lhs, const Iterator& rhs) noexcept
+        {
+            return lhs.link_ == rhs.link_;
+        }
+
+        friend bool operator!=(const Iterator& lhs, const Iterator& rhs) noexcept
+        {
+            return !(lhs == rhs);
+        }
+
+    private:
+        explicit Iterator(Link* link) noexcept
+            : link_(link)
+        {}
+
+        friend class HashLRUCache;
+
+        template<typename U>
+        friend class Iterator;
+
+    private:
+        Link* link_;
+    };
+
+public:
+    using iterator = Iterator<value_type>;
+    using const_iterator = Iterator<const value_type>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    enum : size_type {
+        NoAutoEvict = 0
+    };
+
+    explicit HashLRUCache(size_type max_size, const Hash& hash = Hash(),
+                          const KeyEqual& key_equal = KeyEqual())
+        : max_size_(max_size), hash_(hash), key_equal_(key_equal)
+    {
+        ResetList();
+    }
+
+    HashLRUCache(HashLRUCache&& other) noexcept
+        : max_size_(other.max_size_),
+          hash_(std::move(other.hash_)),
+          key_equal_(std::move(other.key_equal_))
+    {
+        ResetList();
+        StealFrom(other);
+    }
+
+    HashLRUCache& operator=(HashLRUCache&& rhs) noexcept
+    {
+        if (this != &rhs) {
+            clear();
+            max_size_ = rhs.max_size_;
+            hash_ = std::move(rhs.hash_);
+            key_equal_ = std::move(rhs.key_equal_);
+            StealFrom(rhs);
+        }
+
+        return *this;
+    }
+
+    ~HashLRUCache()
+    {
+        clear();
+    }
+
+    HashLRUCache(const HashLRUCache&) = delete;
+
+    HashLRUCache& operator=(const HashLRUCache&) = delete;
+
+    // Add a pair of <key, entry> into the cache. If the key already exists, update
+    // the entry.
+    // If auto-eviction is enabled for the cache, and also cache runs out its free
+    // storage, then LRU replacement algorithm is employed when caching into new
+    // entry.
+
+    iterator Put(const Key& key, const Entry& entry)
+    {
+        return PutInternal(key, entry);
+    }
+
+    iterator Put(const Key& key, Entry&& entry)
+    {
+        return PutInternal(key, std::move(entry));
+    }
+
+    // Returns the iterator to the value associated with `key`, and marks the entry as recently
+    // used. Returns end() if no matched value was found.
+    iterator Get(const Key& key)
+    {
+        auto node = FindNode(key, hash_(key));
+        if (!node) {
+            return end();
+        }
+
+        MoveToBack(node);
+
+        return iterator(node);
+    }
+
+    // Returns the iterator to the value associated with the `key`.
+    // Returns end() if no such value was found.
+    // These two functions does not touch the entry, i.e. will not mark the entry recently used.
+
+    const_iterator find(const Key& key) const
+    {
+        auto node = FindNode(key, hash_(key));
+        return node ? const_iterator(node) : end();
+    }
+
+    iterator find(const Key& key)
+    {
+        auto node = FindNode(key, hash_(key));
+        return node ? iterator(node) : end();
+    }
+
+    // Marks the entry as recently used, without looking it up again.
+    void Touch(const_iterator pos) noexcept
+    {
+        MoveToBack(pos.link_);
+    }
+
+    // Erases the value with specific iterator, and returns the iterator to
+    // the next value.
+    iterator erase(const_iterator pos)
+    {
+        auto node = static_cast<Node*>(pos.link_);
+        auto next = node->next;
+        UnlinkFromChain(node);
+        UnlinkFromList(node);
+        delete node;
+        --size_;
+
+        return iterator(next);
+    }
+
+    // Evict a single entry, or |count_to_evict| entries from cache.
+
+    void Evict()
+    {
+        erase(begin());
+    }
+
+    void Evict(size_type count_to_evict)
+    {
+        ENSURE(CHECK, count_to_evict <= size())(count_to_evict)(size()).Require();
+        for (size_type i = 0; i < count_to_evict; ++i) {
+            Evict();
+        }
+    }
+
+    void clear() noexcept
+    {
+        for (auto link = head_.next; link != &head_;) {
+            auto node = static_cast<Node*>(link);
+            link = link->next;
+            delete node;
+        }
+
+        ResetList();
+        buckets_.reset();
+        bucket_bits_ = 0;
+        size_ = 0;
+    }
+
+    size_type size() const noexcept
+    {
+        return size_;
+    }
+
+    bool empty() const noexcept
+    {
+        return size_ == 0;
+    }
+
+    size_type max_size() const noexcept
+    {
+        return max_size_;
+    }
+
+    bool auto_evict() const noexcept
+    {
+        return max_size_ != 0;
+    }
+
+    size_type bucket_count() const noexcept
+    {
+        return buckets_ ? size_type(1) << bucket_bits_ : 0;
+    }
+
+    iterator begin() noexcept { return iterator(head_.next); }
+
+    const_iterator begin() const noexcept { return const_iterator(head_.next); }
+
+    const_iterator cbegin() const noexcept { return begin(); }
+
+    iterator end() noexcept { return iterator(&head_); }
+
+    const_iterator end() const noexcept { return const_iterator(const_cast<Link*>(&head_)); }
+
+    const_iterator cend() const noexcept { return end(); }
+
+private:
+    void ResetList() noexcept
+    {
+        head_.prev = &head_;
+        head_.next = &head_;
+    }
+
+    void StealFrom(HashLRUCache& other) noexcept
+    {
+        if (!other.empty()) {
+            head_.next = other.head_.next;
+            head_.prev = other.head_.prev;
+            head_.next->prev = &head_;
+            head_.prev->next = &head_;
+        }
+
+        buckets_ = std::move(other.buckets_);
+        bucket_bits_ = other.bucket_bits_;
+        size_ = other.size_;
+
+        other.ResetList();
+        other.bucket_bits_ = 0;
+        other.size_ = 0;
+    }
+
+    // Fibonacci hashing spreads poorly distributed hashes, e.g. identities of integers.
+    size_t BucketIndex(size_t key_hash) const noexcept
+    {
+        return static_cast<size_t>((static_cast<uint64_t>(key_hash) * 0x9E3779B97F4A7C15ULL) >>
+                                   (64 - bucket_bits_));
+    }
+
+    Node* FindNode(const Key& key, size_t key_hash) const
+    {
+        if (!buckets_) {
+            return nullptr;
+        }
+
+        for (auto node = buckets_[BucketIndex(key_hash)]; node; node = node->chain_next) {
+            if (node->hash == key_hash && key_equal_(node->value.first, key)) {
+                return node;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void LinkToChain(Node* node) noexcept
+    {
+        auto& bucket = buckets_[BucketIndex(node->hash)];
+        node->chain_next = bucket;
+        bucket = node;
+    }
+
+    void UnlinkFromChain(Node* node) noexcept
+    {
+        auto slot = &buckets_[BucketIndex(node->hash)];
+        while (*slot != node) {
+            slot = &(*slot)->chain_next;
+        }
+
+        *slot = node->chain_next;
+    }
+
+    void LinkToBack(Link* link) noexcept
+    {
+        link->prev = head_.prev;
+        link->next = &head_;
+        head_.prev->next = link;
+        head_.prev = link;
+    }
+
+    static void UnlinkFromList(Link* link) noexcept
+    {
+        link->prev->next = link->next;
+        link->next->prev = link->prev;
+    }
+
+    void MoveToBack(Link* link) noexcept
+    {
+        if (link != head_.prev) {
+            UnlinkFromList(link);
+            LinkToBack(link);
+        }
+    }
+
+    // Makes sure there are at least `count` buckets, and re-links existing nodes if the bucket
+    // array was replaced.
+    void ReserveBuckets(size_type count)
+    {
+        if (count <= bucket_count()) {
+            return;
+        }
+
+        // Shifting by all bits of `size_type` is undefined.
+        size_t bits = 4;
+        while (bits + 1 < CHAR_BIT * sizeof(size_type) && (size_type(1) << bits) < count) {
+            ++bits;
+        }
+
+        buckets_.reset(new Node*[size_type(1) << bits]());
+        bucket_bits_ = bits;
+        for (auto link = head_.next; link != &head_; link = link->next) {
+            LinkToChain(static_cast<Node*>(link));
+        }
+    }
+
+    template<typename KeyType, typename EntryType>
+    iterator PutInternal(const KeyType& key, EntryType&& entry)
+    {
+        auto key_hash = hash_(key);
+        auto node = FindNode(key, key_hash);
+        if (node) {
+            node->value.second = std::forward<EntryType>(entry);
+            MoveToBack(node);
+            return iterator(node);
+        }
+
+        if (auto_evict() && max_size() == size()) {
+            Evict();
+        }
+
+        ReserveBuckets(size() + 1);
+
+        node = new Node(key_hash, key, std::forward<EntryType>(entry));
+        LinkToChain(node);
+        LinkToBack(node);
+        ++size_;
+
+        return iterator(node);
+    }
+
+private:
+    size_type max_size_;
+    Hash hash_;
+    KeyEqual key_equal_;
+    // The sentinel of the LRU list; the least recently used entry is at the front.
+    Link head_;
+    std::unique_ptr<Node*[]> buckets_;
+    size_t bucket_bits_ = 0;
+    size_type size_ = 0;
+};
+
+}   // namespace kbase
+
+#endif  // KBASE_HASH_LRU_CACHE_H_
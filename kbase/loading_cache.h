@@ -0,0 +1,267 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef KBASE_LOADING_CACHE_H_
+#define KBASE_LOADING_CACHE_H_
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "kbase/basic_macros.h"
+#include "kbase/chrono_util.h"
+#include "kbase/error_exception_util.h"
+#include "kbase/lru_cache.h"
+
+namespace kbase {
+
+// A thread-safe cache on top of `LRUCache`, which loads missing entries with a loader given
+// by the caller.
+// Loads are coalesced per key: while an entry is being loaded, other callers of the same key
+// wait for the result of that load, rather than calling their loaders as well; if the loader
+// throws, every one of them gets the exception, and nothing is cached.
+// With refresh-ahead, an entry hit within `refresh_ahead` of its expiry is reloaded on a
+// background thread, while the old entry is still served until the reload completes; a failed
+// reload leaves the old entry to expire as usual.
+// Entries are returned by value, since they may be evicted or reloaded at any time.
+template<typename Key, typename Entry, template<typename, typename> class Map = TreeMap>
+class LoadingCache {
+public:
+    using key_type = Key;
+    using size_type = size_t;
+    using Loader = std::function<Entry(const Key&)>;
+    using ClockSource = std::function<TimePoint()>;
+    using TimeToLive = Clock::duration;
+
+private:
+    struct LoadedEntry {
+        Entry entry;
+        // When a hit triggers a reload.
+        TimePoint refresh_time;
+    };
+
+    using Flight = std::shared_future<Entry>;
+    using FlightTable = typename Map<Key, Flight>::MapType;
+
+    struct Refresh {
+        Key key;
+        Loader loader;
+        std::promise<Entry> promise;
+    };
+
+public:
+    // A zero `ttl` means entries never expire, and a zero `refresh_ahead` disables
+    // refresh-ahead, which requires `refresh_ahead` being less than `ttl`.
+    explicit LoadingCache(size_type max_size,
+                          TimeToLive ttl = TimeToLive::zero(),
+                          TimeToLive refresh_ahead = TimeToLive::zero())
+        : ttl_(ttl), refresh_ahead_(refresh_ahead), clock_(&Clock::now), cache_(max_size)
+    {
+        ENSURE(CHECK, refresh_ahead == TimeToLive::zero() ||
+                      (ttl != TimeToLive::zero() && refresh_ahead < ttl)).Require();
+        cache_.set_default_ttl(ttl);
+    }
+
+    // Pending reloads are abandoned, and their waiters get `std::future_error`.
+    ~LoadingCache()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+            refresh_cv_.notify_one();
+        }
+
+        if (refresher_.joinable()) {
+            refresher_.join();
+        }
+    }
+
+    LoadingCache(const LoadingCache&) = delete;
+
+    LoadingCache& operator=(const LoadingCache&) = delete;
+
+    // Returns the entry associated with `key`, which is loaded by `loader` and cached if it
+    // is not in the cache, unless a load of the key is in progress already, in which case waits
+    // for that load instead.
+    // Rethrows the exception from the loader.
+    Entry Get(const Key& key, const Loader& loader)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = cache_.Get(key);
+        if (it != cache_.end()) {
+            if (refresh_ahead_ != TimeToLive::zero() && it->second.refresh_time <= clock_()) {
+                ScheduleRefresh(key, loader);
+            }
+
+            return it->second.entry;
+        }
+
+        auto flight_it = flights_.find(key);
+        if (flight_it != flights_.end()) {
+            auto flight = flight_it->second;
+            lock.unlock();
+            return flight.get();
+        }
+
+        std::promise<Entry> promise;
+        flights_.insert({key, promise.get_future().share()});
+        lock.unlock();
+
+        return Load(key, loader, promise);
+    }
+
+    // Returns true if the entry was cached; a load in progress is not affected.
+    bool Invalidate(const Key& key)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = cache_.find(key);
+        if (it == cache_.end()) {
+            return false;
+        }
+
+        cache_.erase(it);
+        return true;
+    }
+
+    // Blocks until all reloads scheduled so far have completed.
+    void WaitForRefreshes()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_cv_.wait(lock, [this] {
+            return refreshes_.empty() && running_refreshes_ == 0;
+        });
+    }
+
+    size_type size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return cache_.size();
+    }
+
+    size_type max_size() const
+    {
+        return cache_.max_size();
+    }
+
+    TimeToLive ttl() const noexcept
+    {
+        return ttl_;
+    }
+
+    TimeToLive refresh_ahead() const noexcept
+    {
+        return refresh_ahead_;
+    }
+
+    // Replaces `Clock::now()` as the source of the current time, e.g. with a fake clock.
+    // It must be set before the cache is used, and `clock` must be thread-safe.
+    void set_clock(ClockSource clock)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        clock_ = clock;
+        cache_.set_clock(std::move(clock));
+    }
+
+private:
+    // Runs the loader without the lock held, and then publishes the result to the cache and
+    // to waiters.
+    Entry Load(const Key& key, const Loader& loader, std::promise<Entry>& promise)
+    {
+        try {
+            auto entry = loader(key);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto refresh_time = refresh_ahead_ == TimeToLive::zero() ?
+                                        TimePoint::max() : clock_() + (ttl_ - refresh_ahead_);
+                cache_.Put(key, LoadedEntry{entry, refresh_time});
+                flights_.erase(key);
+            }
+
+            promise.set_value(entry);
+            return entry;
+        } catch (...) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                flights_.erase(key);
+            }
+
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+    }
+
+    // Requires `mutex_` being held.
+    void ScheduleRefresh(const Key& key, const Loader& loader)
+    {
+        if (stopping_ || flights_.find(key) != flights_.end()) {
+            return;
+        }
+
+        std::promise<Entry> promise;
+        flights_.insert({key, promise.get_future().share()});
+        refreshes_.push_back(Refresh{key, loader, std::move(promise)});
+        if (!refresher_.joinable()) {
+            refresher_ = std::thread(&LoadingCache::RunRefresher, this);
+        }
+
+        refresh_cv_.notify_one();
+    }
+
+    void RunRefresher()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            refresh_cv_.wait(lock, [this] { return stopping_ || !refreshes_.empty(); });
+            if (stopping_) {
+                break;
+            }
+
+            auto refresh = std::move(refreshes_.front());
+            refreshes_.pop_front();
+            ++running_refreshes_;
+            lock.unlock();
+
+            try {
+                Load(refresh.key, refresh.loader, refresh.promise);
+            } catch (...) {
+                // Waiters have got the exception.
+            }
+
+            lock.lock();
+            --running_refreshes_;
+            idle_cv_.notify_all();
+        }
+
+        refreshes_.clear();
+        idle_cv_.notify_all();
+    }
+
+private:
+    const TimeToLive ttl_;
+    const TimeToLive refresh_ahead_;
+    mutable std::mutex mutex_;
+    ClockSource clock_;
+    LRUCache<Key, LoadedEntry, Map> cache_;
+    // Loads in progress.
+    FlightTable flights_;
+    std::deque<Refresh> refreshes_;
+    size_t running_refreshes_ = 0;
+    bool stopping_ = false;
+    std::condition_variable refresh_cv_;
+    std::condition_variable idle_cv_;
+    std::thread refresher_;
+};
+
+}   // namespace kbase
+
+#endif  // KBASE_LOADING_CACHE_H_
@@ -0,0 +1,370 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "kbase/log_sink.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+#include "kbase/async_log_writer.h"
+#include "kbase/basic_macros.h"
+
+#if defined(OS_WIN)
+#include <Windows.h>
+#elif defined(OS_POSIX)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using kbase::LogRecord;
+using kbase::LogSink;
+using kbase::LogSinkMode;
+using kbase::internal::AsyncLogWriter;
+
+constexpr size_t kSinkBufferCapacity = 1024;
+
+struct SinkEntry {
+    std::shared_ptr<LogSink> sink;
+    // Non-null only if the sink is asynchronous.
+    std::unique_ptr<AsyncLogWriter> writer;
+};
+
+using SinkSnapshot = std::vector<SinkEntry*>;
+
+// The sink list is published as an immutable snapshot, and dispatching threads read it without
+// any lock, in the manner of a minimal RCU: a dispatcher announces itself in one of the two
+// reader counters, selected by the parity of the epoch, before loading the snapshot.
+// Once a new snapshot is published, the writer flips the epoch and waits for the counter of
+// the previous parity to drain, twice, so that every reader that might still hold the old
+// snapshot has left, while new readers never hold it up.
+
+// Guards modifying the sink list.
+std::mutex g_sinks_mutex;
+std::vector<std::unique_ptr<SinkEntry>> g_sink_entries;
+
+std::atomic<const SinkSnapshot*> g_sink_snapshot {nullptr};
+std::atomic<unsigned> g_sink_epoch {0};
+std::atomic<size_t> g_sink_readers[2] {};
+
+// Requires `g_sinks_mutex` being held.
+void WaitForSinkReadersLocked()
+{
+    for (int i = 0; i < 2; ++i) {
+        auto epoch = g_sink_epoch.fetch_add(1);
+        auto& readers = g_sink_readers[epoch & 1];
+        while (readers.load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// Requires `g_sinks_mutex` being held.
+void PublishSinkSnapshotLocked()
+{
+    const SinkSnapshot* snapshot = nullptr;
+    if (!g_sink_entries.empty()) {
+        auto entries = new SinkSnapshot();
+        for (const auto& entry : g_sink_entries) {
+            entries->push_back(entry.get());
+        }
+
+        snapshot = entries;
+    }
+
+    auto old_snapshot = g_sink_snapshot.exchange(snapshot);
+    WaitForSinkReadersLocked();
+    delete old_snapshot;
+}
+
+void SendToSink(LogSink& sink, const AsyncLogWriter::Record* records, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const auto& record = records[i];
+        sink.Send(LogRecord {record.severity, record.file_name, record.line,
+                             record.message.c_str(), record.message.length()});
+    }
+}
+
+// Other threads may still be logging during the teardown, thus stopped writers are kept;
+// messages since now would be sent synchronously.
+void StopAsyncSinksAtExit()
+{
+    std::lock_guard<std::mutex> lock(g_sinks_mutex);
+    for (const auto& entry : g_sink_entries) {
+        if (entry->writer) {
+            entry->writer->Stop();
+        }
+    }
+}
+
+class SinkReaderScope {
+public:
+    SinkReaderScope() noexcept
+        : readers_(g_sink_readers[g_sink_epoch.load() & 1])
+    {
+        readers_.fetch_add(1);
+    }
+
+    ~SinkReaderScope()
+    {
+        readers_.fetch_sub(1);
+    }
+
+    SinkReaderScope(const SinkReaderScope&) = delete;
+
+    SinkReaderScope& operator=(const SinkReaderScope&) = delete;
+
+private:
+    std::atomic<size_t>& readers_;
+};
+
+}   // namespace
+
+namespace kbase {
+
+LogSink::LogSink(LogSeverity min_severity, LogSinkMode mode) noexcept
+    : min_severity_(min_severity), mode_(mode)
+{}
+
+// -*- FileLogSink -*-
+
+FileLogSink::FileLogSink(const PathString& file_path, LogSeverity min_severity,
+                         LogSinkMode mode)
+    : LogSink(min_severity, mode)
+{
+#if defined(OS_WIN)
+    file_ = CreateFileW(file_path.c_str(),
+                        FILE_APPEND_DATA,
+                        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                        nullptr,
+                        OPEN_ALWAYS,
+                        FILE_ATTRIBUTE_NORMAL,
+                        nullptr);
+#else
+    file_ = open(file_path.c_str(), O_CREAT | O_WRONLY | O_APPEND, 0666);
+#endif
+}
+
+FileLogSink::~FileLogSink()
+{
+    if (!is_open()) {
+        return;
+    }
+
+#if defined(OS_WIN)
+    CloseHandle(file_);
+#else
+    close(file_);
+#endif
+}
+
+bool FileLogSink::is_open() const noexcept
+{
+#if defined(OS_WIN)
+    return file_ != INVALID_HANDLE_VALUE && file_ != nullptr;
+#else
+    return file_ != -1;
+#endif
+}
+
+void FileLogSink::Send(const LogRecord& record)
+{
+    if (!is_open()) {
+        return;
+    }
+
+#if defined(OS_WIN)
+    DWORD bytes_written = 0;
+    WriteFile(file_, record.message, static_cast<DWORD>(record.length), &bytes_written,
+              nullptr);
+#else
+    IGNORE_RESULT(write(file_, record.message, record.length));
+#endif
+}
+
+// -*- StderrLogSink -*-
+
+StderrLogSink::StderrLogSink(LogSeverity min_severity, LogSinkMode mode) noexcept
+    : LogSink(min_severity, mode)
+{}
+
+void StderrLogSink::Send(const LogRecord& record)
+{
+    fwrite(record.message, sizeof(char), record.length, stderr);
+}
+
+void StderrLogSink::Flush()
+{
+    fflush(stderr);
+}
+
+// -*- RingBufferLogSink -*-
+
+RingBufferLogSink::RingBufferLogSink(size_t capacity, LogSeverity min_severity)
+    : LogSink(min_severity, LogSinkMode::Synchronous),
+      capacity_(std::max<size_t>(capacity, 1)),
+      slots_(new Slot[capacity_]),
+      next_sequence_(0)
+{}
+
+void RingBufferLogSink::Send(const LogRecord& record)
+{
+    auto sequence = next_sequence_.fetch_add(1, std::memory_order_relaxed) + 1;
+    auto& slot = slots_[(sequence - 1) % capacity_];
+    while (slot.busy.exchange(true, std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+
+    // A slower sender of an older message must not overwrite a newer one.
+    if (slot.sequence < sequence) {
+        slot.sequence = sequence;
+        slot.message.assign(record.message, record.length);
+    }
+
+    slot.busy.store(false, std::memory_order_release);
+}
+
+std::vector<std::string> RingBufferLogSink::GetMessages() const
+{
+    std::vector<std::pair<uint64_t, std::string>> kept;
+    for (size_t i = 0; i < capacity_; ++i) {
+        auto& slot = slots_[i];
+        while (slot.busy.exchange(true, std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+
+        if (slot.sequence != 0) {
+            kept.emplace_back(slot.sequence, slot.message);
+        }
+
+        slot.busy.store(false, std::memory_order_release);
+    }
+
+    std::sort(kept.begin(), kept.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first < rhs.first;
+    });
+
+    std::vector<std::string> messages;
+    messages.reserve(kept.size());
+    for (auto& message : kept) {
+        messages.push_back(std::move(message.second));
+    }
+
+    return messages;
+}
+
+void AddLogSink(std::shared_ptr<LogSink> sink)
+{
+    std::lock_guard<std::mutex> lock(g_sinks_mutex);
+    auto it = std::find_if(g_sink_entries.begin(), g_sink_entries.end(),
+                           [&sink](const auto& entry) {
+                               return entry->sink == sink;
+                           });
+    if (it != g_sink_entries.end()) {
+        return;
+    }
+
+    auto entry = std::make_unique<SinkEntry>();
+    entry->sink = std::move(sink);
+    if (entry->sink->mode() == LogSinkMode::Asynchronous) {
+        static bool exit_handler_registered = false;
+        if (!exit_handler_registered) {
+            std::atexit(StopAsyncSinksAtExit);
+            exit_handler_registered = true;
+        }
+
+        auto raw_sink = entry->sink.get();
+        entry->writer = std::make_unique<AsyncLogWriter>(
+            kSinkBufferCapacity,
+            AsyncOverflowPolicy::BlockOnOverflow,
+            [raw_sink](const AsyncLogWriter::Record* records, size_t count) {
+                SendToSink(*raw_sink, records, count);
+            });
+    }
+
+    g_sink_entries.push_back(std::move(entry));
+    PublishSinkSnapshotLocked();
+}
+
+void RemoveLogSink(const std::shared_ptr<LogSink>& sink)
+{
+    std::unique_ptr<SinkEntry> removed;
+    {
+        std::lock_guard<std::mutex> lock(g_sinks_mutex);
+        auto it = std::find_if(g_sink_entries.begin(), g_sink_entries.end(),
+                               [&sink](const auto& entry) {
+                                   return entry->sink == sink;
+                               });
+        if (it == g_sink_entries.end()) {
+            return;
+        }
+
+        removed = std::move(*it);
+        g_sink_entries.erase(it);
+        PublishSinkSnapshotLocked();
+    }
+
+    if (removed->writer) {
+        removed->writer->Stop();
+    }
+}
+
+namespace internal {
+
+void DispatchToLogSinks(const LogRecord& record)
+{
+    // Not to bother reader counters if no sink was ever registered.
+    if (!g_sink_snapshot.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    SinkReaderScope reader_scope;
+    auto snapshot = g_sink_snapshot.load();
+    if (!snapshot) {
+        return;
+    }
+
+    for (auto entry : *snapshot) {
+        if (record.severity < entry->sink->min_severity()) {
+            continue;
+        }
+
+        if (!entry->writer) {
+            entry->sink->Send(record);
+            continue;
+        }
+
+        entry->writer->Append(record);
+        if (record.severity == LogSeverity::LogFatal) {
+            // Don't lose any of them if we were about to crash.
+            entry->writer->Flush();
+        }
+    }
+}
+
+void FlushLogSinks()
+{
+    SinkReaderScope reader_scope;
+    auto snapshot = g_sink_snapshot.load();
+    if (!snapshot) {
+        return;
+    }
+
+    for (auto entry : *snapshot) {
+        if (entry->writer) {
+            entry->writer->Flush();
+        }
+
+        entry->sink->Flush();
+    }
+}
+
+}   // namespace internal
+
+}   // namespace kbase
@@ -0,0 +1,155 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef KBASE_LOG_SINK_H_
+#define KBASE_LOG_SINK_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kbase/basic_types.h"
+#include "kbase/logging.h"
+
+namespace kbase {
+
+enum class LogSinkMode {
+    // Messages are sent on logging threads, maybe concurrently.
+    Synchronous,
+    // Messages are sent in order on a dedicated thread of the sink.
+    Asynchronous
+};
+
+// A log sink receives every finished message, in addition to destinations configured by
+// `LoggingSettings`, as long as the message is not below the minimum severity of the sink.
+// Sinks are registered and removed at runtime; dispatching messages to them never takes
+// a lock.
+class LogSink {
+public:
+    explicit LogSink(LogSeverity min_severity = LogSeverity::LogInfo,
+                     LogSinkMode mode = LogSinkMode::Synchronous) noexcept;
+
+    virtual ~LogSink() = default;
+
+    LogSink(const LogSink&) = delete;
+
+    LogSink& operator=(const LogSink&) = delete;
+
+    LogSink(LogSink&&) = delete;
+
+    LogSink& operator=(LogSink&&) = delete;
+
+    virtual void Send(const LogRecord& record) = 0;
+
+    // Called by `FlushLogging()`, after pending messages of an asynchronous sink are sent.
+    virtual void Flush()
+    {}
+
+    LogSeverity min_severity() const noexcept
+    {
+        return min_severity_.load(std::memory_order_relaxed);
+    }
+
+    // It is safe to call at any time.
+    void set_min_severity(LogSeverity severity) noexcept
+    {
+        min_severity_.store(severity, std::memory_order_relaxed);
+    }
+
+    LogSinkMode mode() const noexcept
+    {
+        return mode_;
+    }
+
+private:
+    std::atomic<LogSeverity> min_severity_;
+    const LogSinkMode mode_;
+};
+
+// Appends messages to a file of its own.
+class FileLogSink : public LogSink {
+public:
+    explicit FileLogSink(const PathString& file_path,
+                         LogSeverity min_severity = LogSeverity::LogInfo,
+                         LogSinkMode mode = LogSinkMode::Asynchronous);
+
+    ~FileLogSink();
+
+    void Send(const LogRecord& record) override;
+
+    bool is_open() const noexcept;
+
+private:
+#if defined(OS_WIN)
+    void* file_;
+#else
+    int file_;
+#endif
+};
+
+// Writes messages to the standard error stream.
+class StderrLogSink : public LogSink {
+public:
+    explicit StderrLogSink(LogSeverity min_severity = LogSeverity::LogInfo,
+                           LogSinkMode mode = LogSinkMode::Synchronous) noexcept;
+
+    void Send(const LogRecord& record) override;
+
+    void Flush() override;
+};
+
+// Keeps the last `capacity` messages in memory, e.g. for crash dumps.
+// Each slot has its own spin flag, so concurrent senders rarely contend.
+class RingBufferLogSink : public LogSink {
+public:
+    explicit RingBufferLogSink(size_t capacity,
+                               LogSeverity min_severity = LogSeverity::LogInfo);
+
+    void Send(const LogRecord& record) override;
+
+    // Returns kept messages, from the oldest to the newest.
+    std::vector<std::string> GetMessages() const;
+
+    size_t capacity() const noexcept
+    {
+        return capacity_;
+    }
+
+private:
+    struct Slot {
+        std::atomic<bool> busy {false};
+        // 0 means empty; otherwise the 1-based sequence number of the message.
+        uint64_t sequence = 0;
+        std::string message;
+    };
+
+    size_t capacity_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> next_sequence_;
+};
+
+// Registers a sink; registering the same sink more than once has no effect.
+void AddLogSink(std::shared_ptr<LogSink> sink);
+
+// Unregisters a sink. When the function returns, no thread is sending messages to the sink,
+// and pending messages of an asynchronous sink have been sent.
+void RemoveLogSink(const std::shared_ptr<LogSink>& sink);
+
+namespace internal {
+
+// Called for each finished message.
+void DispatchToLogSinks(const LogRecord& record);
+
+void FlushLogSinks();
+
+}   // namespace internal
+
+}   // namespace kbase
+
+#endif  // KBASE_LOG_SINK_H_
@@ -4,18 +4,41 @@
 
 #include "kbase/logging.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
 #include <thread>
+#include <utility>
+#include <vector>
 
+#include "kbase/async_log_writer.h"
 #include "kbase/basic_macros.h"
+#include "kbase/binary_logging.h"
 #include "kbase/chrono_util.h"
+#include "kbase/flight_recorder.h"
+#include "kbase/log_sink.h"
+#include "kbase/scope_guard.h"
+#include "kbase/secure_c_runtime.h"
 #include "kbase/stack_walker.h"
+#include "kbase/string_util.h"
 
 #if defined(OS_WIN)
 #include <Windows.h>
 #elif defined(OS_POSIX)
+#include <dirent.h>
 #include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #endif
 
@@ -24,7 +47,10 @@ namespace {
 using kbase::LogSeverity;
 using kbase::LogItemOptions;
 using kbase::LoggingDestination;
+using kbase::LoggingSettings;
+using kbase::LogRotationInterval;
 using kbase::OldFileDisposalOption;
+using kbase::internal::AsyncLogWriter;
 
 using kbase::PathChar;
 using kbase::PathString;
@@ -41,53 +67,191 @@ constexpr const char* kLogSeverityNames[] {"INFO", "WARNING", "ERROR", "FATAL"};
 
 constexpr LogSeverity kAlwaysPrintErrorMinLevel = LogSeverity::LogError;
 
-LogSeverity g_min_severity_level = LogSeverity::LogInfo;
+constexpr size_t kDefaultAsyncBufferCapacity = 8192;
+
+// A spilled buffer larger than this is released once its message is done, rather than
+// being kept for the thread.
+constexpr size_t kMaxRetainedSpilledBufferSize = 64 * 1024;
+
+std::atomic<LogSeverity> g_min_severity_level {LogSeverity::LogInfo};
 LogItemOptions g_log_item_options = LogItemOptions::EnableTimestamp;
 LoggingDestination g_logging_dest = LoggingDestination::LogToFile;
 OldFileDisposalOption g_old_file_option = OldFileDisposalOption::AppendToOldFile;
 
+// Guards opening, swapping and closing the log file, as well as `g_log_file_path`; writers
+// never take it once the file is open.
+std::mutex g_log_file_mutex;
 PathString g_log_file_path;
-FileHandle g_log_file = kInvalidFileHandle;
 
-// Ouputs timestamp in the form like "20160126 09:14:38,456".
-void OutputNowTimestamp(std::ostream& stream)
+// The handle is replaced on the fly when the file is rotated or reopened.
+std::atomic<FileHandle> g_log_file {kInvalidFileHandle};
+
+// On Windows, a swapped-out handle is closed at the next swap, when no writer could still be
+// using it.
+FileHandle g_retired_log_file {kInvalidFileHandle};
+
+// Set by `RequestLogFileReopen()`, which may run in a signal handler.
+std::atomic<bool> g_log_file_reopen_requested {false};
+
+// Guards verbose levels and the list of resolved VLOG sites.
+std::mutex g_verbosity_mutex;
+int g_verbose_level = 0;
+std::vector<std::pair<std::string, int>> g_verbose_module_levels;
+kbase::internal::VLogSite* g_vlog_sites = nullptr;
+
+// Non-null only if async logging is enabled.
+std::atomic<AsyncLogWriter*> g_async_writer {nullptr};
+
+class LogFileRotator;
+
+// Non-null only if log file rotation is enabled.
+std::atomic<LogFileRotator*> g_log_file_rotator {nullptr};
+
+// Each thread reuses its own log stream; the holder is destroyed on thread exit, after which
+// messages from the thread, e.g. in destructors of other thread-local objects, would use
+// a dedicated stream instead.
+thread_local bool tls_log_stream_busy = false;
+thread_local bool tls_log_stream_destroyed = false;
+
+struct ThreadLogStreamHolder {
+    ~ThreadLogStreamHolder()
+    {
+        tls_log_stream_destroyed = true;
+    }
+
+    kbase::internal::LogStream stream;
+};
+
+// Returns nullptr if the stream of the thread is unavailable.
+kbase::internal::LogStream* AcquireThreadLogStream()
 {
-    auto explode = kbase::TimePointToLocalTimeExplode<std::chrono::milliseconds>(
-        std::chrono::system_clock::now());
-    char buf[32] {0};
-    snprintf(buf, sizeof(buf), "%4d%02d%02d %02d:%02d:%02d,%03d", explode.year, explode.month,
-             explode.day_of_month, explode.hour, explode.minute, explode.second,
-             static_cast<int>(explode.remainder));
-    stream << buf;
+    if (tls_log_stream_busy || tls_log_stream_destroyed) {
+        return nullptr;
+    }
+
+    thread_local ThreadLogStreamHolder holder;
+    tls_log_stream_busy = true;
+    holder.stream.Reset();
+
+    return &holder.stream;
 }
 
-template<typename charT>
-constexpr const charT* ExtractFileName(const charT* file_path)
+void ReleaseThreadLogStream()
 {
-    const charT* p = file_path;
-    const charT* last_pos = nullptr;
-    for (; *p != '\0'; ++p) {
-        if (*p == '/' || *p == '\\') {
-            last_pos = p;
-        }
+    tls_log_stream_busy = false;
+}
+
+// The date and time part of the timestamp changes at most once a second, thus each thread
+// caches its rendered text, and patches only the millisecond part for every message.
+struct TimestampCache {
+    int64_t seconds_since_epoch;
+    size_t prefix_length;   // length of the "YYYYmmdd HH:MM:SS," part.
+    char text[32];
+};
+
+thread_local TimestampCache tls_timestamp_cache {std::numeric_limits<int64_t>::min(), 0, {0}};
+
+// Ouputs timestamp in the form like "20160126 09:14:38,456".
+void OutputNowTimestamp(std::ostream& stream)
+{
+    namespace chrono = std::chrono;
+
+    auto ms_since_epoch = chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+    auto seconds_since_epoch = ms_since_epoch / 1000;
+    auto ms_part = static_cast<int>(ms_since_epoch % 1000);
+    if (ms_part < 0) {
+        --seconds_since_epoch;
+        ms_part += 1000;
     }
 
-    return last_pos ? last_pos + 1 : file_path;
+    auto& cache = tls_timestamp_cache;
+    if (cache.seconds_since_epoch != seconds_since_epoch) {
+        auto explode = kbase::TimePointToLocalTimeExplode(
+            std::chrono::system_clock::from_time_t(static_cast<time_t>(seconds_since_epoch)));
+        int length = snprintf(cache.text, sizeof(cache.text), "%4d%02d%02d %02d:%02d:%02d,",
+                              explode.year, explode.month, explode.day_of_month, explode.hour,
+                              explode.minute, explode.second);
+        cache.prefix_length = static_cast<size_t>(length);
+        cache.seconds_since_epoch = seconds_since_epoch;
+    }
+
+    char* ms_text = cache.text + cache.prefix_length;
+    ms_text[0] = static_cast<char>('0' + ms_part / 100);
+    ms_text[1] = static_cast<char>('0' + ms_part / 10 % 10);
+    ms_text[2] = static_cast<char>('0' + ms_part % 10);
+
+    stream.write(cache.text, static_cast<std::streamsize>(cache.prefix_length + 3));
 }
 
-#if defined(OS_WIN)
-using ProcessID = DWORD;
-#else
-using ProcessID = pid_t;
+// Each thread renders its " pid tid" header items once, and renders them again only if the
+// process has forked since then, in which case both ids of the child thread are new.
+struct ThreadIdentityCache {
+    unsigned fork_generation;
+    uint64_t process_id;
+    uint64_t thread_id;
+    size_t pid_length;      // length of the " pid" part.
+    size_t text_length;
+    char text[48];
+};
+
+// Starts from 1, thus a zero-initialized cache is always stale.
+std::atomic<unsigned> g_fork_generation {1};
+
+thread_local ThreadIdentityCache tls_identity_cache {0, 0, 0, 0, 0, {0}};
+
+#if defined(OS_POSIX)
+void OnForkedChild()
+{
+    g_fork_generation.fetch_add(1, std::memory_order_relaxed);
+}
 #endif
 
-ProcessID GetCurrentProcessID()
+const ThreadIdentityCache& CurrentThreadIdentity()
 {
+    auto& cache = tls_identity_cache;
+    auto generation = g_fork_generation.load(std::memory_order_relaxed);
+    if (cache.fork_generation == generation) {
+        return cache;
+    }
+
 #if defined(OS_WIN)
-    return GetCurrentProcessId();
+    cache.process_id = GetCurrentProcessId();
+    cache.thread_id = GetCurrentThreadId();
 #else
-    return getpid();
+    // No cache was filled before the registration, therefore none is missed by a fork.
+    static const bool fork_handler_registered =
+        pthread_atfork(nullptr, nullptr, OnForkedChild) == 0;
+    UNUSED_VAR(fork_handler_registered);
+
+    cache.process_id = static_cast<uint64_t>(getpid());
+    cache.thread_id = static_cast<uint64_t>(syscall(SYS_gettid));
 #endif
+
+    int pid_length = snprintf(cache.text, sizeof(cache.text), " %llu",
+                              static_cast<unsigned long long>(cache.process_id));
+    int tid_length = snprintf(cache.text + pid_length, sizeof(cache.text) - pid_length, " %llu",
+                              static_cast<unsigned long long>(cache.thread_id));
+    cache.pid_length = static_cast<size_t>(pid_length);
+    cache.text_length = static_cast<size_t>(pid_length + tid_length);
+    cache.fork_generation = generation;
+
+    return cache;
+}
+
+void OutputThreadIdentity(std::ostream& stream, bool process_id, bool thread_id)
+{
+    const auto& cache = CurrentThreadIdentity();
+    const char* text = cache.text;
+    size_t length = cache.text_length;
+    if (!process_id) {
+        text += cache.pid_length;
+        length -= cache.pid_length;
+    } else if (!thread_id) {
+        length = cache.pid_length;
+    }
+
+    stream.write(text, static_cast<std::streamsize>(length));
 }
 
 bool IsFileHandleValid(FileHandle handle)
@@ -153,23 +317,146 @@ PathString GetFallbackLogFilePath()
 
 #endif
 
+bool PathExists(const PathString& path)
+{
+#if defined(OS_WIN)
+    return GetFileAttributesW(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+#else
+    return access(path.c_str(), F_OK) == 0;
+#endif
+}
+
+bool RenameFilePath(const PathString& old_path, const PathString& new_path)
+{
+#if defined(OS_WIN)
+    return MoveFileExW(old_path.c_str(), new_path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(old_path.c_str(), new_path.c_str()) == 0;
+#endif
+}
+
+FileHandle OpenLogFileHandle(const PathString& path)
+{
+#if defined(OS_WIN)
+    // Surprisingly, we need neither a local nor a global lock here, on Windows.
+    // Because if we opened a file with `FILE_APPEND_DATA` flag only, the system
+    // will ensure that each appending is atomic.
+    // See https://msdn.microsoft.com/en-us/library/windows/hardware/ff548289(v=vs.85).aspx.
+    // Sharing deletion allows the file to be renamed when being rotated.
+    return CreateFileW(path.c_str(),
+                       FILE_APPEND_DATA,
+                       FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                       nullptr,
+                       OPEN_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL,
+                       nullptr);
+#else
+    // Similarly, we make atomic appending on POSIX systems, which saves us from using
+    // a global lock.
+    return open(path.c_str(), O_CREAT | O_WRONLY | O_APPEND, 0666);
+#endif
+}
+
+void CloseFileHandle(FileHandle handle)
+{
+#if defined(OS_WIN)
+    CloseHandle(handle);
+#else
+    close(handle);
+#endif
+}
+
+uint64_t GetFileHandleSize(FileHandle handle)
+{
+#if defined(OS_WIN)
+    LARGE_INTEGER size {};
+    return GetFileSizeEx(handle, &size) ? static_cast<uint64_t>(size.QuadPart) : 0;
+#else
+    struct stat file_stat {};
+    return fstat(handle, &file_stat) == 0 ? static_cast<uint64_t>(file_stat.st_size) : 0;
+#endif
+}
+
 void CloseLogFile()
 {
-    if (IsFileHandleValid(g_log_file)) {
+    std::lock_guard<std::mutex> lock(g_log_file_mutex);
+
+    auto log_file = g_log_file.exchange(kInvalidFileHandle);
+    if (IsFileHandleValid(log_file)) {
+        CloseFileHandle(log_file);
+    }
+
+    if (IsFileHandleValid(g_retired_log_file)) {
+        CloseFileHandle(g_retired_log_file);
+        g_retired_log_file = kInvalidFileHandle;
+    }
+}
+
+// Replaces the file in use with `new_file`, without disturbing concurrent writers: on POSIX
+// systems, the new file is `dup2`-ed onto the descriptor in use, so the descriptor never
+// dangles, and a write in progress finishes in the old file; on Windows, the old handle is
+// retired rather than closed.
+// Requires `g_log_file_mutex` being held.
+void SwapLogFileLocked(FileHandle new_file)
+{
 #if defined(OS_WIN)
-        CloseHandle(g_log_file);
+    auto old_file = g_log_file.exchange(new_file, std::memory_order_acq_rel);
+    if (IsFileHandleValid(g_retired_log_file)) {
+        CloseFileHandle(g_retired_log_file);
+    }
+
+    g_retired_log_file = old_file;
 #else
-        close(g_log_file);
+    auto log_file = g_log_file.load(std::memory_order_acquire);
+    if (IsFileHandleValid(log_file)) {
+        dup2(new_file, log_file);
+        CloseFileHandle(new_file);
+    } else {
+        g_log_file.store(new_file, std::memory_order_release);
+    }
 #endif
-        g_log_file = kInvalidFileHandle;
+}
+
+void OnLogFileReopened(uint64_t file_size);
+
+// Requires `g_log_file_mutex` being held.
+void ReopenLogFileLocked()
+{
+    if (g_log_file_path.empty()) {
+        return;
     }
+
+    auto new_file = OpenLogFileHandle(g_log_file_path);
+    if (!IsFileHandleValid(new_file)) {
+        // Keep on writing into the old file.
+        return;
+    }
+
+    auto file_size = GetFileHandleSize(new_file);
+    SwapLogFileLocked(new_file);
+    OnLogFileReopened(file_size);
 }
 
 // Once this function succeed, `g_log_file` refers to a valid and writable file.
 // Returns true, if we initialized the log file successfully, false otherwise.
+// It is cheap once the file is open, and is safe to call from multiple threads, even before
+// `ConfigureLoggingSettings()` is ever called.
 bool InitLogFile()
 {
-    if (IsFileHandleValid(g_log_file)) {
+    if (g_log_file_reopen_requested.load(std::memory_order_relaxed) &&
+        g_log_file_reopen_requested.exchange(false, std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(g_log_file_mutex);
+        ReopenLogFileLocked();
+    }
+
+    if (IsFileHandleValid(g_log_file.load(std::memory_order_acquire))) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(g_log_file_mutex);
+
+    // Another thread may have done it while we were waiting.
+    if (IsFileHandleValid(g_log_file.load(std::memory_order_acquire))) {
         return true;
     }
 
@@ -181,35 +468,503 @@ bool InitLogFile()
         DeleteFilePath(g_log_file_path);
     }
 
+    auto log_file = OpenLogFileHandle(g_log_file_path);
 #if defined(OS_WIN)
-    // Surprisingly, we need neither a local nor a global lock here, on Windows.
-    // Because if we opened a file with `FILE_APPEND_DATA` flag only, the system
-    // will ensure that each appending is atomic.
-    // See https://msdn.microsoft.com/en-us/library/windows/hardware/ff548289(v=vs.85).aspx.
-    g_log_file = CreateFileW(g_log_file_path.c_str(),
-                             FILE_APPEND_DATA,
-                             FILE_SHARE_READ | FILE_SHARE_WRITE,
-                             nullptr,
-                             OPEN_ALWAYS,
-                             FILE_ATTRIBUTE_NORMAL,
-                             nullptr);
-    if (g_log_file == INVALID_HANDLE_VALUE) {
+    if (!IsFileHandleValid(log_file)) {
         g_log_file_path = GetFallbackLogFilePath();
-        g_log_file = CreateFileW(g_log_file_path.c_str(),
-                                 FILE_APPEND_DATA,
-                                 FILE_SHARE_READ | FILE_SHARE_WRITE,
-                                 nullptr,
-                                 OPEN_ALWAYS,
-                                 FILE_ATTRIBUTE_NORMAL,
-                                 nullptr);
+        log_file = OpenLogFileHandle(g_log_file_path);
     }
+#endif
+
+    g_log_file.store(log_file, std::memory_order_release);
+
+    return IsFileHandleValid(log_file);
+}
+
+// Returns the path for a file being rotated, like `debug.log.20160126-091438`.
+PathString MakeRotatedFilePath(const PathString& log_file_path)
+{
+    auto explode = kbase::TimePointToLocalTimeExplode(std::chrono::system_clock::now());
+    char suffix[32];
+    int length = snprintf(suffix, sizeof(suffix), ".%4d%02d%02d-%02d%02d%02d", explode.year,
+                          explode.month, explode.day_of_month, explode.hour, explode.minute,
+                          explode.second);
+
+    PathString rotated_path = log_file_path + PathString(suffix, suffix + length);
+    PathString candidate = rotated_path;
+    for (int seq = 1; PathExists(candidate); ++seq) {
+        auto seq_text = std::to_string(seq);
+        candidate = rotated_path + PathChar('.') + PathString(seq_text.begin(), seq_text.end());
+    }
+
+    return candidate;
+}
+
+// Returns rotated files of `log_file_path`, from the oldest to the newest.
+std::vector<PathString> ListRotatedFiles(const PathString& log_file_path)
+{
+    auto sep_pos = log_file_path.find_last_of(PathString(1, '/') + PathChar('\\'));
+    auto dir_prefix = sep_pos == PathString::npos ? PathString() :
+                                                    log_file_path.substr(0, sep_pos + 1);
+    auto name_prefix = log_file_path.substr(dir_prefix.size()) + PathChar('.');
+
+    auto is_rotated_file = [&name_prefix](const PathString& name) {
+        return name.size() > name_prefix.size() &&
+               name.compare(0, name_prefix.size(), name_prefix) == 0 &&
+               name[name_prefix.size()] >= '0' && name[name_prefix.size()] <= '9';
+    };
+
+    std::vector<PathString> rotated_files;
+
+#if defined(OS_WIN)
+    WIN32_FIND_DATAW find_data {};
+    auto pattern = dir_prefix + name_prefix + L"*";
+    HANDLE find_handle = FindFirstFileW(pattern.c_str(), &find_data);
+    if (find_handle == INVALID_HANDLE_VALUE) {
+        return rotated_files;
+    }
+
+    do {
+        PathString name(find_data.cFileName);
+        if (is_rotated_file(name)) {
+            rotated_files.push_back(dir_prefix + name);
+        }
+    } while (FindNextFileW(find_handle, &find_data));
+
+    FindClose(find_handle);
 #else
-    // Similarly, we make atomic appending on POSIX systems, which saves us from using
-    // a global lock.
-    g_log_file = open(g_log_file_path.c_str(), O_CREAT | O_WRONLY | O_APPEND, 0666);
+    DIR* dir = opendir(dir_prefix.empty() ? "." : dir_prefix.c_str());
+    if (!dir) {
+        return rotated_files;
+    }
+
+    while (auto entry = readdir(dir)) {
+        PathString name(entry->d_name);
+        if (is_rotated_file(name)) {
+            rotated_files.push_back(dir_prefix + name);
+        }
+    }
+
+    closedir(dir);
+#endif
+
+    // Names are like `<timestamp>` or `<timestamp>.<seq>`. Timestamps in fixed width are
+    // chronological in lexicographical order, but sequence numbers are compared as numbers,
+    // so that `.10` comes after `.2`.
+    auto suffix_offset = dir_prefix.size() + name_prefix.size();
+    auto order_key = [suffix_offset](const PathString& path) {
+        auto suffix = path.substr(suffix_offset);
+        auto dot_pos = suffix.find(PathChar('.'));
+        uint64_t seq = 0;
+        if (dot_pos != PathString::npos) {
+            for (auto ch : suffix.substr(dot_pos + 1)) {
+                seq = seq * 10 + static_cast<uint64_t>(ch - '0');
+            }
+
+            suffix.erase(dot_pos);
+        }
+
+        return std::make_pair(suffix, seq);
+    };
+
+    std::sort(rotated_files.begin(), rotated_files.end(),
+              [&order_key](const PathString& lhs, const PathString& rhs) {
+                  return order_key(lhs) < order_key(rhs);
+              });
+
+    return rotated_files;
+}
+
+kbase::TimePoint NextRotationTime(LogRotationInterval interval, kbase::TimePoint now)
+{
+    auto raw_time = kbase::Clock::to_time_t(now);
+    tm local_time {};
+    kbase::SecureLocalTime(&raw_time, &local_time);
+
+    local_time.tm_min = 0;
+    local_time.tm_sec = 0;
+    if (interval == LogRotationInterval::RotateHourly) {
+        local_time.tm_hour += 1;
+    } else {
+        local_time.tm_hour = 0;
+        local_time.tm_mday += 1;
+    }
+
+    local_time.tm_isdst = -1;
+
+    return kbase::Clock::from_time_t(mktime(&local_time));
+}
+
+// Rotates the log file when it outgrows the size limit or reaches a time boundary.
+// All the work, including the rotation handler, is done on a background thread; producers
+// only count the bytes they have written and poke the thread when the limit is reached.
+// The active file is replaced atomically, see `SwapLogFileLocked()`.
+class LogFileRotator {
+public:
+    LogFileRotator(const LoggingSettings& settings, uint64_t current_file_size)
+        : max_file_size_(settings.max_log_file_size),
+          interval_(settings.rotation_interval),
+          max_rotated_files_(settings.max_rotated_files),
+          rotation_handler_(settings.rotation_handler),
+          bytes_written_(current_file_size),
+          rotation_requested_(false),
+          stopping_(false)
+    {
+        rotating_thread_ = std::thread(&LogFileRotator::Run, this);
+    }
+
+    ~LogFileRotator()
+    {
+        Stop();
+    }
+
+    LogFileRotator(const LogFileRotator&) = delete;
+
+    LogFileRotator& operator=(const LogFileRotator&) = delete;
+
+    void OnFileWritten(size_t bytes)
+    {
+        if (max_file_size_ == 0) {
+            return;
+        }
+
+        auto total = bytes_written_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        if (total >= max_file_size_ &&
+            !rotation_requested_.exchange(true, std::memory_order_acq_rel)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wakeup_cv_.notify_one();
+        }
+    }
+
+    // The file was replaced by someone else.
+    void OnFileReopened(uint64_t file_size)
+    {
+        bytes_written_.store(file_size, std::memory_order_relaxed);
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+            wakeup_cv_.notify_one();
+        }
+
+        if (rotating_thread_.joinable()) {
+            rotating_thread_.join();
+        }
+    }
+
+private:
+    void Run()
+    {
+        auto rotation_due = [this] {
+            return stopping_ || rotation_requested_.load(std::memory_order_acquire);
+        };
+
+        bool timed_rotation = interval_ != LogRotationInterval::NoTimedRotation;
+        auto next_rotation_time = NextRotationTime(interval_, kbase::Clock::now());
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            if (timed_rotation) {
+                wakeup_cv_.wait_until(lock, next_rotation_time, rotation_due);
+            } else {
+                wakeup_cv_.wait(lock, rotation_due);
+            }
+
+            if (stopping_) {
+                break;
+            }
+
+            bool time_reached = timed_rotation && kbase::Clock::now() >= next_rotation_time;
+            if (time_reached) {
+                next_rotation_time = NextRotationTime(interval_, kbase::Clock::now());
+            }
+
+            // Don't bother rotating a file without content.
+            if (rotation_requested_.load(std::memory_order_acquire) ||
+                (time_reached && bytes_written_.load(std::memory_order_relaxed) != 0)) {
+                lock.unlock();
+                RotateFile();
+                lock.lock();
+            }
+        }
+    }
+
+    // On failure, the file keeps its byte count, and the next write past the limit requests
+    // another rotation.
+    void RotateFile()
+    {
+        ON_SCOPE_EXIT {
+            rotation_requested_.store(false, std::memory_order_release);
+        };
+
+        PathString log_file_path;
+        PathString rotated_path;
+        {
+            std::lock_guard<std::mutex> lock(g_log_file_mutex);
+            log_file_path = g_log_file_path;
+            rotated_path = MakeRotatedFilePath(log_file_path);
+            if (!RenameFilePath(log_file_path, rotated_path)) {
+                return;
+            }
+
+            auto new_file = OpenLogFileHandle(log_file_path);
+            if (!IsFileHandleValid(new_file)) {
+                // Keep on writing into the renamed file.
+                return;
+            }
+
+            SwapLogFileLocked(new_file);
+            bytes_written_.store(0, std::memory_order_relaxed);
+        }
+
+        if (rotation_handler_) {
+            rotation_handler_(rotated_path);
+        }
+
+        if (max_rotated_files_ != 0) {
+            auto rotated_files = ListRotatedFiles(log_file_path);
+            for (size_t i = 0; i + max_rotated_files_ < rotated_files.size(); ++i) {
+                DeleteFilePath(rotated_files[i]);
+            }
+        }
+    }
+
+private:
+    const uint64_t max_file_size_;
+    const LogRotationInterval interval_;
+    const size_t max_rotated_files_;
+    const kbase::LogRotationHandler rotation_handler_;
+    std::atomic<uint64_t> bytes_written_;
+    std::atomic<bool> rotation_requested_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_cv_;
+    bool stopping_;
+    std::thread rotating_thread_;
+};
+
+void OnLogFileReopened(uint64_t file_size)
+{
+    auto rotator = g_log_file_rotator.load(std::memory_order_acquire);
+    if (rotator) {
+        rotator->OnFileReopened(file_size);
+    }
+}
+
+bool ShouldOutputToStderr(LogSeverity severity)
+{
+    return (g_logging_dest & LoggingDestination::LogToSystemDebugLog) ||
+           severity >= kAlwaysPrintErrorMinLevel;
+}
+
+// `msg` must be null-terminated, if on Windows.
+void OutputToStderr(const char* msg, size_t length)
+{
+#if defined(OS_WIN)
+    OutputDebugStringA(msg);
+#endif
+    // Log to standard error stream.
+    fwrite(msg, sizeof(char), length, stderr);
+}
+
+void OnLogFileWritten(size_t length)
+{
+    auto rotator = g_log_file_rotator.load(std::memory_order_acquire);
+    if (rotator) {
+        rotator->OnFileWritten(length);
+    }
+}
+
+void WriteToLogFile(const char* msg, size_t length)
+{
+#if defined(OS_WIN)
+    DWORD bytes_written = 0;
+    WriteFile(g_log_file.load(std::memory_order_acquire), msg, static_cast<DWORD>(length),
+              &bytes_written, nullptr);
+#else
+    IGNORE_RESULT(write(g_log_file.load(std::memory_order_acquire), msg, length));
 #endif
 
-    return IsFileHandleValid(g_log_file);
+    OnLogFileWritten(length);
+}
+
+// `msg` must be null-terminated.
+void WriteMessage(LogSeverity severity, const char* msg, size_t length)
+{
+    if (ShouldOutputToStderr(severity)) {
+        OutputToStderr(msg, length);
+        fflush(stderr);
+    }
+
+    // If `InitLogFile` wasn't called at the start of the program, do it on the fly.
+    // However, if we unfortunately failed to initialize the log file, just skip the writting.
+    if ((g_logging_dest & LoggingDestination::LogToFile) && InitLogFile()) {
+        WriteToLogFile(msg, length);
+    }
+}
+
+// Runs on the flusher thread of the async writer, and coalesces records into as few
+// writes as possible.
+void WriteAsyncRecords(const AsyncLogWriter::Record* records, size_t count)
+{
+    bool stderr_touched = false;
+    for (size_t i = 0; i < count; ++i) {
+        if (ShouldOutputToStderr(records[i].severity)) {
+            OutputToStderr(records[i].message.c_str(), records[i].message.length());
+            stderr_touched = true;
+        }
+    }
+
+    if (stderr_touched) {
+        fflush(stderr);
+    }
+
+    if (!(g_logging_dest & LoggingDestination::LogToFile) || !InitLogFile()) {
+        return;
+    }
+
+#if defined(OS_WIN)
+    // The batch writer is never invoked concurrently.
+    static std::string coalesced;
+    coalesced.clear();
+    for (size_t i = 0; i < count; ++i) {
+        coalesced.append(records[i].message);
+    }
+
+    WriteToLogFile(coalesced.data(), coalesced.length());
+#else
+    constexpr size_t kMaxIoVecs = 128;
+    iovec vecs[kMaxIoVecs];
+    for (size_t offset = 0; offset < count; offset += kMaxIoVecs) {
+        size_t vec_count = std::min(count - offset, kMaxIoVecs);
+        size_t bytes = 0;
+        for (size_t i = 0; i < vec_count; ++i) {
+            const auto& msg = records[offset + i].message;
+            vecs[i].iov_base = const_cast<char*>(msg.data());
+            vecs[i].iov_len = msg.length();
+            bytes += msg.length();
+        }
+
+        IGNORE_RESULT(writev(g_log_file.load(std::memory_order_acquire), vecs,
+                             static_cast<int>(vec_count)));
+        OnLogFileWritten(bytes);
+    }
+#endif
+}
+
+void ShutdownLoggingAtExit()
+{
+    // Other threads may still be logging during the teardown, thus we deliberately leak
+    // these objects; messages since now would be written synchronously.
+    auto writer = g_async_writer.exchange(nullptr, std::memory_order_acq_rel);
+    if (writer) {
+        writer->Stop();
+    }
+
+    auto rotator = g_log_file_rotator.exchange(nullptr, std::memory_order_acq_rel);
+    if (rotator) {
+        rotator->Stop();
+    }
+}
+
+void RegisterExitHandlerOnce()
+{
+    static bool exit_handler_registered = false;
+    if (!exit_handler_registered) {
+        std::atexit(ShutdownLoggingAtExit);
+        exit_handler_registered = true;
+    }
+}
+
+void StopAsyncLogging()
+{
+    auto writer = g_async_writer.exchange(nullptr, std::memory_order_acq_rel);
+    if (writer) {
+        writer->Stop();
+        delete writer;
+    }
+}
+
+void StartAsyncLogging(size_t capacity, kbase::AsyncOverflowPolicy overflow_policy)
+{
+    RegisterExitHandlerOnce();
+    g_async_writer.store(new AsyncLogWriter(capacity, overflow_policy, WriteAsyncRecords),
+                         std::memory_order_release);
+}
+
+void StopLogFileRotation()
+{
+    auto rotator = g_log_file_rotator.exchange(nullptr, std::memory_order_acq_rel);
+    if (rotator) {
+        rotator->Stop();
+        delete rotator;
+    }
+}
+
+void StartLogFileRotation(const LoggingSettings& settings)
+{
+    RegisterExitHandlerOnce();
+    auto current_size = GetFileHandleSize(g_log_file.load(std::memory_order_acquire));
+    g_log_file_rotator.store(new LogFileRotator(settings, current_size),
+                             std::memory_order_release);
+}
+
+// Requires `g_verbosity_mutex` being held.
+int ResolveVerboseLevelLocked(const char* file_path)
+{
+    int level = g_verbose_level;
+    if (!g_verbose_module_levels.empty()) {
+        std::string path(file_path);
+        std::string module(kbase::internal::ExtractFileName(file_path));
+        module = module.substr(0, module.rfind('.'));
+        auto it = std::find_if(g_verbose_module_levels.begin(), g_verbose_module_levels.end(),
+                               [&](const std::pair<std::string, int>& entry) {
+            const auto& pattern = entry.first;
+            bool match_path = pattern.find_first_of("/\\") != std::string::npos;
+            return kbase::MatchPattern(match_path ? path : module, pattern);
+        });
+
+        if (it != g_verbose_module_levels.end()) {
+            level = it->second;
+        }
+    }
+
+    // Must not be mistaken for the sentinel.
+    return std::min(level, kbase::internal::kVLogSiteUninitialized - 1);
+}
+
+// Requires `g_verbosity_mutex` being held.
+void RefreshVLogSitesLocked()
+{
+    for (auto site = g_vlog_sites; site; site = site->next) {
+        site->level.store(ResolveVerboseLevelLocked(site->file_path), std::memory_order_relaxed);
+    }
+}
+
+// Parses lists like `net_*=2,cache=1`.
+std::vector<std::pair<std::string, int>> ParseVerboseModules(const std::string& verbose_modules)
+{
+    std::vector<std::pair<std::string, int>> module_levels;
+    std::vector<std::string> entries;
+    kbase::SplitString(verbose_modules, ",", entries);
+    for (const auto& entry : entries) {
+        auto delim = entry.find('=');
+        if (delim == 0 || delim == std::string::npos || delim + 1 == entry.size()) {
+            continue;
+        }
+
+        char* end = nullptr;
+        auto level = strtol(entry.c_str() + delim + 1, &end, 10);
+        if (*end != '\0') {
+            continue;
+        }
+
+        module_levels.emplace_back(entry.substr(0, delim), static_cast<int>(level));
+    }
+
+    return module_levels;
 }
 
 }   // namespace
@@ -220,7 +975,137 @@ namespace internal {
 
 LogSeverity GetMinSeverityLevel() noexcept
 {
-    return g_min_severity_level;
+    return g_min_severity_level.load(std::memory_order_relaxed);
+}
+
+bool LogIsOnOrRecord(const LogSite& site) noexcept
+{
+    if (site.severity >= g_min_severity_level.load(std::memory_order_relaxed)) {
+        return true;
+    }
+
+    if (IsFlightRecorderEnabled()) {
+        RecordFlightFiltered(site);
+    }
+
+    return false;
+}
+
+const char* LogSeverityName(LogSeverity severity) noexcept
+{
+    return kLogSeverityNames[enum_cast(severity)];
+}
+
+bool VLogIsOnSlow(VLogSite& site, int verbose_level)
+{
+    auto level = site.level.load(std::memory_order_relaxed);
+    if (level == kVLogSiteUninitialized) {
+        std::lock_guard<std::mutex> lock(g_verbosity_mutex);
+        level = site.level.load(std::memory_order_relaxed);
+        if (level == kVLogSiteUninitialized) {
+            level = ResolveVerboseLevelLocked(site.file_path);
+            site.next = g_vlog_sites;
+            g_vlog_sites = &site;
+            site.level.store(level, std::memory_order_relaxed);
+        }
+    }
+
+    return verbose_level <= level;
+}
+
+LogStreamBuf::LogStreamBuf() noexcept
+{
+    setp(inline_buf_, inline_buf_ + kInlineCapacity);
+}
+
+void LogStreamBuf::Reset() noexcept
+{
+    if (spilled_buf_.size() > kMaxRetainedSpilledBufferSize) {
+        std::string().swap(spilled_buf_);
+    }
+
+    setp(inline_buf_, inline_buf_ + kInlineCapacity);
+}
+
+const char* LogStreamBuf::c_str()
+{
+    if (pptr() == epptr()) {
+        Grow(1);
+    }
+
+    *pptr() = '\0';
+
+    return pbase();
+}
+
+LogStreamBuf::int_type LogStreamBuf::overflow(int_type ch)
+{
+    if (traits_type::eq_int_type(ch, traits_type::eof())) {
+        return traits_type::not_eof(ch);
+    }
+
+    Grow(1);
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+
+    return ch;
+}
+
+std::streamsize LogStreamBuf::xsputn(const char_type* s, std::streamsize count)
+{
+    auto length = static_cast<size_t>(count);
+    if (static_cast<size_t>(epptr() - pptr()) < length) {
+        Grow(length);
+    }
+
+    memcpy(pptr(), s, length);
+    for (auto left = length; left != 0;) {
+        auto step = std::min<size_t>(left, std::numeric_limits<int>::max());
+        pbump(static_cast<int>(step));
+        left -= step;
+    }
+
+    return count;
+}
+
+void LogStreamBuf::Grow(size_t extra)
+{
+    size_t used = size();
+    size_t required = std::max(used + extra, static_cast<size_t>(epptr() - pbase()) * 2);
+
+    if (pbase() == inline_buf_) {
+        if (spilled_buf_.size() < required) {
+            spilled_buf_.resize(required);
+        }
+
+        memcpy(&spilled_buf_[0], inline_buf_, used);
+    } else {
+        spilled_buf_.resize(required);
+    }
+
+    char* begin = &spilled_buf_[0];
+    setp(begin, begin + spilled_buf_.size());
+    for (auto left = used; left != 0;) {
+        auto step = std::min<size_t>(left, std::numeric_limits<int>::max());
+        pbump(static_cast<int>(step));
+        left -= step;
+    }
+}
+
+LogStream::LogStream()
+    : std::ostream(nullptr)
+{
+    rdbuf(&buf_);
+}
+
+void LogStream::Reset()
+{
+    buf_.Reset();
+    clear();
+    flags(std::ios_base::skipws | std::ios_base::dec);
+    width(0);
+    precision(6);
+    fill(' ');
 }
 
 }   // namespace internal
@@ -229,89 +1114,248 @@ LoggingSettings::LoggingSettings() noexcept
  : min_severity_level(LogSeverity::LogInfo),
    log_item_options(LogItemOptions::EnableTimestamp),
    logging_destination(LoggingDestination::LogToFile),
-   old_file_disposal_option(OldFileDisposalOption::AppendToOldFile)
+   old_file_disposal_option(OldFileDisposalOption::AppendToOldFile),
+   async_logging(false),
+   async_buffer_capacity(kDefaultAsyncBufferCapacity),
+   async_overflow_policy(AsyncOverflowPolicy::BlockOnOverflow),
+   max_log_file_size(0),
+   rotation_interval(LogRotationInterval::NoTimedRotation),
+   max_rotated_files(0),
+   verbose_level(0),
+   flight_recorder_capacity(0)
 {}
 
 void ConfigureLoggingSettings(const LoggingSettings& settings)
 {
-    g_min_severity_level = settings.min_severity_level;
+    // Pending messages belong to the previous settings.
+    StopAsyncLogging();
+    StopLogFileRotation();
+
+    g_min_severity_level.store(settings.min_severity_level, std::memory_order_relaxed);
     g_log_item_options = settings.log_item_options;
     g_logging_dest = settings.logging_destination;
     g_old_file_option = settings.old_file_disposal_option;
 
+    if (g_logging_dest & LoggingDestination::LogToFile) {
+        if (!settings.log_file_path.empty()) {
+            std::lock_guard<std::mutex> lock(g_log_file_mutex);
+            g_log_file_path = settings.log_file_path;
+        }
+
+        CloseLogFile();
+
+        bool file_ready = InitLogFile();
+        if (file_ready && (settings.max_log_file_size != 0 ||
+                           settings.rotation_interval != LogRotationInterval::NoTimedRotation)) {
+            StartLogFileRotation(settings);
+        }
+    }
+
+    {
+        auto module_levels = ParseVerboseModules(settings.verbose_modules);
+        std::lock_guard<std::mutex> lock(g_verbosity_mutex);
+        g_verbose_level = settings.verbose_level;
+        g_verbose_module_levels = std::move(module_levels);
+        RefreshVLogSitesLocked();
+    }
+
+    kbase::internal::ConfigureBinaryLogFile(settings.binary_log_file_path);
+    kbase::internal::ConfigureFlightRecorder(settings.flight_recorder_capacity);
+
+    if (settings.async_logging) {
+        StartAsyncLogging(settings.async_buffer_capacity, settings.async_overflow_policy);
+    }
+}
+
+void SetMinSeverityLevel(LogSeverity severity)
+{
+    g_min_severity_level.store(severity, std::memory_order_relaxed);
+}
+
+void SetVerboseLevel(int level)
+{
+    std::lock_guard<std::mutex> lock(g_verbosity_mutex);
+    g_verbose_level = level;
+    RefreshVLogSitesLocked();
+}
+
+void SetVerboseModuleLevel(const std::string& module_pattern, int level)
+{
+    std::lock_guard<std::mutex> lock(g_verbosity_mutex);
+    auto it = std::find_if(g_verbose_module_levels.begin(), g_verbose_module_levels.end(),
+                           [&](const std::pair<std::string, int>& entry) {
+        return entry.first == module_pattern;
+    });
+
+    if (it != g_verbose_module_levels.end()) {
+        it->second = level;
+    } else {
+        g_verbose_module_levels.emplace_back(module_pattern, level);
+    }
+
+    RefreshVLogSitesLocked();
+}
+
+void ClearVerboseModuleLevels()
+{
+    std::lock_guard<std::mutex> lock(g_verbosity_mutex);
+    g_verbose_module_levels.clear();
+    RefreshVLogSitesLocked();
+}
+
+void ReopenLogFile()
+{
     if (!(g_logging_dest & LoggingDestination::LogToFile)) {
         return;
     }
 
-    if (!settings.log_file_path.empty()) {
-        g_log_file_path = settings.log_file_path;
+    std::lock_guard<std::mutex> lock(g_log_file_mutex);
+    ReopenLogFileLocked();
+}
+
+void RequestLogFileReopen() noexcept
+{
+    g_log_file_reopen_requested.store(true, std::memory_order_release);
+}
+
+#if defined(OS_POSIX)
+
+void ReopenLogFileOnSignal(int signal_number)
+{
+    struct sigaction action {};
+    action.sa_handler = [](int) {
+        RequestLogFileReopen();
+    };
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(signal_number, &action, nullptr);
+}
+
+#endif
+
+uint64_t GetCurrentOSProcessID() noexcept
+{
+    return CurrentThreadIdentity().process_id;
+}
+
+uint64_t GetCurrentOSThreadID() noexcept
+{
+    return CurrentThreadIdentity().thread_id;
+}
+
+void FlushLogging()
+{
+    auto writer = g_async_writer.load(std::memory_order_acquire);
+    if (writer) {
+        writer->Flush();
     }
 
-    CloseLogFile();
+    internal::FlushLogSinks();
+}
+
+LogMessage::LogMessage(const internal::LogSite& site, uint64_t suppressed_count)
+    : file_name_(site.file_name),
+      line_(site.line),
+      severity_(site.severity),
+      suppressed_count_(suppressed_count),
+      header_length_(0),
+      stream_(AcquireThreadLogStream())
+{
+    if (!stream_) {
+        fallback_stream_ = std::make_unique<internal::LogStream>();
+        stream_ = fallback_stream_.get();
+    }
 
-    InitLogFile();
+    InitMessageHeader();
 }
 
 LogMessage::LogMessage(const char* file, int line, LogSeverity severity)
-    : file_name_(ExtractFileName(file)), line_(line), severity_(severity)
+    : file_name_(internal::ExtractFileName(file)),
+      line_(line),
+      severity_(severity),
+      suppressed_count_(0),
+      header_length_(0),
+      stream_(AcquireThreadLogStream())
 {
+    if (!stream_) {
+        fallback_stream_ = std::make_unique<internal::LogStream>();
+        stream_ = fallback_stream_.get();
+    }
+
     InitMessageHeader();
 }
 
 LogMessage::~LogMessage()
 {
+    ON_SCOPE_EXIT {
+        if (!fallback_stream_) {
+            ReleaseThreadLogStream();
+        }
+    };
+
+    auto& stream = *stream_;
+
+    if (suppressed_count_ != 0) {
+        stream << " [" << suppressed_count_ << " similar messages suppressed]";
+    }
+
+    if (internal::IsFlightRecorderEnabled()) {
+        auto& buf = stream_->buf();
+        internal::LogSite site {file_name_, line_, severity_};
+        internal::RecordFlightText(site, buf.data() + header_length_, buf.size() - header_length_);
+    }
+
     if (severity_ == LogSeverity::LogFatal) {
-        stream_ << "\n";
+        stream << "\n";
         StackWalker walker;
-        walker.DumpCallStack(stream_);
+        walker.DumpCallStack(stream);
+        internal::DumpFlightRecords([](void* context, const char* data, size_t size) {
+            static_cast<std::ostream*>(context)->write(data, static_cast<std::streamsize>(size));
+        }, &stream);
     }
 
-    stream_ << std::endl;
-    std::string msg = stream_.str();
+    stream << '\n';
 
-    if ((g_logging_dest & LoggingDestination::LogToSystemDebugLog) ||
-        severity_ >= kAlwaysPrintErrorMinLevel) {
-#if defined(OS_WIN)
-        OutputDebugStringA(msg.c_str());
-#endif
-        // Log to standard error stream.
-        fwrite(msg.data(), sizeof(char), msg.length(), stderr);
-        fflush(stderr);
-    }
+    auto& buf = stream_->buf();
+    const char* msg = buf.c_str();
+    size_t length = buf.size();
 
-    // If `InitLogFile` wasn't called at the start of the program, do it on the fly.
-    // However, if we unfortunately failed to initialize the log file, just skip the writting.
-    // Note that, if more than one thread in here try to call `InitLogFile`, there will be a
-    // race condition. This is why you should call `ConfigureLoggingSettings` at start.
-    if ((g_logging_dest & LoggingDestination::LogToFile) && InitLogFile()) {
-#if defined(OS_WIN)
-        DWORD bytes_written = 0;
-        WriteFile(g_log_file, msg.data(), static_cast<DWORD>(msg.length()), &bytes_written,
-                  nullptr);
-#else
-        IGNORE_RESULT(write(g_log_file, msg.data(), msg.length()));
-#endif
+    LogRecord record {severity_, file_name_, line_, msg, length};
+
+    auto async_writer = g_async_writer.load(std::memory_order_acquire);
+    if (!async_writer) {
+        WriteMessage(severity_, msg, length);
+    } else if (severity_ == LogSeverity::LogFatal) {
+        // Keep messages in order, and don't lose any of them if we were about to crash.
+        async_writer->Flush();
+        WriteMessage(severity_, msg, length);
+    } else {
+        async_writer->Append(record);
     }
+
+    internal::DispatchToLogSinks(record);
 }
 
 void LogMessage::InitMessageHeader()
 {
-    stream_ << "[";
+    auto& stream = *stream_;
+
+    stream << "[";
 
     if (g_log_item_options & LogItemOptions::EnableTimestamp) {
-        OutputNowTimestamp(stream_);
+        OutputNowTimestamp(stream);
     }
 
-    if (g_log_item_options & LogItemOptions::EnableProcessID) {
-        stream_ << " " << GetCurrentProcessID();
+    bool process_id = (g_log_item_options & LogItemOptions::EnableProcessID) != 0;
+    bool thread_id = (g_log_item_options & LogItemOptions::EnableThreadID) != 0;
+    if (process_id || thread_id) {
+        OutputThreadIdentity(stream, process_id, thread_id);
     }
 
-    if (g_log_item_options & LogItemOptions::EnableThreadID) {
-        stream_ << " " << std::this_thread::get_id();
-    }
+    stream << " " << kLogSeverityNames[enum_cast(severity_)]
+           << " " << file_name_ << '(' << line_ << ")]";
 
-    stream_ << " " << kLogSeverityNames[enum_cast(severity_)]
-            << " " << file_name_ << '(' << line_ << ")]";
+    header_length_ = stream_->buf().size();
 }
 
 }   // namespace kbase
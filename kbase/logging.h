@@ -9,7 +9,14 @@
 #ifndef KBASE_LOGGING_H_
 #define KBASE_LOGGING_H_
 
-#include <sstream>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <streambuf>
 #include <string>
 
 #include "kbase/basic_types.h"
@@ -31,6 +38,268 @@ namespace internal {
 
 LogSeverity GetMinSeverityLevel() noexcept;
 
+const char* LogSeverityName(LogSeverity severity) noexcept;
+
+template<typename charT>
+constexpr const charT* ExtractFileName(const charT* file_path) noexcept
+{
+    const charT* p = file_path;
+    const charT* last_pos = nullptr;
+    for (; *p != '\0'; ++p) {
+        if (*p == '/' || *p == '\\') {
+            last_pos = p;
+        }
+    }
+
+    return last_pos ? last_pos + 1 : file_path;
+}
+
+// Describes a logging call site. Each call site has its own instance being constant-initialized,
+// therefore nothing about the site is evaluated at runtime.
+struct LogSite {
+    const char* file_name;
+    int line;
+    LogSeverity severity;
+};
+
+// Returns true if the severity of the site is on; otherwise, the message is recorded by the
+// flight recorder, if enabled, see kbase/flight_recorder.h.
+bool LogIsOnOrRecord(const LogSite& site) noexcept;
+
+// A stream buffer that formats into a fixed-capacity inline buffer, and spills to the heap
+// only when a message outgrows the inline buffer.
+class LogStreamBuf : public std::streambuf {
+public:
+    LogStreamBuf() noexcept;
+
+    ~LogStreamBuf() = default;
+
+    LogStreamBuf(const LogStreamBuf&) = delete;
+
+    LogStreamBuf& operator=(const LogStreamBuf&) = delete;
+
+    LogStreamBuf(LogStreamBuf&&) = delete;
+
+    LogStreamBuf& operator=(LogStreamBuf&&) = delete;
+
+    // Discards the content, and switches back to the inline buffer.
+    // The spilled heap buffer, if any, is retained for later oversized messages.
+    void Reset() noexcept;
+
+    const char* data() const noexcept
+    {
+        return pbase();
+    }
+
+    size_t size() const noexcept
+    {
+        return static_cast<size_t>(pptr() - pbase());
+    }
+
+    // Returns the content as a null-terminated string; the terminator is not counted in size().
+    const char* c_str();
+
+protected:
+    int_type overflow(int_type ch) override;
+
+    std::streamsize xsputn(const char_type* s, std::streamsize count) override;
+
+private:
+    // Makes room for at least `extra` more chars.
+    void Grow(size_t extra);
+
+private:
+    static constexpr size_t kInlineCapacity = 2048;
+    char inline_buf_[kInlineCapacity];
+    std::string spilled_buf_;
+};
+
+// An ostream over a `LogStreamBuf`. Each thread keeps one for reuse, so that constructing a
+// stream, which is comparatively expensive, is avoided for every message.
+class LogStream : public std::ostream {
+public:
+    LogStream();
+
+    ~LogStream() = default;
+
+    LogStream(const LogStream&) = delete;
+
+    LogStream& operator=(const LogStream&) = delete;
+
+    LogStream(LogStream&&) = delete;
+
+    LogStream& operator=(LogStream&&) = delete;
+
+    // Discards the content, and restores format states that previous messages may have changed.
+    void Reset();
+
+    LogStreamBuf& buf() noexcept
+    {
+        return buf_;
+    }
+
+private:
+    LogStreamBuf buf_;
+};
+
+// Per-call-site states of rate-limited logging.
+// Each limiter is a static object of its call site, and decides lock-free whether a message
+// goes out; suppressed messages are counted, and the count is reported by the next message
+// let through.
+
+struct LogAdmission {
+    bool admitted = false;
+    uint64_t suppressed_count = 0;
+};
+
+class LogEveryNLimiter {
+public:
+    constexpr LogEveryNLimiter() noexcept
+        : count_(0), suppressed_count_(0)
+    {}
+
+    LogAdmission Admit(uint64_t n) noexcept
+    {
+        LogAdmission admission;
+        if (n <= 1 || count_.fetch_add(1, std::memory_order_relaxed) % n == 0) {
+            admission.admitted = true;
+            admission.suppressed_count = suppressed_count_.exchange(0, std::memory_order_relaxed);
+        } else {
+            suppressed_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        return admission;
+    }
+
+private:
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> suppressed_count_;
+};
+
+class LogFirstNLimiter {
+public:
+    constexpr LogFirstNLimiter() noexcept
+        : count_(0)
+    {}
+
+    // Never reopens, and thus no count of suppressed messages.
+    LogAdmission Admit(uint64_t n) noexcept
+    {
+        LogAdmission admission;
+        // Avoid bumping the counter forever once the quota is used up.
+        admission.admitted = count_.load(std::memory_order_relaxed) < n &&
+                             count_.fetch_add(1, std::memory_order_relaxed) < n;
+        return admission;
+    }
+
+private:
+    std::atomic<uint64_t> count_;
+};
+
+inline int64_t LogLimiterNowTicks() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class LogEveryTLimiter {
+public:
+    constexpr LogEveryTLimiter() noexcept
+        : next_ticks_(0), suppressed_count_(0)
+    {}
+
+    template<typename Rep, typename Period>
+    LogAdmission Admit(std::chrono::duration<Rep, Period> interval) noexcept
+    {
+        auto interval_ticks = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            interval).count();
+        LogAdmission admission;
+        auto now = LogLimiterNowTicks();
+        auto next = next_ticks_.load(std::memory_order_relaxed);
+        // Only one thread wins the slot.
+        if (now >= next && next_ticks_.compare_exchange_strong(next, now + interval_ticks,
+                                                               std::memory_order_relaxed)) {
+            admission.admitted = true;
+            admission.suppressed_count = suppressed_count_.exchange(0, std::memory_order_relaxed);
+        } else {
+            suppressed_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        return admission;
+    }
+
+private:
+    std::atomic<int64_t> next_ticks_;
+    std::atomic<uint64_t> suppressed_count_;
+};
+
+// A token bucket holding at most `burst` tokens, and one token is refilled per `interval`.
+// It is implemented as the generic cell rate algorithm, which keeps the whole bucket state
+// in a single atomic: the theoretical time when the bucket would be full again.
+class LogTokenBucketLimiter {
+public:
+    constexpr LogTokenBucketLimiter() noexcept
+        : full_ticks_(0), suppressed_count_(0)
+    {}
+
+    template<typename Rep, typename Period>
+    LogAdmission Admit(uint64_t burst, std::chrono::duration<Rep, Period> interval) noexcept
+    {
+        auto interval_ticks = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            interval).count();
+        auto capacity_ticks = interval_ticks * static_cast<int64_t>(burst);
+        LogAdmission admission;
+        auto now = LogLimiterNowTicks();
+        auto full = full_ticks_.load(std::memory_order_relaxed);
+        for (;;) {
+            // Taking a token postpones the full time by one interval.
+            auto new_full = (full > now ? full : now) + interval_ticks;
+            if (new_full - now > capacity_ticks) {
+                suppressed_count_.fetch_add(1, std::memory_order_relaxed);
+                return admission;
+            }
+
+            if (full_ticks_.compare_exchange_weak(full, new_full, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+
+        admission.admitted = true;
+        admission.suppressed_count = suppressed_count_.exchange(0, std::memory_order_relaxed);
+
+        return admission;
+    }
+
+private:
+    std::atomic<int64_t> full_ticks_;
+    std::atomic<uint64_t> suppressed_count_;
+};
+
+constexpr int kVLogSiteUninitialized = std::numeric_limits<int>::max();
+
+// Describes a VLOG call site, which caches the verbose level in effect for its file.
+// A site resolves its level on the first use, and joins the list of resolved sites, which are
+// refreshed whenever verbose levels change.
+struct VLogSite {
+    constexpr explicit VLogSite(const char* path) noexcept
+        : file_path(path), level(kVLogSiteUninitialized), next(nullptr)
+    {}
+
+    const char* file_path;
+    std::atomic<int> level;
+    VLogSite* next;
+};
+
+bool VLogIsOnSlow(VLogSite& site, int verbose_level);
+
+inline bool VLogIsOn(VLogSite& site, int verbose_level)
+{
+    // An uninitialized site always falls into the slow path, since its sentinel is greater
+    // than any verbose level.
+    return verbose_level <= site.level.load(std::memory_order_relaxed) &&
+           VLogIsOnSlow(site, verbose_level);
+}
+
 }   // namespace internal
 
 enum LogItemOptions {
@@ -53,6 +322,36 @@ enum OldFileDisposalOption {
     DeleteOldFile
 };
 
+// Decides what a producer does when the async logging buffer is full.
+enum AsyncOverflowPolicy {
+    // Waits until the flusher makes room for the message.
+    BlockOnOverflow,
+    // Discards the message being logged.
+    DropNewestOnOverflow,
+    // Discards the oldest message in the buffer.
+    DropOldestOnOverflow
+};
+
+enum LogRotationInterval {
+    NoTimedRotation,
+    RotateHourly,
+    RotateDaily
+};
+
+// A finished message, along with its metadata.
+struct LogRecord {
+    LogSeverity severity;
+    const char* file_name;
+    int line;
+    // The formatted message, including the header and the trailing newline; null-terminated.
+    const char* message;
+    size_t length;
+};
+
+// Receives the path of a log file that has just been rotated; it is a good place to
+// compress or upload the file.
+using LogRotationHandler = std::function<void(const PathString& rotated_file_path)>;
+
 struct LoggingSettings {
     // Initializes to default values.
     // Note that, if `log_file_path` wasn't specified, use default path.
@@ -63,27 +362,111 @@ struct LoggingSettings {
     LoggingDestination logging_destination;
     OldFileDisposalOption old_file_disposal_option;
     PathString log_file_path;
+
+    // If enabled, messages are copied into a bounded buffer and written out by a background
+    // thread in batches, instead of being written on the calling thread.
+    // FATAL messages always drain the buffer and then are written synchronously.
+    // If any message was dropped by a drop-policy, a line with the count is logged.
+    bool async_logging;
+    size_t async_buffer_capacity;   // in messages; rounded up to the nearest power of 2.
+    AsyncOverflowPolicy async_overflow_policy;
+
+    // The log file is rotated once it reaches `max_log_file_size` bytes, or at every boundary
+    // of `rotation_interval` in local time, whichever comes first; 0 and `NoTimedRotation`
+    // disable them respectively.
+    // The rotated file is renamed like `debug.log.20160126-091438`, and at most
+    // `max_rotated_files` of them are kept, oldest ones are deleted; 0 keeps all of them.
+    // Rotation is done on a background thread, which also runs `rotation_handler`, if any,
+    // with the path of the rotated file.
+    uint64_t max_log_file_size;
+    LogRotationInterval rotation_interval;
+    size_t max_rotated_files;
+    LogRotationHandler rotation_handler;
+
+    // Messages logged by `VLOG(n)` are on, if n is not greater than the verbose level of
+    // their file. `verbose_modules` overrides levels of modules with a list like
+    // `net_*=2,cache=1`, see `SetVerboseModuleLevel()`; malformed entries are ignored.
+    int verbose_level;
+    std::string verbose_modules;
+
+    // Messages logged by `BLOG` go to this file in binary records; they are logged as text
+    // messages if it is empty. See kbase/binary_logging.h.
+    PathString binary_log_file_path;
+
+    // Each thread keeps its last `flight_recorder_capacity` messages in memory, including
+    // filtered ones, which are dumped when the program crashes; 0 disables the recorder.
+    // See kbase/flight_recorder.h.
+    size_t flight_recorder_capacity;
 };
 
 // You should better configure these settings at the beginning of the program, or
 // default settings are applied.
 // Note that, calling this function during the logging in a multithreaded context
-// is not safe.
+// is not safe; use the following functions to adjust levels of a running program.
 void ConfigureLoggingSettings(const LoggingSettings& settings);
 
+// These functions are safe to call at any time, even if other threads are logging.
+
+void SetMinSeverityLevel(LogSeverity severity);
+
+// Sets the verbose level for files without a module override.
+void SetVerboseLevel(int level);
+
+// Overrides the verbose level of modules matching `module_pattern`, in which `*` and `?`
+// are wildcards. A pattern is matched against the file name without extension of a call
+// site, e.g. `net_client`, or against the whole path given by `__FILE__` if the pattern
+// contains path separators. The earliest pattern set wins if more than one match.
+void SetVerboseModuleLevel(const std::string& module_pattern, int level);
+
+void ClearVerboseModuleLevels();
+
+// Reopens the log file at its path, e.g. after the file was renamed by an external tool
+// like logrotate. Messages being written concurrently go to either file intact.
+void ReopenLogFile();
+
+// Reopening is deferred to the next message written to the log file; this function is
+// async-signal-safe.
+void RequestLogFileReopen() noexcept;
+
+#if defined(OS_POSIX)
+// Installs a handler for `signal_number`, usually SIGHUP, which requests reopening the
+// log file.
+void ReopenLogFileOnSignal(int signal_number);
+#endif
+
+// Return ids the OS assigns to the calling process and thread, e.g. `gettid()` on Linux,
+// as shown in message headers. They are cached per thread and stay correct in a child
+// process after `fork()`.
+uint64_t GetCurrentOSProcessID() noexcept;
+
+uint64_t GetCurrentOSThreadID() noexcept;
+
+// Synchronously writes out messages pending in the async logging buffer, if any, and then
+// flushes log sinks. Pending messages are also drained when the program exits normally.
+void FlushLogging();
+
+// Yields the static `LogSite` of the call site where the macro is used.
+#define LOG_CALL_SITE(severity_value)                                               \
+    ([]() -> const kbase::internal::LogSite& {                                      \
+        static constexpr kbase::internal::LogSite kbase_log_site {                  \
+            kbase::internal::ExtractFileName(__FILE__), __LINE__, severity_value    \
+        };                                                                          \
+        return kbase_log_site;                                                      \
+    }())
+
 // Surprisingly, a macro `ERROR` is defined as 0 in file <wingdi.h>, which is
 // included by <windows.h>, so we add a special macro to handle this peculiar
 // chaos, in case the file was included.
 #define COMPACT_LOG_INFO \
-    kbase::LogMessage(__FILE__, __LINE__, kbase::LogSeverity::LogInfo)
+    kbase::LogMessage(LOG_CALL_SITE(kbase::LogSeverity::LogInfo))
 #define COMPACT_LOG_WARNING \
-    kbase::LogMessage(__FILE__, __LINE__, kbase::LogSeverity::LogWarning)
+    kbase::LogMessage(LOG_CALL_SITE(kbase::LogSeverity::LogWarning))
 #define COMPACT_LOG_ERROR \
-    kbase::LogMessage(__FILE__, __LINE__, kbase::LogSeverity::LogError)
+    kbase::LogMessage(LOG_CALL_SITE(kbase::LogSeverity::LogError))
 #define COMPACT_LOG_0 \
-    kbase::LogMessage(__FILE__, __LINE__, kbase::LogSeverity::LogError)
+    kbase::LogMessage(LOG_CALL_SITE(kbase::LogSeverity::LogError))
 #define COMPACT_LOG_FATAL \
-    kbase::LogMessage(__FILE__, __LINE__, kbase::LogSeverity::LogFatal)
+    kbase::LogMessage(LOG_CALL_SITE(kbase::LogSeverity::LogFatal))
 
 #define LOG_SEVERITY_FOR_INFO kbase::LogSeverity::LogInfo
 #define LOG_SEVERITY_FOR_WARNING kbase::LogSeverity::LogWarning
@@ -94,10 +477,16 @@ void ConfigureLoggingSettings(const LoggingSettings& settings);
 #define LOG_IS_ON(severity) \
     ((LOG_SEVERITY_FOR_##severity) >= kbase::internal::GetMinSeverityLevel())
 
+// Same as `LOG_IS_ON`, except that a filtered message is recorded by the flight recorder.
+#define LOG_IS_ON_OR_RECORD(severity) \
+    kbase::internal::LogIsOnOrRecord(LOG_CALL_SITE(LOG_SEVERITY_FOR_##severity))
+
 #if !defined(NDEBUG)
 #define DLOG_IS_ON(severity) LOG_IS_ON(severity)
+#define DLOG_IS_ON_OR_RECORD(severity) LOG_IS_ON_OR_RECORD(severity)
 #else
 #define DLOG_IS_ON(severity) false
+#define DLOG_IS_ON_OR_RECORD(severity) false
 #endif
 
 #define LAZY_STREAM(stream, condition) \
@@ -106,17 +495,77 @@ void ConfigureLoggingSettings(const LoggingSettings& settings);
     COMPACT_LOG_##severity.stream()
 
 #define LOG(severity) \
-    LAZY_STREAM(LOG_STREAM(severity), LOG_IS_ON(severity))
+    LAZY_STREAM(LOG_STREAM(severity), LOG_IS_ON_OR_RECORD(severity))
 #define LOG_IF(severity, condition) \
-    LAZY_STREAM(LOG_STREAM(severity), LOG_IS_ON(severity) && (condition))
+    LAZY_STREAM(LOG_STREAM(severity), LOG_IS_ON_OR_RECORD(severity) && (condition))
+
+// Yields the static `VLogSite` of the call site where the macro is used.
+#define VLOG_CALL_SITE()                                                            \
+    ([]() -> kbase::internal::VLogSite& {                                           \
+        static kbase::internal::VLogSite kbase_vlog_site {__FILE__};                \
+        return kbase_vlog_site;                                                     \
+    }())
+
+// A disabled VLOG costs only a relaxed load and a branch; verbose levels are resolved once
+// per call site. Enabled verbose messages are logged in INFO severity.
+#define VLOG_IS_ON(verbose_level) \
+    kbase::internal::VLogIsOn(VLOG_CALL_SITE(), (verbose_level))
+
+#define VLOG(verbose_level) \
+    LAZY_STREAM(LOG_STREAM(INFO), VLOG_IS_ON(verbose_level) && LOG_IS_ON(INFO))
+#define VLOG_IF(verbose_level, condition) \
+    LAZY_STREAM(LOG_STREAM(INFO), VLOG_IS_ON(verbose_level) && LOG_IS_ON(INFO) && (condition))
 
 #define DLOG(severity) \
-    LAZY_STREAM(LOG_STREAM(severity), DLOG_IS_ON(severity))
+    LAZY_STREAM(LOG_STREAM(severity), DLOG_IS_ON_OR_RECORD(severity))
 #define DLOG_IF(severity, condition) \
-    LAZY_STREAM(LOG_STREAM(severity), DLOG_IS_ON(severity) && (condition))
+    LAZY_STREAM(LOG_STREAM(severity), DLOG_IS_ON_OR_RECORD(severity) && (condition))
+
+// Yields the static limiter of the call site where the macro is used.
+#define LOG_LIMITER(limiter_type)                                                   \
+    ([]() -> limiter_type& {                                                        \
+        static limiter_type kbase_log_limiter;                                      \
+        return kbase_log_limiter;                                                   \
+    }())
+
+// A message is let through only if both the severity is on and the limiter of the call site
+// admits it; otherwise, neither a `LogMessage` is constructed nor operands are evaluated.
+// It is a statement rather than an expression, because the admission carries the count of
+// messages suppressed since the last one, which is appended to the message.
+#define LIMITED_LOG(severity, limiter_type, ...)                                    \
+    for (kbase::internal::LogAdmission kbase_log_admission =                        \
+             LOG_IS_ON(severity) ? LOG_LIMITER(limiter_type).Admit(__VA_ARGS__)     \
+                                 : kbase::internal::LogAdmission();                 \
+         kbase_log_admission.admitted;                                              \
+         kbase_log_admission.admitted = false)                                      \
+        kbase::LogMessageVoidfy() &                                                 \
+            kbase::LogMessage(LOG_CALL_SITE(LOG_SEVERITY_FOR_##severity),           \
+                              kbase_log_admission.suppressed_count).stream()
+
+// Logs the 1st, (n+1)th, (2n+1)th... message of the call site.
+#define LOG_EVERY_N(severity, n) \
+    LIMITED_LOG(severity, kbase::internal::LogEveryNLimiter, (n))
+
+// Logs only the first n messages of the call site.
+#define LOG_FIRST_N(severity, n) \
+    LIMITED_LOG(severity, kbase::internal::LogFirstNLimiter, (n))
+
+// Logs at most one message of the call site in every `interval`, which is a
+// `std::chrono::duration`.
+#define LOG_EVERY_T(severity, interval) \
+    LIMITED_LOG(severity, kbase::internal::LogEveryTLimiter, (interval))
+
+// Lets a burst of at most `burst` messages of the call site through, and then one message
+// per `interval`, which is a `std::chrono::duration`.
+#define LOG_RATELIMITED(severity, burst, interval) \
+    LIMITED_LOG(severity, kbase::internal::LogTokenBucketLimiter, (burst), (interval))
 
 class LogMessage {
 public:
+    // `suppressed_count` of similar messages suppressed by a rate limit is appended, if any.
+    explicit LogMessage(const internal::LogSite& site, uint64_t suppressed_count = 0);
+
+    // The file name is extracted from `file` at runtime; prefer the `LogSite` version.
     LogMessage(const char* file, int line, LogSeverity severity);
 
     ~LogMessage();
@@ -131,7 +580,7 @@ public:
 
     std::ostream& stream() noexcept
     {
-        return stream_;
+        return *stream_;
     }
 
 private:
@@ -146,7 +595,12 @@ private:
     const char* file_name_;
     int line_;
     LogSeverity severity_;
-    std::ostringstream stream_;
+    uint64_t suppressed_count_;
+    size_t header_length_;
+    internal::LogStream* stream_;
+    // Used only if the stream of the thread is unavailable, e.g. logging while formatting
+    // another message.
+    std::unique_ptr<internal::LogStream> fallback_stream_;
 };
 
 // Used to suppress compiler warning or intellisense error.
@@ -9,76 +9,241 @@
 #ifndef KBASE_LRU_CACHE_H_
 #define KBASE_LRU_CACHE_H_
 
+#include <functional>
 #include <list>
 #include <map>
+#include <string>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 
 #include "kbase/basic_macros.h"
+#include "kbase/cache_stats.h"
+#include "kbase/chrono_util.h"
 #include "kbase/error_exception_util.h"
+#include "kbase/node_pool.h"
+#include "kbase/string_view.h"
 
 namespace kbase {
 
+namespace internal {
+
+// Refers to a key stored in a cached entry, so that the key table doesn't keep another copy.
+template<typename Key>
+class KeyRef {
+public:
+    explicit KeyRef(const Key& key) noexcept
+        : key_(&key)
+    {}
+
+    const Key& get() const noexcept
+    {
+        return *key_;
+    }
+
+    friend bool operator==(KeyRef lhs, KeyRef rhs)
+    {
+        return std::equal_to<Key>()(lhs.get(), rhs.get());
+    }
+
+    friend bool operator<(KeyRef lhs, KeyRef rhs)
+    {
+        return std::less<Key>()(lhs.get(), rhs.get());
+    }
+
+private:
+    const Key* key_;
+};
+
+// Keys of the key table of LRUCache, and the argument type of lookups.
+template<typename Key>
+struct LRUKeyTraits {
+    using TableKey = KeyRef<Key>;
+    using LookupKey = const Key&;
+
+    static TableKey ToTableKey(const Key& key) noexcept
+    {
+        return TableKey(key);
+    }
+};
+
+// String keys are referred to by string views, which allows lookups with string views as well.
+
+template<typename CharT>
+struct StringKeyTraits {
+    using TableKey = BasicStringView<CharT>;
+    using LookupKey = BasicStringView<CharT>;
+
+    static TableKey ToTableKey(LookupKey key) noexcept
+    {
+        return key;
+    }
+
+    static std::basic_string<CharT> MakeKey(LookupKey key)
+    {
+        return key.ToString();
+    }
+};
+
+template<>
+struct LRUKeyTraits<std::string> : StringKeyTraits<char> {};
+
+template<>
+struct LRUKeyTraits<std::wstring> : StringKeyTraits<wchar_t> {};
+
+}   // namespace internal
+
 // Standardize type argument signatures of std::map and std::unordered_map.
+// `BasicMapType` uses the allocator given instead of the default one.
 
 template<typename Key, typename Value>
 struct TreeMap {
+    template<typename Allocator>
+    using BasicMapType = std::map<Key, Value, std::less<Key>, Allocator>;
+
     using MapType = std::map<Key, Value>;
 };
 
 template<typename Key, typename Value>
 struct HashMap {
+    template<typename Allocator>
+    using BasicMapType = std::unordered_map<Key, Value, std::hash<Key>, std::equal_to<Key>,
+                                            Allocator>;
+
     using MapType = std::unordered_map<Key, Value>;
 };
 
+// The default weigher of LRUCache, with which `max_size` limits the number of entries.
+struct UnitWeigher {
+    template<typename Key, typename Entry>
+    constexpr size_t operator()(const Key&, const Entry&) const noexcept
+    {
+        return 1;
+    }
+};
+
 // A cache container that allows O(logn)-time, i.e. TreeMap-based implementation,
 // or O(1)-time, i.e. HashMap-based implementation, access to entries using a key.
 // If auto eviction is enabled, LRU-replacement algorithm would be employed when
 // the cache runs out its free storage.
-template<typename Key, typename Entry, template<typename, typename> class Map = TreeMap>
+// A `Weigher` is a functor returning the weight of a pair of <key, entry>, e.g. the size of the
+// entry in bytes, and `max_size` then limits the total weight of entries. The weight of an
+// entry is taken whenever it is put, evicted or erased, so it must not change while the entry
+// is cached; update an entry via `Put()` rather than through iterators, if its weight changes.
+// Entries may also expire after a time-to-live, given for each entry or by default:
+//   - `Get()` and `find()` never return an expired entry, and non-const ones erase it;
+//   - each `Put()` erases a few expired entries, earliest expiry first, before evicting;
+//   - expired entries not erased yet are still counted and iterated.
+// Entries without a time-to-live cost neither a clock read nor an expiry index node.
+// Each key is stored only once, in its entry; and caches with `std::string` or `std::wstring`
+// keys look up entries with string views, without constructing temporary keys.
+// A `Stats` policy records statistics of the cache, and `NoCacheStats` records nothing at no
+// cost; use `CacheStatsRecorder` to take snapshots via `stats()`.
+// Nodes of entries and indices are allocated from a `NodePool` of the cache, on top of
+// `Allocator`, and nodes freed by evictions are reused by insertions; so a full cache puts new
+// entries without heap allocations. The pool keeps up to `NodePool::kMaxKeptBlocks` freed nodes
+// of each size until the cache is destroyed, even if most entries have been erased. A moved-from
+// cache gets a pool of its own.
+template<typename Key, typename Entry, template<typename, typename> class Map = TreeMap,
+         typename Weigher = UnitWeigher, typename Stats = NoCacheStats,
+         typename Allocator = std::allocator<std::pair<const Key, Entry>>>
 class LRUCache {
 public:
     using key_type = Key;
     using value_type = std::pair<const Key, Entry>;
 
 private:
-    using CachedEntryList = std::list<value_type>;
-    using KeyTable = typename Map<Key, typename CachedEntryList::iterator>::MapType;
+    using KeyTraits = internal::LRUKeyTraits<Key>;
+
+    template<typename T>
+    using PoolAllocator = NodePoolAllocator<T, Allocator>;
+
+    using CachedEntryList = std::list<value_type, PoolAllocator<value_type>>;
+    using ExpiryIndex = std::multimap<
+        TimePoint, typename CachedEntryList::iterator, std::less<TimePoint>,
+        PoolAllocator<std::pair<const TimePoint, typename CachedEntryList::iterator>>>;
+
+    struct Slot {
+        typename CachedEntryList::iterator position;
+        // Valid only if `expires` is true.
+        typename ExpiryIndex::iterator expiry;
+        bool expires;
+    };
+
+    using KeyTable = typename Map<typename KeyTraits::TableKey, Slot>::template BasicMapType<
+        PoolAllocator<std::pair<const typename KeyTraits::TableKey, Slot>>>;
+
+    // The number of expired entries a Put erases at most.
+    static constexpr size_t kSweepBatch = 4;
 
 public:
+    // `const Key&`, or a string view for string keys.
+    using lookup_key_type = typename KeyTraits::LookupKey;
+    using ClockSource = std::function<TimePoint()>;
+    using EvictionCallback = std::function<void(const Key&, Entry&, EvictionReason)>;
+    using TimeToLive = Clock::duration;
     using size_type = size_t;
     using iterator = typename CachedEntryList::iterator;
     using const_iterator = typename CachedEntryList::const_iterator;
     using reverse_iterator = typename CachedEntryList::reverse_iterator;
     using const_reverse_iterator = typename CachedEntryList::const_reverse_iterator;
+    using allocator_type = PoolAllocator<value_type>;
 
     enum : size_type {
         NoAutoEvict = 0
     };
 
-    explicit LRUCache(size_type max_size) noexcept(
-        std::is_nothrow_default_constructible<CachedEntryList>::value &&
-        std::is_nothrow_default_constructible<KeyTable>::value)
-        : max_size_(max_size)
+    explicit LRUCache(size_type max_size, const Weigher& weigher = Weigher(),
+                      const Allocator& allocator = Allocator())
+        : LRUCache(max_size, weigher, MakePoolAllocator(allocator))
     {}
 
-    LRUCache(LRUCache&& other) noexcept(
-        std::is_nothrow_move_constructible<CachedEntryList>::value &&
-        std::is_nothrow_move_constructible<KeyTable>::value)
+    // Not noexcept, since `other` is given a new pool, see `ResetContainers()`.
+    LRUCache(LRUCache&& other)
         : max_size_(other.max_size_),
+          weigher_(std::move(other.weigher_)),
           entry_ordering_list_(std::move(other.entry_ordering_list_)),
-          key_table_(std::move(other.key_table_))
-    {}
+          key_table_(std::move(other.key_table_)),
+          expiry_index_(std::move(other.expiry_index_)),
+          clock_(std::move(other.clock_)),
+          eviction_callback_(std::move(other.eviction_callback_)),
+          default_ttl_(other.default_ttl_),
+          total_weight_(other.total_weight_),
+          stats_(std::move(other.stats_))
+    {
+        other.clock_ = &Clock::now;
+        other.total_weight_ = 0;
+        other.ResetContainers(MakePoolAllocator(get_allocator().pool()->get_allocator()));
+    }
 
     LRUCache& operator=(LRUCache&& rhs) noexcept(
         std::is_nothrow_move_assignable<CachedEntryList>::value &&
-        std::is_nothrow_move_assignable<KeyTable>::value)
+        std::is_nothrow_move_assignable<KeyTable>::value &&
+        std::is_nothrow_move_assignable<ExpiryIndex>::value &&
+        std::is_nothrow_move_assignable<ClockSource>::value &&
+        std::is_nothrow_move_assignable<EvictionCallback>::value &&
+        std::is_nothrow_move_assignable<Weigher>::value &&
+        std::is_nothrow_move_assignable<Stats>::value)
     {
         if (this != &rhs) {
+            // The pool of this cache is handed over to `rhs`, which is empty afterwards.
+            auto released_allocator = get_allocator();
+            weigher_ = std::move(rhs.weigher_);
             entry_ordering_list_ = std::move(rhs.entry_ordering_list_);
             key_table_ = std::move(rhs.key_table_);
+            expiry_index_ = std::move(rhs.expiry_index_);
+            clock_ = std::move(rhs.clock_);
+            rhs.clock_ = &Clock::now;
+            eviction_callback_ = std::move(rhs.eviction_callback_);
+            default_ttl_ = rhs.default_ttl_;
+            total_weight_ = rhs.total_weight_;
+            rhs.total_weight_ = 0;
+            stats_ = std::move(rhs.stats_);
             // Work-around for assigning to a const variable.
             size_type* new_max_size = const_cast<size_type*>(&max_size_);
             *new_max_size = rhs.max_size_;
+            rhs.ResetContainers(released_allocator);
         }
 
         return *this;
@@ -94,30 +259,82 @@ public:
     // the entry.
     // If auto-eviction is enabled for the cache, and also cache runs out its free
     // storage, then LRU replacement algorithm is employed when caching into new
-    // entry.
+    // entry, and as many entries as needed are evicted.
+    // An entry weighing more than `max_size` is rejected, and end() is returned; the old entry
+    // of the key, if any, is erased as well, rather than being left stale.
+    // The entry expires after `ttl`, or after the default time-to-live if not given; a zero
+    // time-to-live means never. Updating an entry restarts its time-to-live.
 
     iterator Put(const Key& key, const Entry& entry)
     {
-        return PutInternal(key, entry);
+        return PutInternal(key, entry, default_ttl_);
     }
 
     iterator Put(const Key& key, Entry&& entry)
     {
-        return PutInternal(key, std::move(entry));
+        return PutInternal(key, std::move(entry), default_ttl_);
+    }
+
+    iterator Put(const Key& key, const Entry& entry, TimeToLive ttl)
+    {
+        return PutInternal(key, entry, ttl);
+    }
+
+    iterator Put(const Key& key, Entry&& entry, TimeToLive ttl)
+    {
+        return PutInternal(key, std::move(entry), ttl);
+    }
+
+    // Constructs the entry in place with `args`, or replaces the entry of `key` with the one
+    // constructed, and marks it as recently used; the key is constructed from `key`, which can
+    // also be a string view for string keys, only if it is not in the cache yet.
+    // Returns end() if the entry weighs more than `max_size`, as `Put()` does.
+    template<typename KeyArg, typename... Args>
+    iterator Emplace(KeyArg&& key, Args&&... args)
+    {
+        lookup_key_type lookup_key(key);
+        auto key_it = key_table_.find(KeyTraits::ToTableKey(lookup_key));
+        if (key_it != key_table_.end()) {
+            return UpdateEntry(key_it, Entry(std::forward<Args>(args)...), default_ttl_);
+        }
+
+        return EmplaceNewEntry(std::forward<KeyArg>(key), lookup_key,
+                               std::forward<Args>(args)...);
+    }
+
+    // Constructs the entry in place with `args` only if `key` is not in the cache, and returns
+    // the iterator to the entry and true; otherwise `args` are left untouched, the existing entry
+    // is marked as recently used, and returns the iterator to it and false.
+    // An expired entry counts as absent; and the iterator is end() if the new entry weighs more
+    // than `max_size`.
+    template<typename KeyArg, typename... Args>
+    std::pair<iterator, bool> TryEmplace(KeyArg&& key, Args&&... args)
+    {
+        lookup_key_type lookup_key(key);
+        auto entry_it = Get(lookup_key);
+        if (entry_it != end()) {
+            return {entry_it, false};
+        }
+
+        return {EmplaceNewEntry(std::forward<KeyArg>(key), lookup_key,
+                                std::forward<Args>(args)...), true};
     }
 
     // Returns the iterator to the value associated with `key`.
     // Returns end() if no matched value was found.
     // Access to a cached entry marks this entry as recently used by moving it to
     // the tail of cached entry list.
-    iterator Get(const Key& key)
+    // Only lookups with this function count as hits or misses of the statistics.
+    iterator Get(lookup_key_type key)
     {
-        auto key_it = key_table_.find(key);
+        auto key_it = FindUnexpired(key);
         if (key_it == key_table_.end()) {
+            stats_.RecordMiss();
             return end();
         }
 
-        auto entry_it = key_it->second;
+        stats_.RecordHit();
+        auto entry_it = key_it->second.position;
         entry_ordering_list_.splice(entry_ordering_list_.end(), entry_ordering_list_, entry_it);
 
         return entry_it;
@@ -127,39 +344,57 @@ public:
     // Returns end() if no such value was found.
     // These two functions does not touch the entry, i.e. will not mark the entry recently used.
 
-    const_iterator find(const Key& key) const
+    const_iterator find(lookup_key_type key) const
     {
-        auto key_it = key_table_.find(key);
-        if (key_it == key_table_.end()) {
+        auto key_it = key_table_.find(KeyTraits::ToTableKey(key));
+        if (key_it == key_table_.end() || (key_it->second.expires && IsExpired(key_it->second))) {
             return end();
         }
 
-        return key_it->second;
+        return key_it->second.position;
     }
 
-    iterator find(const Key& key)
+    iterator find(lookup_key_type key)
     {
-        auto key_it = key_table_.find(key);
+        auto key_it = FindUnexpired(key);
         if (key_it == key_table_.end()) {
             return end();
         }
 
-        return key_it->second;
+        return key_it->second.position;
+    }
+
+    // Returns true if the entry at `pos` has expired but has not been erased yet, e.g. while
+    // iterating the cache.
+    // It takes no lookup unless some entries have expired, when it looks up the key once.
+    bool expired(const_iterator pos) const
+    {
+        if (expiry_index_.empty() || expiry_index_.begin()->first > clock_()) {
+            return false;
+        }
+
+        const auto& slot = key_table_.find(KeyTraits::ToTableKey(pos->first))->second;
+        return slot.expires && IsExpired(slot);
     }
 
     // Erases the value with specific iterator, and returns the iterator to
     // the next value.
     iterator erase(const_iterator pos)
     {
-        key_table_.erase(pos->first);
-        return entry_ordering_list_.erase(pos);
+        return EraseEntry(pos, EvictionReason::Erased);
+    }
+
+    // Erases all expired entries.
+    void PurgeExpired()
+    {
+        SweepExpired(expiry_index_.size());
     }
 
     // Evict a single entry, or |count_to_evict| entries from cache.
 
     void Evict()
     {
-        erase(entry_ordering_list_.begin());
+        EraseEntry(entry_ordering_list_.begin(), EvictionReason::Capacity);
     }
 
     void Evict(size_type count_to_evict)
@@ -180,11 +415,49 @@ public:
         return entry_ordering_list_.empty();
     }
 
+    // The limit of the total weight, which is the number of entries with `UnitWeigher`.
     size_type max_size() const
     {
         return max_size_;
     }
 
+    size_type total_weight() const
+    {
+        return total_weight_;
+    }
+
+    // Applies to entries put afterwards.
+    void set_default_ttl(TimeToLive ttl) noexcept
+    {
+        default_ttl_ = ttl;
+    }
+
+    TimeToLive default_ttl() const noexcept
+    {
+        return default_ttl_;
+    }
+
+    // Replaces `Clock::now()` as the source of the current time, e.g. with a fake clock.
+    void set_clock(ClockSource clock)
+    {
+        clock_ = std::move(clock);
+    }
+
+    // The callback is called with the entry right before it leaves the cache, or is replaced by
+    // a new one of the same key; it must not modify the cache.
+    void set_eviction_callback(EvictionCallback callback)
+    {
+        eviction_callback_ = std::move(callback);
+    }
+
+    // Returns a snapshot of the statistics recorded, which is all zeros with `NoCacheStats`.
+    CacheStats stats() const
+    {
+        CacheStats snapshot;
+        stats_.AddTo(snapshot);
+        return snapshot;
+    }
+
     bool auto_evict() const
     {
         return max_size_ != 0;
@@ -202,34 +475,231 @@ public:
 
     const_iterator cend() const { return entry_ordering_list_.cend(); }
 
+    // Allocators of two caches are equal only if they share a pool.
+    allocator_type get_allocator() const
+    {
+        return entry_ordering_list_.get_allocator();
+    }
+
 private:
-    template<typename KeyType, typename EntryType>
-    iterator PutInternal(const KeyType& key, EntryType&& entry)
+    static allocator_type MakePoolAllocator(const Allocator& allocator)
     {
-        auto key_it = key_table_.find(key);
-        if (key_it != key_table_.end()) {
-            auto entry_it = key_it->second;
-            entry_it->second = std::forward<EntryType>(entry);
-            entry_ordering_list_.splice(entry_ordering_list_.end(), entry_ordering_list_, entry_it);
-            return entry_it;
+        return allocator_type(std::allocate_shared<NodePool<Allocator>>(allocator, allocator));
+    }
+
+    // Replaces containers, which must be empty, with ones allocating with `allocator`; a
+    // moved-from cache therefore never shares the pool with the cache it was moved to, since
+    // pools are not thread-safe.
+    void ResetContainers(const allocator_type& allocator)
+    {
+        entry_ordering_list_ = CachedEntryList(allocator);
+        key_table_ = KeyTable(allocator);
+        expiry_index_ = ExpiryIndex(allocator);
+    }
+
+    LRUCache(size_type max_size, const Weigher& weigher,
+             const PoolAllocator<value_type>& allocator)
+        : max_size_(max_size),
+          weigher_(weigher),
+          entry_ordering_list_(allocator),
+          key_table_(allocator),
+          expiry_index_(allocator),
+          clock_(&Clock::now)
+    {}
+
+    iterator EraseEntry(const_iterator pos, EvictionReason reason)
+    {
+        NotifyEviction(pos, reason);
+        total_weight_ -= weigher_(pos->first, pos->second);
+        auto key_it = key_table_.find(KeyTraits::ToTableKey(pos->first));
+        if (key_it->second.expires) {
+            expiry_index_.erase(key_it->second.expiry);
+        }
+
+        key_table_.erase(key_it);
+        return entry_ordering_list_.erase(pos);
+    }
+
+    void NotifyEviction(const_iterator pos, EvictionReason reason)
+    {
+        stats_.RecordEviction(reason);
+        if (eviction_callback_) {
+            // Entries themselves are never const; `pos` is const for taking both iterators.
+            auto& value = const_cast<value_type&>(*pos);
+            eviction_callback_(value.first, value.second, reason);
+        }
+    }
+
+    bool IsExpired(const Slot& slot) const
+    {
+        return slot.expiry->first <= clock_();
+    }
+
+    // Erases the entry if it has expired.
+    typename KeyTable::iterator FindUnexpired(lookup_key_type key)
+    {
+        auto key_it = key_table_.find(KeyTraits::ToTableKey(key));
+        if (key_it != key_table_.end() && key_it->second.expires && IsExpired(key_it->second)) {
+            EraseEntry(key_it->second.position, EvictionReason::Expired);
+            return key_table_.end();
+        }
+
+        return key_it;
+    }
+
+    // Erases at most `max_count` expired entries.
+    void SweepExpired(size_t max_count)
+    {
+        if (expiry_index_.empty()) {
+            return;
         }
 
-        if (auto_evict() && max_size() == size()) {
+        auto now = clock_();
+        for (size_t i = 0; i < max_count; ++i) {
+            auto earliest = expiry_index_.begin();
+            if (earliest == expiry_index_.end() || earliest->first > now) {
+                break;
+            }
+
+            EraseEntry(earliest->second, EvictionReason::Expired);
+        }
+    }
+
+    void SetExpiry(Slot& slot, TimeToLive ttl)
+    {
+        if (slot.expires) {
+            expiry_index_.erase(slot.expiry);
+            slot.expires = false;
+        }
+
+        if (ttl != TimeToLive::zero()) {
+            slot.expiry = expiry_index_.insert({clock_() + ttl, slot.position});
+            slot.expires = true;
+        }
+    }
+
+    template<typename EntryType>
+    iterator UpdateEntry(typename KeyTable::iterator key_it, EntryType&& entry, TimeToLive ttl)
+    {
+        auto entry_it = key_it->second.position;
+        auto weight = weigher_(entry_it->first, static_cast<const Entry&>(entry));
+        if (auto_evict() && weight > max_size()) {
+            EraseEntry(entry_it, EvictionReason::Capacity);
+            return end();
+        }
+
+        NotifyEviction(entry_it, EvictionReason::Replaced);
+        stats_.RecordUpdate();
+        total_weight_ -= weigher_(entry_it->first, entry_it->second);
+        entry_it->second = std::forward<EntryType>(entry);
+        total_weight_ += weight;
+        entry_ordering_list_.splice(entry_ordering_list_.end(), entry_ordering_list_, entry_it);
+        SetExpiry(key_it->second, ttl);
+        // The updated entry is the last one to evict, and it alone fits.
+        while (auto_evict() && total_weight_ > max_size()) {
+            Evict();
+        }
+
+        return entry_it;
+    }
+
+    // Makes room for the entry, which was constructed in `staging`, and moves it into the cache.
+    iterator LinkNewEntry(CachedEntryList& staging, size_type weight, TimeToLive ttl)
+    {
+        // Expired entries go first, while the sweep is bounded to keep Put cheap.
+        SweepExpired(kSweepBatch);
+        while (auto_evict() && max_size() - total_weight_ < weight) {
             Evict();
         }
 
-        entry_ordering_list_.push_back({key, std::forward<EntryType>(entry)});
-        auto rv = key_table_.insert({key, std::prev(entry_ordering_list_.end())});
+        auto entry_it = staging.begin();
+        entry_ordering_list_.splice(entry_ordering_list_.end(), staging, entry_it);
+        auto rv = key_table_.insert({KeyTraits::ToTableKey(entry_it->first),
+                                     Slot{entry_it, {}, false}});
+        total_weight_ += weight;
+        SetExpiry(rv.first->second, ttl);
+        stats_.RecordInsertion(size());
+
+        return entry_it;
+    }
 
-        return rv.first->second;
+    // Arguments to construct the key in place.
+
+    template<typename KeyArg>
+    static std::tuple<KeyArg&&> KeyConstructionArgs(KeyArg&& key, lookup_key_type,
+                                                    std::true_type) noexcept
+    {
+        return std::forward_as_tuple(std::forward<KeyArg>(key));
+    }
+
+    // E.g. a string view for a string key.
+    template<typename KeyArg>
+    static std::tuple<Key> KeyConstructionArgs(KeyArg&&, lookup_key_type lookup_key,
+                                               std::false_type)
+    {
+        return std::tuple<Key>(KeyTraits::MakeKey(lookup_key));
+    }
+
+    template<typename KeyArg, typename... Args>
+    iterator EmplaceNewEntry(KeyArg&& key, lookup_key_type lookup_key, Args&&... args)
+    {
+        CachedEntryList staging(entry_ordering_list_.get_allocator());
+        staging.emplace_back(std::piecewise_construct,
+                             KeyConstructionArgs(std::forward<KeyArg>(key), lookup_key,
+                                                 std::is_constructible<Key, KeyArg&&>()),
+                             std::forward_as_tuple(std::forward<Args>(args)...));
+        auto weight = weigher_(staging.front().first, staging.front().second);
+        if (auto_evict() && weight > max_size()) {
+            return end();
+        }
+
+        return LinkNewEntry(staging, weight, default_ttl_);
+    }
+
+    template<typename EntryType>
+    iterator PutInternal(const Key& key, EntryType&& entry, TimeToLive ttl)
+    {
+        auto key_it = key_table_.find(KeyTraits::ToTableKey(key));
+        if (key_it != key_table_.end()) {
+            return UpdateEntry(key_it, std::forward<EntryType>(entry), ttl);
+        }
+
+        auto weight = weigher_(key, static_cast<const Entry&>(entry));
+        if (auto_evict() && weight > max_size()) {
+            return end();
+        }
+
+        CachedEntryList staging(entry_ordering_list_.get_allocator());
+        staging.emplace_back(key, std::forward<EntryType>(entry));
+        return LinkNewEntry(staging, weight, ttl);
     }
 
 private:
     const size_type max_size_;
+    Weigher weigher_;
     CachedEntryList entry_ordering_list_;
     KeyTable key_table_;
+    // Entries with a time-to-live only, ordered by their expiry times.
+    ExpiryIndex expiry_index_;
+    ClockSource clock_;
+    EvictionCallback eviction_callback_;
+    TimeToLive default_ttl_ = TimeToLive::zero();
+    size_type total_weight_ = 0;
+    Stats stats_;
 };
 
 }   // namespace kbase
 
+namespace std {
+
+template<typename Key>
+struct hash<kbase::internal::KeyRef<Key>> {
+    size_t operator()(kbase::internal::KeyRef<Key> key) const
+    {
+        return hash<Key>()(key.get());
+    }
+};
+
+}   // namespace std
+
 #endif  // KBASE_LRU_CACHE_H_
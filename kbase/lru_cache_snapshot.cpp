@@ -0,0 +1,92 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "kbase/lru_cache_snapshot.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+// "KBLR" in little-endian.
+constexpr uint32_t kSnapshotMagic = 0x524C424B;
+constexpr uint32_t kSnapshotVersion = 2;
+
+// The size of the header of a pickle, which holds the size of its payload.
+constexpr size_t kPickleHeaderSize = sizeof(uint32_t);
+
+}   // namespace
+
+namespace kbase {
+
+namespace internal {
+
+void WriteSnapshotHeader(std::ostream& out, const std::string& types)
+{
+    Pickle header;
+    header << kSnapshotMagic << kSnapshotVersion << types;
+    WriteSnapshotChunk(out, header);
+}
+
+bool ReadSnapshotHeader(std::istream& in, const std::string& types)
+{
+    std::vector<byte> buffer;
+    if (!ReadSnapshotChunk(in, buffer)) {
+        return false;
+    }
+
+    PickleReader reader(buffer.data(), buffer.size());
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    std::string saved_types;
+    try {
+        reader >> magic >> version;
+        if (magic != kSnapshotMagic || version != kSnapshotVersion) {
+            return false;
+        }
+
+        reader >> saved_types;
+    } catch (const EnsureFailure&) {
+        return false;
+    }
+
+    return !reader && saved_types == types;
+}
+
+void WriteSnapshotChunk(std::ostream& out, const Pickle& chunk)
+{
+    out.write(static_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+}
+
+bool ReadSnapshotChunk(std::istream& in, std::vector<byte>& buffer)
+{
+    uint32_t payload_size = 0;
+    if (!in.read(reinterpret_cast<char*>(&payload_size), sizeof(payload_size))) {
+        return false;
+    }
+
+    buffer.resize(kPickleHeaderSize);
+    memcpy(buffer.data(), &payload_size, kPickleHeaderSize);
+
+    // Grows the buffer as data arrives, lest a corrupted size make us allocate gigabytes.
+    size_t remaining = payload_size;
+    while (remaining != 0) {
+        auto piece = std::min(remaining, kSnapshotChunkSize);
+        auto offset = buffer.size();
+        buffer.resize(offset + piece);
+        if (!in.read(reinterpret_cast<char*>(buffer.data() + offset),
+                     static_cast<std::streamsize>(piece))) {
+            return false;
+        }
+
+        remaining -= piece;
+    }
+
+    return true;
+}
+
+}   // namespace internal
+
+}   // namespace kbase
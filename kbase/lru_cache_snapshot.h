@@ -0,0 +1,231 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef KBASE_LRU_CACHE_SNAPSHOT_H_
+#define KBASE_LRU_CACHE_SNAPSHOT_H_
+
+#include <fstream>
+#include <istream>
+#include <list>
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "kbase/basic_macros.h"
+#include "kbase/basic_types.h"
+#include "kbase/lru_cache.h"
+#include "kbase/path.h"
+#include "kbase/pickle.h"
+
+namespace kbase {
+
+namespace internal {
+
+// Entries are pickled into chunks of about this size, each of which is written out as soon as
+// it is full.
+constexpr size_t kSnapshotChunkSize = 64 * 1024;
+
+// Describes how values of `T` are pickled, so that a snapshot is never loaded into a cache of
+// other key or entry types. Types pickled by operators of their own are described by their
+// sizes only.
+template<typename T, typename = void>
+struct SnapshotType {
+    static std::string Describe()
+    {
+        return "?" + std::to_string(sizeof(T));
+    }
+};
+
+template<typename T>
+struct SnapshotType<T, typename std::enable_if<std::is_arithmetic<T>::value>::type> {
+    static std::string Describe()
+    {
+        char tag = std::is_same<T, bool>::value ? 'b' :
+                   std::is_floating_point<T>::value ? 'f' :
+                   std::is_signed<T>::value ? 'i' : 'u';
+        return tag + std::to_string(sizeof(T));
+    }
+};
+
+template<typename CharT, typename Traits, typename Alloc>
+struct SnapshotType<std::basic_string<CharT, Traits, Alloc>> {
+    static std::string Describe()
+    {
+        return "s" + std::to_string(sizeof(CharT));
+    }
+};
+
+template<typename T1, typename T2>
+struct SnapshotType<std::pair<T1, T2>> {
+    static std::string Describe()
+    {
+        return "(" + SnapshotType<T1>::Describe() + "," + SnapshotType<T2>::Describe() + ")";
+    }
+};
+
+// Containers are pickled as a number of elements followed by the elements.
+
+template<typename T>
+struct SnapshotSequenceType {
+    static std::string Describe()
+    {
+        return "[" + SnapshotType<T>::Describe() + "]";
+    }
+};
+
+template<typename T, typename Alloc>
+struct SnapshotType<std::vector<T, Alloc>> : SnapshotSequenceType<T> {};
+
+template<typename T, typename Alloc>
+struct SnapshotType<std::list<T, Alloc>> : SnapshotSequenceType<T> {};
+
+template<typename T, typename Compare, typename Alloc>
+struct SnapshotType<std::set<T, Compare, Alloc>> : SnapshotSequenceType<T> {};
+
+template<typename T, typename Hash, typename KeyEqual, typename Alloc>
+struct SnapshotType<std::unordered_set<T, Hash, KeyEqual, Alloc>> : SnapshotSequenceType<T> {};
+
+template<typename Key, typename T, typename Compare, typename Alloc>
+struct SnapshotType<std::map<Key, T, Compare, Alloc>>
+    : SnapshotSequenceType<std::pair<Key, T>> {};
+
+template<typename Key, typename T, typename Hash, typename KeyEqual, typename Alloc>
+struct SnapshotType<std::unordered_map<Key, T, Hash, KeyEqual, Alloc>>
+    : SnapshotSequenceType<std::pair<Key, T>> {};
+
+// `types` is the description of the key and entry types of the cache.
+void WriteSnapshotHeader(std::ostream& out, const std::string& types);
+
+// Returns false if the header is corrupted, or the snapshot was saved from a cache of types
+// other than `types`.
+bool ReadSnapshotHeader(std::istream& in, const std::string& types);
+
+// Writes the whole pickle, including its header.
+void WriteSnapshotChunk(std::ostream& out, const Pickle& chunk);
+
+// Reads a chunk written by `WriteSnapshotChunk()` into `buffer`.
+// Returns false if no complete chunk could be read.
+bool ReadSnapshotChunk(std::istream& in, std::vector<byte>& buffer);
+
+// Returns false if the data is corrupted, in which case `key` and `entry` are partially read.
+template<typename Key, typename Entry>
+bool ReadSnapshotEntry(PickleReader& reader, Key& key, Entry& entry)
+{
+    try {
+        reader >> key >> entry;
+    } catch (const EnsureFailure&) {
+        return false;
+    }
+
+    return true;
+}
+
+}   // namespace internal
+
+// Snapshots of `LRUCache`, which make a restarted process resume with the hot set and the LRU
+// ordering of the cache it saved.
+// Entries are pickled from the least recently used one to the most recently used one, and are
+// streamed out chunk by chunk; so are they loaded, without reading the whole snapshot into
+// memory at once. Keys and entries are therefore required to be pickle-able, see `Pickle`.
+// Expired entries are not saved; time-to-lives are not saved either, and loaded entries get
+// the default time-to-live of the cache loading them.
+
+// Returns false if failed to write to `out`.
+template<typename Key, typename Entry, template<typename, typename> class Map,
+         typename Weigher, typename Stats, typename Allocator>
+bool SaveSnapshot(const LRUCache<Key, Entry, Map, Weigher, Stats, Allocator>& cache,
+                  std::ostream& out)
+{
+    internal::WriteSnapshotHeader(out, internal::SnapshotType<std::pair<Key, Entry>>::Describe());
+    Pickle chunk;
+    for (auto it = cache.begin(); it != cache.end() && out; ++it) {
+        if (cache.expired(it)) {
+            continue;
+        }
+
+        chunk << it->first << it->second;
+        if (chunk.payload_size() >= internal::kSnapshotChunkSize) {
+            internal::WriteSnapshotChunk(out, chunk);
+            chunk = Pickle();
+        }
+    }
+
+    if (!chunk.payload_empty()) {
+        internal::WriteSnapshotChunk(out, chunk);
+    }
+
+    // An empty chunk marks the end.
+    internal::WriteSnapshotChunk(out, Pickle());
+    out.flush();
+
+    return !!out;
+}
+
+// Puts entries saved into the cache in the order they were saved, so that they end up in the
+// same LRU ordering, and are more recently used than entries already in the cache.
+// Returns false if the snapshot is not complete, is corrupted, is not a snapshot, or was saved
+// from a cache of other key or entry types; entries read before the failure remain in the
+// cache, but an entry failed to read is never put.
+template<typename Key, typename Entry, template<typename, typename> class Map,
+         typename Weigher, typename Stats, typename Allocator>
+bool LoadSnapshot(std::istream& in, LRUCache<Key, Entry, Map, Weigher, Stats, Allocator>& cache)
+{
+    if (!internal::ReadSnapshotHeader(in,
+                                      internal::SnapshotType<std::pair<Key, Entry>>::Describe())) {
+        return false;
+    }
+
+    std::vector<byte> buffer;
+    while (internal::ReadSnapshotChunk(in, buffer)) {
+        PickleReader reader(buffer.data(), buffer.size());
+        if (!reader) {
+            return true;
+        }
+
+        while (reader) {
+            Key key;
+            Entry entry;
+            if (!internal::ReadSnapshotEntry(reader, key, entry)) {
+                return false;
+            }
+
+            cache.Put(key, std::move(entry));
+        }
+    }
+
+    return false;
+}
+
+// Overloads with files; saving overwrites the file if it exists.
+
+template<typename Key, typename Entry, template<typename, typename> class Map,
+         typename Weigher, typename Stats, typename Allocator>
+bool SaveSnapshot(const LRUCache<Key, Entry, Map, Weigher, Stats, Allocator>& cache,
+                  const Path& path)
+{
+    std::ofstream out(path.value(), std::ios::out | std::ios::binary | std::ios::trunc);
+    return out && SaveSnapshot(cache, out);
+}
+
+template<typename Key, typename Entry, template<typename, typename> class Map,
+         typename Weigher, typename Stats, typename Allocator>
+bool LoadSnapshot(const Path& path, LRUCache<Key, Entry, Map, Weigher, Stats, Allocator>& cache)
+{
+    std::ifstream in(path.value(), std::ios::in | std::ios::binary);
+    return in && LoadSnapshot(in, cache);
+}
+
+}   // namespace kbase
+
+#endif  // KBASE_LRU_CACHE_SNAPSHOT_H_
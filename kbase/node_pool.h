@@ -0,0 +1,231 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef KBASE_NODE_POOL_H_
+#define KBASE_NODE_POOL_H_
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+namespace kbase {
+
+// A pool recycling memory blocks of node-based containers, which allocate one node at a time.
+// Blocks deallocated are kept in a free list of their size, and are handed out again by later
+// allocations of the same size, instead of being returned to `Allocator`; so a container
+// freeing and allocating nodes at the same rate, e.g. a cache evicting entries, does no heap
+// allocation in steady state.
+// Free lists are made for the first few sizes of blocks only, and blocks of other sizes go to
+// `Allocator` directly. Each free list keeps at most `kMaxKeptBlocks` blocks, and blocks freed
+// beyond that, e.g. by erasing most of a container, go back to `Allocator` as well; blocks kept
+// are released when the pool is destroyed.
+// The pool is not thread-safe, as the containers using it are not.
+template<typename Allocator>
+class NodePool {
+    using Block = typename std::aligned_storage<alignof(std::max_align_t),
+                                                alignof(std::max_align_t)>::type;
+    using BlockAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Block>;
+    using BlockTraits = std::allocator_traits<BlockAllocator>;
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct FreeList {
+        // The size of blocks in units of `Block`; 0 if the list is not made yet.
+        size_t units = 0;
+        size_t count = 0;
+        FreeBlock* head = nullptr;
+    };
+
+    static constexpr size_t kMaxFreeLists = 4;
+
+public:
+    static constexpr size_t kMaxKeptBlocks = 1024;
+
+    explicit NodePool(const Allocator& allocator = Allocator())
+        : allocator_(allocator)
+    {}
+
+    ~NodePool()
+    {
+        for (auto& free_list : free_lists_) {
+            while (free_list.head) {
+                auto block = free_list.head;
+                free_list.head = block->next;
+                BlockTraits::deallocate(allocator_, reinterpret_cast<Block*>(block),
+                                        free_list.units);
+            }
+        }
+    }
+
+    NodePool(const NodePool&) = delete;
+
+    NodePool& operator=(const NodePool&) = delete;
+
+    void* Allocate(size_t size)
+    {
+        auto units = UnitsOf(size);
+        auto free_list = FindFreeList(units, false);
+        if (free_list && free_list->head) {
+            auto block = free_list->head;
+            free_list->head = block->next;
+            --free_list->count;
+            --free_count_;
+            return block;
+        }
+
+        return BlockTraits::allocate(allocator_, units);
+    }
+
+    void Deallocate(void* ptr, size_t size) noexcept
+    {
+        auto units = UnitsOf(size);
+        auto free_list = FindFreeList(units, true);
+        if (!free_list || free_list->count == kMaxKeptBlocks) {
+            BlockTraits::deallocate(allocator_, static_cast<Block*>(ptr), units);
+            return;
+        }
+
+        free_list->head = ::new (ptr) FreeBlock{free_list->head};
+        ++free_list->count;
+        ++free_count_;
+    }
+
+    // Allocations not of nodes, e.g. bucket arrays of hash tables, are not pooled.
+
+    void* AllocateUnpooled(size_t size)
+    {
+        return BlockTraits::allocate(allocator_, UnitsOf(size));
+    }
+
+    void DeallocateUnpooled(void* ptr, size_t size) noexcept
+    {
+        BlockTraits::deallocate(allocator_, static_cast<Block*>(ptr), UnitsOf(size));
+    }
+
+    Allocator get_allocator() const
+    {
+        return Allocator(allocator_);
+    }
+
+    // The number of blocks kept for reuse.
+    size_t free_count() const noexcept
+    {
+        return free_count_;
+    }
+
+private:
+    static size_t UnitsOf(size_t size) noexcept
+    {
+        return (size + sizeof(Block) - 1) / sizeof(Block);
+    }
+
+    // Makes a free list for `units` if there is none and `make` is true.
+    FreeList* FindFreeList(size_t units, bool make) noexcept
+    {
+        for (auto& free_list : free_lists_) {
+            if (free_list.units == units) {
+                return &free_list;
+            }
+
+            if (free_list.units == 0) {
+                if (!make) {
+                    return nullptr;
+                }
+
+                free_list.units = units;
+                return &free_list;
+            }
+        }
+
+        return nullptr;
+    }
+
+private:
+    BlockAllocator allocator_;
+    std::array<FreeList, kMaxFreeLists> free_lists_;
+    size_t free_count_ = 0;
+};
+
+// An allocator allocating single objects from a shared `NodePool`, and arrays from the
+// allocator of the pool. Allocators are equal if they share the pool.
+// A moved-from allocator still shares the pool, so that a moved-from container stays usable;
+// since the pool is not thread-safe, a container that is moved from and used afterwards should
+// be given an allocator with a new pool, as `LRUCache` does.
+template<typename T, typename Allocator = std::allocator<T>>
+class NodePoolAllocator {
+public:
+    using value_type = T;
+    using Pool = NodePool<Allocator>;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    explicit NodePoolAllocator(std::shared_ptr<Pool> pool) noexcept
+        : pool_(std::move(pool))
+    {}
+
+    NodePoolAllocator(const NodePoolAllocator&) noexcept = default;
+
+    template<typename U>
+    NodePoolAllocator(const NodePoolAllocator<U, Allocator>& other) noexcept
+        : pool_(other.pool())
+    {}
+
+    NodePoolAllocator& operator=(const NodePoolAllocator&) noexcept = default;
+
+    T* allocate(size_t n)
+    {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "Over-aligned type");
+        if (n == 1) {
+            return static_cast<T*>(pool_->Allocate(sizeof(T)));
+        }
+
+        return static_cast<T*>(pool_->AllocateUnpooled(n * sizeof(T)));
+    }
+
+    void deallocate(T* ptr, size_t n) noexcept
+    {
+        if (n == 1) {
+            pool_->Deallocate(ptr, sizeof(T));
+        } else {
+            pool_->DeallocateUnpooled(ptr, n * sizeof(T));
+        }
+    }
+
+    const std::shared_ptr<Pool>& pool() const noexcept
+    {
+        return pool_;
+    }
+
+private:
+    std::shared_ptr<Pool> pool_;
+};
+
+template<typename T, typename U, typename Allocator>
+bool operator==(const NodePoolAllocator<T, Allocator>& lhs,
+                const NodePoolAllocator<U, Allocator>& rhs) noexcept
+{
+    return lhs.pool() == rhs.pool();
+}
+
+template<typename T, typename U, typename Allocator>
+bool operator!=(const NodePoolAllocator<T, Allocator>& lhs,
+                const NodePoolAllocator<U, Allocator>& rhs) noexcept
+{
+    return !(lhs == rhs);
+}
+
+template<typename Allocator>
+constexpr size_t NodePool<Allocator>::kMaxKeptBlocks;
+
+}   // namespace kbase
+
+#endif  // KBASE_NODE_POOL_H_
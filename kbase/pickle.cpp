@@ -46,6 +46,9 @@ PickleReader& PickleReader::operator>>(std::string& value)
     size_t length;
     reader >> length;
     if (length != 0) {
+        // The length may come from corrupted data.
+        ENSURE(THROW, length <= remaining_size() / sizeof(std::string::value_type))(length).Require(
+            "Pickled string runs past the end of data");
         auto* dest = WriteInto(value, length + 1);
         ReadRawData(dest, sizeof(std::string::value_type) * length);
     }
@@ -59,6 +62,9 @@ PickleReader& PickleReader::operator>>(std::wstring& value)
     size_t length;
     reader >> length;
     if (length != 0) {
+        // The length may come from corrupted data.
+        ENSURE(THROW, length <= remaining_size() / sizeof(std::wstring::value_type))(length).Require(
+            "Pickled string runs past the end of data");
         auto* dest = WriteInto(value, length + 1);
         ReadRawData(dest, sizeof(std::wstring::value_type) * length);
     }
@@ -68,7 +74,9 @@ PickleReader& PickleReader::operator>>(std::wstring& value)
 
 void PickleReader::ReadRawData(void* dest, size_t size_in_bytes)
 {
-    ENSURE(CHECK, !!*this && size_in_bytes != 0).Require();
+    ENSURE(CHECK, size_in_bytes != 0).Require();
+    ENSURE(THROW, size_in_bytes <= remaining_size())(size_in_bytes).Require(
+        "Pickled data ends before the value");
     SecureMemcpy(dest, size_in_bytes, read_ptr_, size_in_bytes);
     SeekReadPosition(size_in_bytes);
 }
@@ -77,6 +85,7 @@ template<typename T>
 void PickleReader::ReadBuiltIn(T& value)
 {
     static_assert(std::is_fundamental<T>::value, "T is not built-in type");
+    ENSURE(THROW, sizeof(T) <= remaining_size()).Require("Pickled data ends before the value");
     value = *reinterpret_cast<const T*>(read_ptr_);
     SeekReadPosition(sizeof(T));
 }
@@ -176,6 +185,14 @@ void Pickle::ResizeCapacity(size_t new_capacity)
     capacity_ = new_capacity;
 }
 
+void Pickle::Reserve(size_t payload_size)
+{
+    size_t required_capacity = sizeof(Header) + payload_size;
+    if (required_capacity > capacity_) {
+        ResizeCapacity(required_capacity);
+    }
+}
+
 Pickle& Pickle::operator<<(const std::string& value)
 {
     Pickle& pickle = *this;
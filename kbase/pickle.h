@@ -13,8 +13,11 @@
 #include <list>
 #include <map>
 #include <set>
+#include <string>
+#include <type_traits>
 #include <unordered_set>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "kbase/basic_macros.h"
@@ -46,6 +49,12 @@ public:
         return read_ptr_ < data_end_;
     }
 
+    // Returns the number of bytes not read yet.
+    size_t remaining_size() const noexcept
+    {
+        return read_ptr_ < data_end_ ? static_cast<size_t>(data_end_ - read_ptr_) : 0;
+    }
+
     PickleReader& operator>>(bool& value)
     {
         ReadBuiltIn(value);
@@ -197,6 +206,24 @@ public:
         return payload_size() == 0;
     }
 
+    // Returns the size of internal buffer, including header, in bytes.
+    size_t capacity() const noexcept
+    {
+        return capacity_;
+    }
+
+    // Makes room for a payload of `payload_size` bytes in total, so that writing data up to the
+    // size causes no reallocation. Does nothing if the capacity is large enough already.
+    void Reserve(size_t payload_size);
+
+    // Discards the payload but keeps the capacity, so that the pickle can be reused for
+    // writing another one.
+    void Clear() noexcept
+    {
+        ENSURE(CHECK, header_ != nullptr).Require();
+        header_->payload_size = 0;
+    }
+
     Pickle& operator<<(bool value)
     {
         WriteBuiltIn(value);
@@ -277,6 +304,7 @@ private:
 
     // Locates to an uint32-aligned offset as the starting position, and resizes
     // the internal buffer if free space is less than demand(padding plus `length`).
+    // The buffer at least doubles on each resize, so that writes take amortized O(1) time.
     byte* SeekWritePosition(size_t length);
 
     // Serializes data in built-in type.
@@ -301,22 +329,241 @@ private:
     friend class PickleReader;
 };
 
-// Support for usual containers
+// Estimation of pickled sizes
+
+namespace internal {
+
+// Every segment starts on a 4-byte aligned offset.
+constexpr size_t AlignedPickledSize(size_t size_in_bytes) noexcept
+{
+    return (size_in_bytes + sizeof(uint32_t) - 1) / sizeof(uint32_t) * sizeof(uint32_t);
+}
+
+// The pickled size of any value of `T`, if it is known without looking into the value;
+// 0 otherwise.
+
+template<typename T, typename = void>
+struct FixedPickledSize : std::integral_constant<size_t, 0> {};
 
 template<typename T>
-Pickle& operator<<(Pickle& pickle, const std::vector<T>& value)
+struct FixedPickledSize<T, std::enable_if_t<std::is_fundamental<T>::value>>
+    : std::integral_constant<size_t, AlignedPickledSize(sizeof(T))> {};
+
+template<typename T1, typename T2>
+struct FixedPickledSize<std::pair<T1, T2>>
+    : std::integral_constant<size_t,
+                             FixedPickledSize<std::remove_const_t<T1>>::value == 0 ||
+                             FixedPickledSize<T2>::value == 0 ?
+                                 0 :
+                                 FixedPickledSize<std::remove_const_t<T1>>::value +
+                                 FixedPickledSize<T2>::value> {};
+
+// Containers of elements in fixed size reserve room for all elements at once; others reserve
+// nothing, since estimating their sizes takes a pass over elements, and let the pickle grow.
+template<typename Container>
+void ReserveForElements(Pickle& pickle, const Container& container)
+{
+    constexpr size_t element_size = FixedPickledSize<typename Container::value_type>::value;
+    if (element_size != 0) {
+        pickle.Reserve(AlignedPickledSize(pickle.payload_size()) +
+                       FixedPickledSize<size_t>::value + container.size() * element_size);
+    }
+}
+
+template<typename Container>
+size_t EstimateContainerPickledSize(const Container& container);
+
+}   // namespace internal
+
+// Returns the size of payload that pickling `value` takes, which visits elements of containers
+// whose elements are not in fixed size; with that, a pickle can reserve room for a large value
+// up front, e.g. `pickle.Reserve(pickle.payload_size() + EstimatePickledSize(value))`.
+
+template<typename T>
+constexpr std::enable_if_t<std::is_fundamental<T>::value, size_t>
+EstimatePickledSize(const T&) noexcept
+{
+    return internal::FixedPickledSize<T>::value;
+}
+
+inline size_t EstimatePickledSize(const std::string& value) noexcept
+{
+    return internal::FixedPickledSize<size_t>::value +
+           internal::AlignedPickledSize(value.length() * sizeof(char));
+}
+
+inline size_t EstimatePickledSize(const std::wstring& value) noexcept
+{
+    return internal::FixedPickledSize<size_t>::value +
+           internal::AlignedPickledSize(value.length() * sizeof(wchar_t));
+}
+
+template<typename T1, typename T2>
+size_t EstimatePickledSize(const std::pair<T1, T2>& value);
+
+template<typename T>
+size_t EstimatePickledSize(const std::vector<T>& value);
+
+template<typename T>
+size_t EstimatePickledSize(const std::list<T>& value);
+
+template<typename Key, typename Compare>
+size_t EstimatePickledSize(const std::set<Key, Compare>& value);
+
+template<typename Key, typename T, typename Compare>
+size_t EstimatePickledSize(const std::map<Key, T, Compare>& value);
+
+template<typename Key, typename Hash, typename KeyEqual>
+size_t EstimatePickledSize(const std::unordered_set<Key, Hash, KeyEqual>& value);
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+size_t EstimatePickledSize(const std::unordered_map<Key, T, Hash, KeyEqual>& value);
+
+template<typename T1, typename T2>
+size_t EstimatePickledSize(const std::pair<T1, T2>& value)
+{
+    return EstimatePickledSize(value.first) + EstimatePickledSize(value.second);
+}
+
+template<typename T>
+size_t EstimatePickledSize(const std::vector<T>& value)
+{
+    return internal::EstimateContainerPickledSize(value);
+}
+
+template<typename T>
+size_t EstimatePickledSize(const std::list<T>& value)
+{
+    return internal::EstimateContainerPickledSize(value);
+}
+
+template<typename Key, typename Compare>
+size_t EstimatePickledSize(const std::set<Key, Compare>& value)
 {
+    return internal::EstimateContainerPickledSize(value);
+}
+
+template<typename Key, typename T, typename Compare>
+size_t EstimatePickledSize(const std::map<Key, T, Compare>& value)
+{
+    return internal::EstimateContainerPickledSize(value);
+}
+
+template<typename Key, typename Hash, typename KeyEqual>
+size_t EstimatePickledSize(const std::unordered_set<Key, Hash, KeyEqual>& value)
+{
+    return internal::EstimateContainerPickledSize(value);
+}
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+size_t EstimatePickledSize(const std::unordered_map<Key, T, Hash, KeyEqual>& value)
+{
+    return internal::EstimateContainerPickledSize(value);
+}
+
+namespace internal {
+
+template<typename Container>
+size_t EstimateContainerPickledSize(const Container& container)
+{
+    size_t size = FixedPickledSize<size_t>::value;
+    constexpr size_t element_size = FixedPickledSize<typename Container::value_type>::value;
+    if (element_size != 0) {
+        return size + container.size() * element_size;
+    }
+
+    for (const auto& ele : container) {
+        size += EstimatePickledSize(ele);
+    }
+
+    return size;
+}
+
+// Vectors of these types are pickled by copying their elements in a single block, which has
+// the same layout as pickling elements one by one, since every element fills up whole 4-byte
+// aligned segments and no padding is interpolated.
+// Only types pickled by `Pickle` itself are listed, so that no other type becomes pickle-able
+// merely in vectors.
+template<typename T>
+struct IsBulkPickleable
+    : std::integral_constant<bool, std::is_same<T, int>::value ||
+                                   std::is_same<T, unsigned int>::value ||
+                                   std::is_same<T, int64_t>::value ||
+                                   std::is_same<T, uint64_t>::value ||
+                                   std::is_same<T, float>::value ||
+                                   std::is_same<T, double>::value> {};
+
+template<typename T>
+void WriteVector(Pickle& pickle, const std::vector<T>& value, std::true_type)
+{
+    pickle << value.size();
+    if (!value.empty()) {
+        pickle.Write(value.data(), value.size() * sizeof(T));
+    }
+}
+
+template<typename T>
+void WriteVector(Pickle& pickle, const std::vector<T>& value, std::false_type)
+{
+    ReserveForElements(pickle, value);
     pickle << value.size();
     for (const auto& ele : value) {
         pickle << ele;
     }
+}
+
+// Reads the number of elements of a container.
+// Each element takes at least one byte, which bounds the number read from corrupted data.
+inline size_t ReadElementCount(PickleReader& reader)
+{
+    size_t size;
+    reader >> size;
+    ENSURE(THROW, size <= reader.remaining_size())(size).Require(
+        "Pickled container runs past the end of data");
+    return size;
+}
+
+template<typename T>
+void ReadVector(PickleReader& reader, std::vector<T>& value, std::true_type)
+{
+    size_t size;
+    reader >> size;
+    if (size != 0) {
+        // The size may come from corrupted data.
+        ENSURE(THROW, size <= reader.remaining_size() / sizeof(T))(size).Require(
+            "Pickled vector runs past the end of data");
+        auto offset = value.size();
+        value.resize(offset + size);
+        reader.ReadRawData(value.data() + offset, size * sizeof(T));
+    }
+}
 
+template<typename T>
+void ReadVector(PickleReader& reader, std::vector<T>& value, std::false_type)
+{
+    auto size = ReadElementCount(reader);
+    for (size_t i = 0; i < size; ++i) {
+        T ele;
+        reader >> ele;
+        value.push_back(std::move(ele));
+    }
+}
+
+}   // namespace internal
+
+// Support for usual containers
+
+template<typename T>
+Pickle& operator<<(Pickle& pickle, const std::vector<T>& value)
+{
+    internal::WriteVector(pickle, value, internal::IsBulkPickleable<T>());
     return pickle;
 }
 
 template<typename T>
 Pickle& operator<<(Pickle& pickle, const std::list<T>& value)
 {
+    internal::ReserveForElements(pickle, value);
     pickle << value.size();
     for (const auto& ele : value) {
         pickle << ele;
@@ -335,6 +582,7 @@ Pickle& operator<<(Pickle& pickle, const std::pair<T1, T2>& value)
 template<typename Key, typename Compare = std::less<Key>>
 Pickle& operator<<(Pickle& pickle, const std::set<Key, Compare>& value)
 {
+    internal::ReserveForElements(pickle, value);
     pickle << value.size();
     for (const auto& ele : value) {
         pickle << ele;
@@ -346,6 +594,7 @@ Pickle& operator<<(Pickle& pickle, const std::set<Key, Compare>& value)
 template<typename Key, typename T, typename Compare = std::less<Key>>
 Pickle& operator<<(Pickle& pickle, const std::map<Key, T, Compare>& value)
 {
+    internal::ReserveForElements(pickle, value);
     pickle << value.size();
     for (const auto& pair : value) {
         pickle << pair;
@@ -357,6 +606,7 @@ Pickle& operator<<(Pickle& pickle, const std::map<Key, T, Compare>& value)
 template<typename Key, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
 Pickle& operator<<(Pickle& pickle ,const std::unordered_set<Key, Hash, KeyEqual>& value)
 {
+    internal::ReserveForElements(pickle, value);
     pickle << value.size();
     for (const auto& ele : value) {
         pickle << ele;
@@ -372,6 +622,7 @@ template<
     typename KeyEqual = std::equal_to<Key>>
 Pickle& operator<<(Pickle& pickle, const std::unordered_map<Key, T, Hash, KeyEqual>& value)
 {
+    internal::ReserveForElements(pickle, value);
     pickle << value.size();
     for (const auto& pair : value) {
         pickle << pair;
@@ -383,22 +634,14 @@ Pickle& operator<<(Pickle& pickle, const std::unordered_map<Key, T, Hash, KeyEqu
 template<typename T>
 PickleReader& operator>>(PickleReader& reader, std::vector<T>& value)
 {
-    size_t size;
-    reader >> size;
-    for (size_t i = 0; i < size; ++i) {
-        T ele;
-        reader >> ele;
-        value.push_back(std::move(ele));
-    }
-
+    internal::ReadVector(reader, value, internal::IsBulkPickleable<T>());
     return reader;
 }
 
 template<typename T>
 PickleReader& operator>>(PickleReader& reader, std::list<T>& value)
 {
-    size_t size;
-    reader >> size;
+    auto size = internal::ReadElementCount(reader);
     for (size_t i = 0; i < size; ++i) {
         T ele;
         reader >> ele;
@@ -418,8 +661,7 @@ PickleReader& operator>>(PickleReader& reader, std::pair<T1, T2>& value)
 template<typename Key, typename Compare = std::less<Key>>
 PickleReader& operator>>(PickleReader& reader, std::set<Key, Compare>& value)
 {
-    size_t size;
-    reader >> size;
+    auto size = internal::ReadElementCount(reader);
     for (size_t i = 0; i < size; ++i) {
         Key ele;
         reader >> ele;
@@ -432,8 +674,7 @@ PickleReader& operator>>(PickleReader& reader, std::set<Key, Compare>& value)
 template<typename Key, typename T, typename Compare = std::less<Key>>
 PickleReader& operator>>(PickleReader& reader, std::map<Key, T, Compare>& value)
 {
-    size_t size;
-    reader >> size;
+    auto size = internal::ReadElementCount(reader);
     for (size_t i = 0; i < size; ++i) {
         std::pair<Key, T> ele;
         reader >> ele;
@@ -446,8 +687,7 @@ PickleReader& operator>>(PickleReader& reader, std::map<Key, T, Compare>& value)
 template<typename Key, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
 PickleReader& operator>>(PickleReader& reader, std::unordered_set<Key, Hash, KeyEqual>& value)
 {
-    size_t size;
-    reader >> size;
+    auto size = internal::ReadElementCount(reader);
     for (size_t i = 0; i < size; ++i) {
         Key ele;
         reader >> ele;
@@ -464,8 +704,7 @@ template<
     typename KeyEqual = std::equal_to<Key>>
 PickleReader& operator>>(PickleReader& reader, std::unordered_map<Key, T, Hash, KeyEqual>& value)
 {
-    size_t size;
-    reader >> size;
+    auto size = internal::ReadElementCount(reader);
     for (size_t i = 0; i < size; ++i) {
         std::pair<Key, T> ele;
         reader >> ele;
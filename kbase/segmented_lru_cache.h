@@ -0,0 +1,390 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef KBASE_SEGMENTED_LRU_CACHE_H_
+#define KBASE_SEGMENTED_LRU_CACHE_H_
+
+#include <array>
+#include <iterator>
+#include <list>
+#include <utility>
+
+#include "kbase/basic_macros.h"
+#include "kbase/error_exception_util.h"
+#include "kbase/lru_cache.h"
+
+namespace kbase {
+
+namespace internal {
+
+// A list partitioned into `N` consecutive segments, each of which is ordered from its least
+// recently used element to its most recently used one; elements move between segments in O(1)
+// time, and iterators stay valid.
+template<typename T, size_t N>
+class SegmentedList {
+    using List = std::list<T>;
+
+public:
+    using iterator = typename List::iterator;
+    using const_iterator = typename List::const_iterator;
+
+    SegmentedList()
+    {
+        firsts_.fill(list_.end());
+        sizes_.fill(0);
+    }
+
+    SegmentedList(SegmentedList&& other)
+        : list_(std::move(other.list_)), firsts_(other.firsts_), sizes_(other.sizes_)
+    {
+        // Iterators past the end pointed to the sentinel of the other list.
+        for (auto& first : firsts_) {
+            if (first == other.list_.end()) {
+                first = list_.end();
+            }
+        }
+
+        other.clear();
+    }
+
+    SegmentedList& operator=(SegmentedList&& rhs)
+    {
+        if (this != &rhs) {
+            clear();
+            list_.splice(list_.end(), rhs.list_);
+            for (size_t i = 0; i < N; ++i) {
+                firsts_[i] = rhs.firsts_[i] == rhs.list_.end() ? list_.end() : rhs.firsts_[i];
+            }
+
+            sizes_ = rhs.sizes_;
+            rhs.clear();
+        }
+
+        return *this;
+    }
+
+    SegmentedList(const SegmentedList&) = delete;
+
+    SegmentedList& operator=(const SegmentedList&) = delete;
+
+    template<typename... Args>
+    iterator EmplaceBack(size_t segment, Args&&... args)
+    {
+        auto pos = SegmentEnd(segment);
+        auto it = list_.emplace(pos, std::forward<Args>(args)...);
+        Attach(it, segment, pos);
+        return it;
+    }
+
+    // Moves the element to the back of segment `to`.
+    void MoveToBack(iterator it, size_t from, size_t to) noexcept
+    {
+        Detach(it, from);
+        auto pos = SegmentEnd(to);
+        list_.splice(pos, list_, it);
+        Attach(it, to, pos);
+    }
+
+    iterator Erase(const_iterator pos, size_t segment)
+    {
+        Detach(pos, segment);
+        return list_.erase(pos);
+    }
+
+    void clear() noexcept
+    {
+        list_.clear();
+        firsts_.fill(list_.end());
+        sizes_.fill(0);
+    }
+
+    iterator SegmentBegin(size_t segment) const noexcept
+    {
+        return firsts_[segment];
+    }
+
+    iterator SegmentEnd(size_t segment) noexcept
+    {
+        return segment + 1 < N ? firsts_[segment + 1] : list_.end();
+    }
+
+    size_t SegmentSize(size_t segment) const noexcept
+    {
+        return sizes_[segment];
+    }
+
+    size_t size() const noexcept
+    {
+        return list_.size();
+    }
+
+    bool empty() const noexcept
+    {
+        return list_.empty();
+    }
+
+    iterator begin() noexcept { return list_.begin(); }
+
+    const_iterator begin() const noexcept { return list_.begin(); }
+
+    iterator end() noexcept { return list_.end(); }
+
+    const_iterator end() const noexcept { return list_.end(); }
+
+private:
+    // An empty segment begins where the next non-empty segment begins; those preceding
+    // `segment` may therefore begin at the element too.
+    void Detach(const_iterator it, size_t segment) noexcept
+    {
+        auto next = std::next(it);
+        for (size_t i = 0; i <= segment; ++i) {
+            if (firsts_[i] == it) {
+                firsts_[i] = list_.erase(next, next);
+            }
+        }
+
+        --sizes_[segment];
+    }
+
+    // `pos` is where the segment ended before `it` was inserted.
+    void Attach(iterator it, size_t segment, iterator pos) noexcept
+    {
+        for (size_t i = 0; i <= segment; ++i) {
+            if (firsts_[i] == pos) {
+                firsts_[i] = it;
+            }
+        }
+
+        ++sizes_[segment];
+    }
+
+private:
+    List list_;
+    std::array<iterator, N> firsts_;
+    std::array<size_t, N> sizes_;
+};
+
+}   // namespace internal
+
+// A segmented LRU cache, which has the same interface of `LRUCache`, and resists one-off scans
+// as 2Q does.
+// New entries are put into the probationary segment, and are moved into the protected segment
+// if they are accessed again; entries overflowing the protected segment, which takes up to 80%
+// of `max_size`, are moved back to the probationary segment, from which entries are evicted.
+// Hence entries accessed only once never flush entries accessed repeatedly.
+// Iteration starts from the least recently used probationary entry, i.e. the next to evict,
+// and ends with the most recently used protected one.
+template<typename Key, typename Entry, template<typename, typename> class Map = TreeMap>
+class SegmentedLRUCache {
+public:
+    using key_type = Key;
+    using value_type = std::pair<const Key, Entry>;
+
+private:
+    enum Segment : size_t {
+        Probation = 0,
+        Protected,
+        SegmentCount
+    };
+
+    using CachedEntryList = internal::SegmentedList<value_type, SegmentCount>;
+
+    struct Slot {
+        typename CachedEntryList::iterator position;
+        Segment segment;
+    };
+
+    using KeyTable = typename Map<Key, Slot>::MapType;
+
+public:
+    using size_type = size_t;
+    using iterator = typename CachedEntryList::iterator;
+    using const_iterator = typename CachedEntryList::const_iterator;
+
+    enum : size_type {
+        NoAutoEvict = 0
+    };
+
+    explicit SegmentedLRUCache(size_type max_size)
+        : max_size_(max_size),
+          protected_capacity_(max_size == NoAutoEvict ? static_cast<size_type>(-1)
+                                                      : max_size * 4 / 5)
+    {}
+
+    SegmentedLRUCache(SegmentedLRUCache&& other) = default;
+
+    SegmentedLRUCache& operator=(SegmentedLRUCache&& rhs) = default;
+
+    ~SegmentedLRUCache() = default;
+
+    SegmentedLRUCache(const SegmentedLRUCache&) = delete;
+
+    SegmentedLRUCache& operator=(const SegmentedLRUCache&) = delete;
+
+    // Add a pair of <key, entry> into the cache. If the key already exists, update
+    // the entry, which counts as an access.
+    // If auto-eviction is enabled for the cache, and also cache runs out its free
+    // storage, the least recently used probationary entry is evicted.
+
+    iterator Put(const Key& key, const Entry& entry)
+    {
+        return PutInternal(key, entry);
+    }
+
+    iterator Put(const Key& key, Entry&& entry)
+    {
+        return PutInternal(key, std::move(entry));
+    }
+
+    // Returns the iterator to the value associated with `key`, and marks the entry as recently
+    // used. Returns end() if no matched value was found.
+    iterator Get(const Key& key)
+    {
+        auto key_it = key_table_.find(key);
+        if (key_it == key_table_.end()) {
+            return end();
+        }
+
+        Touch(key_it->second);
+
+        return key_it->second.position;
+    }
+
+    // Returns the iterator to the value associated with the `key`.
+    // Returns end() if no such value was found.
+    // These two functions does not touch the entry, i.e. will not mark the entry recently used.
+
+    const_iterator find(const Key& key) const
+    {
+        auto key_it = key_table_.find(key);
+        if (key_it == key_table_.end()) {
+            return end();
+        }
+
+        return key_it->second.position;
+    }
+
+    iterator find(const Key& key)
+    {
+        auto key_it = key_table_.find(key);
+        if (key_it == key_table_.end()) {
+            return end();
+        }
+
+        return key_it->second.position;
+    }
+
+    // Erases the value with specific iterator, and returns the iterator to
+    // the next value.
+    iterator erase(const_iterator pos)
+    {
+        auto key_it = key_table_.find(pos->first);
+        auto segment = key_it->second.segment;
+        key_table_.erase(key_it);
+        return entries_.Erase(pos, segment);
+    }
+
+    // Evict a single entry, or |count_to_evict| entries from cache.
+
+    void Evict()
+    {
+        erase(begin());
+    }
+
+    void Evict(size_type count_to_evict)
+    {
+        ENSURE(CHECK, count_to_evict <= size())(count_to_evict)(size()).Require();
+        for (size_type i = 0; i < count_to_evict; ++i) {
+            Evict();
+        }
+    }
+
+    size_type size() const
+    {
+        return entries_.size();
+    }
+
+    bool empty() const
+    {
+        return entries_.empty();
+    }
+
+    size_type max_size() const
+    {
+        return max_size_;
+    }
+
+    bool auto_evict() const
+    {
+        return max_size_ != 0;
+    }
+
+    size_type protected_size() const
+    {
+        return entries_.SegmentSize(Protected);
+    }
+
+    iterator begin() { return entries_.begin(); }
+
+    const_iterator begin() const { return entries_.begin(); }
+
+    const_iterator cbegin() const { return entries_.begin(); }
+
+    iterator end() { return entries_.end(); }
+
+    const_iterator end() const { return entries_.end(); }
+
+    const_iterator cend() const { return entries_.end(); }
+
+private:
+    void Touch(Slot& slot)
+    {
+        if (slot.segment == Protected) {
+            entries_.MoveToBack(slot.position, Protected, Protected);
+            return;
+        }
+
+        entries_.MoveToBack(slot.position, Probation, Protected);
+        slot.segment = Protected;
+        if (entries_.SegmentSize(Protected) > protected_capacity_) {
+            auto demoted = entries_.SegmentBegin(Protected);
+            entries_.MoveToBack(demoted, Protected, Probation);
+            key_table_.find(demoted->first)->second.segment = Probation;
+        }
+    }
+
+    template<typename KeyType, typename EntryType>
+    iterator PutInternal(const KeyType& key, EntryType&& entry)
+    {
+        auto key_it = key_table_.find(key);
+        if (key_it != key_table_.end()) {
+            key_it->second.position->second = std::forward<EntryType>(entry);
+            Touch(key_it->second);
+            return key_it->second.position;
+        }
+
+        if (auto_evict() && max_size() == size()) {
+            Evict();
+        }
+
+        auto entry_it = entries_.EmplaceBack(Probation, key, std::forward<EntryType>(entry));
+        key_table_.insert({key, Slot{entry_it, Probation}});
+
+        return entry_it;
+    }
+
+private:
+    size_type max_size_;
+    size_type protected_capacity_;
+    CachedEntryList entries_;
+    KeyTable key_table_;
+};
+
+}   // namespace kbase
+
+#endif  // KBASE_SEGMENTED_LRU_CACHE_H_
@@ -42,6 +42,12 @@ public:
 
     void DumpCallStack(std::ostream& stream);
 
+#if defined(OS_POSIX)
+    // Writes symbols of frames to the file descriptor without allocating memory; it is
+    // async-signal-safe once any `StackWalker` has been constructed before.
+    void DumpCallStack(int fd) noexcept;
+#endif
+
     std::string CallStackToString();
 
 private:
@@ -6,9 +6,11 @@
 
 #include <cxxabi.h>
 #include <execinfo.h>
+#include <unistd.h>
 
 #include <sstream>
 
+#include "kbase/basic_macros.h"
 #include "kbase/scope_guard.h"
 
 namespace {
@@ -82,6 +84,17 @@ void StackWalker::DumpCallStack(std::ostream& stream)
     ResolveCallstackSymbols(stack_frames_.data(), static_cast<int>(valid_frame_count_), stream);
 }
 
+void StackWalker::DumpCallStack(int fd) noexcept
+{
+    if (valid_frame_count_ == 0) {
+        constexpr char kEmptyStack[] = "Empty stack frame, possibily corrupted.\n";
+        IGNORE_RESULT(write(fd, kEmptyStack, sizeof(kEmptyStack) - 1));
+        return;
+    }
+
+    backtrace_symbols_fd(stack_frames_.data(), static_cast<int>(valid_frame_count_), fd);
+}
+
 std::string StackWalker::CallStackToString()
 {
     std::ostringstream callstack_stream;
@@ -10,6 +10,7 @@
 #define KBASE_STRING_VIEW_H_
 
 #include <algorithm>
+#include <limits>
 #include <stdexcept>
 
 #include "kbase/basic_macros.h"
@@ -0,0 +1,299 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef KBASE_TINY_LFU_CACHE_H_
+#define KBASE_TINY_LFU_CACHE_H_
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <utility>
+
+#include "kbase/basic_macros.h"
+#include "kbase/count_min_sketch.h"
+#include "kbase/error_exception_util.h"
+#include "kbase/segmented_lru_cache.h"
+
+namespace kbase {
+
+// A cache with W-TinyLFU admission, which has the same interface of `LRUCache`.
+// New entries go into a small LRU window, taking 1% of `max_size`; an entry overflowing the
+// window is admitted into the main space, which is a segmented LRU as `SegmentedLRUCache`, only
+// if it was accessed more often than the entry the main space would evict in its place.
+// Access frequencies, including those of keys missed and evicted, are estimated by a
+// `CountMinSketch` with aging, so a scan touching many keys once never flushes popular entries,
+// while the window still keeps recent entries for bursts.
+// Without auto eviction, the cache works as a plain LRU cache.
+// Iteration starts from the least recently used probationary entry, i.e. the next to evict,
+// through protected entries, and ends with the most recently used window entry.
+template<typename Key, typename Entry, template<typename, typename> class Map = TreeMap,
+         typename Hash = std::hash<Key>>
+class TinyLFUCache {
+public:
+    using key_type = Key;
+    using value_type = std::pair<const Key, Entry>;
+
+private:
+    enum Segment : size_t {
+        Probation = 0,
+        Protected,
+        Window,
+        SegmentCount
+    };
+
+    using CachedEntryList = internal::SegmentedList<value_type, SegmentCount>;
+
+    struct Slot {
+        typename CachedEntryList::iterator position;
+        Segment segment;
+    };
+
+    using KeyTable = typename Map<Key, Slot>::MapType;
+
+public:
+    using size_type = size_t;
+    using iterator = typename CachedEntryList::iterator;
+    using const_iterator = typename CachedEntryList::const_iterator;
+
+    enum : size_type {
+        NoAutoEvict = 0
+    };
+
+    explicit TinyLFUCache(size_type max_size, const Hash& hash = Hash())
+        : max_size_(max_size),
+          window_capacity_(max_size == NoAutoEvict ? static_cast<size_type>(-1)
+                                                   : std::max<size_type>(1, max_size / 100)),
+          main_capacity_(max_size - std::min(max_size, window_capacity_)),
+          protected_capacity_(main_capacity_ * 4 / 5),
+          hash_(hash),
+          sketch_(max_size)
+    {}
+
+    TinyLFUCache(TinyLFUCache&& other) = default;
+
+    TinyLFUCache& operator=(TinyLFUCache&& rhs) = default;
+
+    ~TinyLFUCache() = default;
+
+    TinyLFUCache(const TinyLFUCache&) = delete;
+
+    TinyLFUCache& operator=(const TinyLFUCache&) = delete;
+
+    // Add a pair of <key, entry> into the cache. If the key already exists, update
+    // the entry, which counts as an access.
+    // A new entry is always cached in the window, and if auto-eviction is enabled for the
+    // cache, either the entry leaving the window or the victim of the main space is evicted.
+
+    iterator Put(const Key& key, const Entry& entry)
+    {
+        return PutInternal(key, entry);
+    }
+
+    iterator Put(const Key& key, Entry&& entry)
+    {
+        return PutInternal(key, std::move(entry));
+    }
+
+    // Returns the iterator to the value associated with `key`, and marks the entry as recently
+    // used. Returns end() if no matched value was found.
+    // Misses count towards the frequency of the key as well.
+    iterator Get(const Key& key)
+    {
+        RecordAccess(key);
+        auto key_it = key_table_.find(key);
+        if (key_it == key_table_.end()) {
+            return end();
+        }
+
+        Touch(key_it->second);
+
+        return key_it->second.position;
+    }
+
+    // Returns the iterator to the value associated with the `key`.
+    // Returns end() if no such value was found.
+    // These two functions does not touch the entry, i.e. will not mark the entry recently used.
+
+    const_iterator find(const Key& key) const
+    {
+        auto key_it = key_table_.find(key);
+        if (key_it == key_table_.end()) {
+            return end();
+        }
+
+        return key_it->second.position;
+    }
+
+    iterator find(const Key& key)
+    {
+        auto key_it = key_table_.find(key);
+        if (key_it == key_table_.end()) {
+            return end();
+        }
+
+        return key_it->second.position;
+    }
+
+    // Erases the value with specific iterator, and returns the iterator to
+    // the next value.
+    iterator erase(const_iterator pos)
+    {
+        auto key_it = key_table_.find(pos->first);
+        auto segment = key_it->second.segment;
+        key_table_.erase(key_it);
+        return entries_.Erase(pos, segment);
+    }
+
+    // Evict a single entry, or |count_to_evict| entries from cache.
+
+    void Evict()
+    {
+        erase(begin());
+    }
+
+    void Evict(size_type count_to_evict)
+    {
+        ENSURE(CHECK, count_to_evict <= size())(count_to_evict)(size()).Require();
+        for (size_type i = 0; i < count_to_evict; ++i) {
+            Evict();
+        }
+    }
+
+    size_type size() const
+    {
+        return entries_.size();
+    }
+
+    bool empty() const
+    {
+        return entries_.empty();
+    }
+
+    size_type max_size() const
+    {
+        return max_size_;
+    }
+
+    bool auto_evict() const
+    {
+        return max_size_ != 0;
+    }
+
+    // Returns the estimated number of recent accesses to the key, which saturates at
+    // `CountMinSketch::kMaxFrequency`.
+    unsigned frequency(const Key& key) const
+    {
+        return sketch_.Frequency(hash_(key));
+    }
+
+    iterator begin() { return entries_.begin(); }
+
+    const_iterator begin() const { return entries_.begin(); }
+
+    const_iterator cbegin() const { return entries_.begin(); }
+
+    iterator end() { return entries_.end(); }
+
+    const_iterator end() const { return entries_.end(); }
+
+    const_iterator cend() const { return entries_.end(); }
+
+private:
+    void RecordAccess(const Key& key)
+    {
+        if (auto_evict()) {
+            sketch_.Increment(hash_(key));
+        }
+    }
+
+    void MoveEntry(Slot& slot, Segment to)
+    {
+        entries_.MoveToBack(slot.position, slot.segment, to);
+        slot.segment = to;
+    }
+
+    Slot& SlotOf(iterator pos)
+    {
+        return key_table_.find(pos->first)->second;
+    }
+
+    void Touch(Slot& slot)
+    {
+        if (slot.segment != Probation) {
+            MoveEntry(slot, slot.segment);
+            return;
+        }
+
+        MoveEntry(slot, Protected);
+        if (entries_.SegmentSize(Protected) > protected_capacity_) {
+            MoveEntry(SlotOf(entries_.SegmentBegin(Protected)), Probation);
+        }
+    }
+
+    // The least recently used window entry becomes a candidate for the main space, which
+    // competes with the entry the main space would evict, and the less frequent one is evicted.
+    void Admit()
+    {
+        auto candidate = entries_.SegmentBegin(Window);
+        MoveEntry(SlotOf(candidate), Probation);
+        if (entries_.SegmentSize(Probation) + entries_.SegmentSize(Protected) <= main_capacity_) {
+            return;
+        }
+
+        auto victim = entries_.begin();
+        if (victim == candidate) {
+            if (entries_.SegmentSize(Protected) == 0) {
+                erase(candidate);
+                return;
+            }
+
+            // The candidate is the only probationary entry.
+            victim = std::next(candidate);
+        }
+
+        if (sketch_.Frequency(hash_(candidate->first)) > sketch_.Frequency(hash_(victim->first))) {
+            erase(victim);
+        } else {
+            erase(candidate);
+        }
+    }
+
+    template<typename KeyType, typename EntryType>
+    iterator PutInternal(const KeyType& key, EntryType&& entry)
+    {
+        RecordAccess(key);
+        auto key_it = key_table_.find(key);
+        if (key_it != key_table_.end()) {
+            key_it->second.position->second = std::forward<EntryType>(entry);
+            Touch(key_it->second);
+            return key_it->second.position;
+        }
+
+        auto entry_it = entries_.EmplaceBack(Window, key, std::forward<EntryType>(entry));
+        key_table_.insert({key, Slot{entry_it, Window}});
+        if (entries_.SegmentSize(Window) > window_capacity_) {
+            Admit();
+        }
+
+        return entry_it;
+    }
+
+private:
+    size_type max_size_;
+    size_type window_capacity_;
+    size_type main_capacity_;
+    size_type protected_capacity_;
+    Hash hash_;
+    CountMinSketch sketch_;
+    CachedEntryList entries_;
+    KeyTable key_table_;
+};
+
+}   // namespace kbase
+
+#endif  // KBASE_TINY_LFU_CACHE_H_
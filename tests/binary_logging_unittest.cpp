@@ -0,0 +1,188 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <fstream>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include "catch2/catch.hpp"
+
+#include "kbase/binary_logging.h"
+#include "kbase/file_util.h"
+#include "kbase/logging.h"
+#include "kbase/path.h"
+
+namespace {
+
+std::string ReadBinaryFile(const kbase::PathString& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+constexpr int kLogRequestLine = __LINE__ + 4;
+
+void LogRequest(int request_id, double elapsed_ms)
+{
+    BLOG(INFO, "request {0} served in {1} ms", request_id, elapsed_ms);
+}
+
+using kbase::Pickle;
+using kbase::internal::BinaryLogRecordKind;
+
+std::string MakeBinaryLog(std::initializer_list<Pickle> records)
+{
+    std::string data {'K', 'B', 'L', 'O', 'G', '\0', '\0', '\1'};
+    for (const auto& record : records) {
+        data.append(static_cast<const char*>(record.data()), record.size());
+    }
+
+    return data;
+}
+
+Pickle MakeSiteRecord(uint32_t id, int severity, const char* format, const char* arg_types)
+{
+    Pickle record;
+    record << static_cast<uint32_t>(BinaryLogRecordKind::SiteDefinition) << id << severity << 10;
+    kbase::internal::WriteBinaryLogString(record, "site.cpp");
+    kbase::internal::WriteBinaryLogString(record, format);
+    kbase::internal::WriteBinaryLogString(record, arg_types);
+    return record;
+}
+
+Pickle MakeMessageRecord(uint32_t id)
+{
+    Pickle record;
+    record << static_cast<uint32_t>(BinaryLogRecordKind::Message) << id << INT64_C(0)
+           << UINT64_C(1);
+    return record;
+}
+
+}   // namespace
+
+namespace kbase {
+
+TEST_CASE("Log messages in binary records", "[BinaryLogging]")
+{
+    PathString log_name(PATH_LITERAL("binary_logging_test.blog"));
+    RemoveFile(Path(log_name), false);
+
+    LoggingSettings settings;
+    settings.binary_log_file_path = log_name;
+    ConfigureLoggingSettings(settings);
+
+    LogRequest(1, 0.5);
+    int warning_line = __LINE__ + 1;
+    BLOG(WARNING, "{0} {1} {2} {3} {{literal}}", true, 'x', 42U, std::string("str"));
+    BLOG_IF(ERROR, false, "never logged {0}", 0);
+
+    // Site definitions are emitted again in a new session.
+    ConfigureLoggingSettings(settings);
+    LogRequest(2, 1.25);
+
+    ConfigureLoggingSettings(LoggingSettings());
+
+    auto data = ReadBinaryFile(log_name);
+    std::ostringstream out;
+    REQUIRE(DecodeBinaryLog(data.data(), data.size(), LogItemOptions::EnableNone, out));
+
+    std::ostringstream expected;
+    expected << "[ INFO binary_logging_unittest.cpp(" << kLogRequestLine << ")]"
+             << "request 1 served in 0.5 ms\n"
+             << "[ WARNING binary_logging_unittest.cpp(" << warning_line << ")]"
+             << "true x 42 str {literal}\n"
+             << "[ INFO binary_logging_unittest.cpp(" << kLogRequestLine << ")]"
+             << "request 2 served in 1.25 ms\n";
+    REQUIRE(out.str() == expected.str());
+
+    SECTION("truncated data renders complete records only")
+    {
+        std::ostringstream partial;
+        REQUIRE_FALSE(DecodeBinaryLog(data.data(), data.size() - 1, LogItemOptions::EnableNone,
+                                      partial));
+        REQUIRE(partial.str().find("request 1 served in 0.5 ms") != std::string::npos);
+        REQUIRE(partial.str().find("request 2") == std::string::npos);
+    }
+
+    RemoveFile(Path(log_name), false);
+}
+
+TEST_CASE("Reject truncated or corrupted binary records", "[BinaryLogging]")
+{
+    auto site = MakeSiteRecord(1, 0, "value {0}", "s");
+    auto message = MakeMessageRecord(1);
+    internal::WriteBinaryLogString(message, "ok");
+    const std::string kRendered = "[ INFO site.cpp(10)]value ok\n";
+
+    auto valid = MakeBinaryLog({site, message});
+    std::ostringstream out;
+    REQUIRE(DecodeBinaryLog(valid.data(), valid.size(), LogItemOptions::EnableNone, out));
+    REQUIRE(out.str() == kRendered);
+
+    // Each of them is a complete record whose payload ends before all of its fields.
+    Pickle session;
+    session << static_cast<uint32_t>(BinaryLogRecordKind::Session);
+
+    Pickle partial_site;
+    partial_site << static_cast<uint32_t>(BinaryLogRecordKind::SiteDefinition) << 2U << 0;
+
+    Pickle partial_message;
+    partial_message << static_cast<uint32_t>(BinaryLogRecordKind::Message) << 1U;
+
+    auto missing_arg = MakeMessageRecord(1);
+
+    // And these are corrupted.
+    Pickle huge_format;
+    huge_format << static_cast<uint32_t>(BinaryLogRecordKind::SiteDefinition) << 2U << 0 << 10;
+    internal::WriteBinaryLogString(huge_format, "site.cpp");
+    huge_format << std::numeric_limits<size_t>::max() << 0;
+
+    auto huge_arg = MakeMessageRecord(1);
+    huge_arg << (size_t(1) << 40) << 0;
+
+    auto bad_severity = MakeSiteRecord(2, 7, "{0}", "i");
+    auto negative_severity = MakeSiteRecord(2, -1, "{0}", "i");
+    auto unknown_type = MakeSiteRecord(2, 0, "{0}", "x");
+    auto unknown_type_message = MakeMessageRecord(2);
+    unknown_type_message << INT64_C(1);
+
+    for (const auto& record : {session, partial_site, partial_message, missing_arg, huge_format,
+                               huge_arg, bad_severity, negative_severity}) {
+        auto data = MakeBinaryLog({site, message, record, message});
+        std::ostringstream partial;
+        REQUIRE_FALSE(DecodeBinaryLog(data.data(), data.size(), LogItemOptions::EnableNone,
+                                      partial));
+        REQUIRE(partial.str() == kRendered);
+    }
+
+    auto data = MakeBinaryLog({site, message, unknown_type, unknown_type_message});
+    std::ostringstream partial;
+    REQUIRE_FALSE(DecodeBinaryLog(data.data(), data.size(), LogItemOptions::EnableNone, partial));
+    REQUIRE(partial.str() == kRendered);
+}
+
+TEST_CASE("Binary messages fall back to text messages", "[BinaryLogging]")
+{
+    PathString log_name(PATH_LITERAL("binary_logging_fallback_test.log"));
+    LoggingSettings settings;
+    settings.log_file_path = log_name;
+    settings.old_file_disposal_option = OldFileDisposalOption::DeleteOldFile;
+    ConfigureLoggingSettings(settings);
+
+    LogRequest(3, 2.5);
+
+    ConfigureLoggingSettings(LoggingSettings());
+
+    std::ifstream in(log_name);
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    REQUIRE(content.find("request 3 served in 2.5 ms") != std::string::npos);
+
+    in.close();
+    RemoveFile(Path(log_name), false);
+}
+
+}   // namespace kbase
@@ -0,0 +1,209 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+
+#include "kbase/concurrent_lru_cache.h"
+
+namespace kbase {
+
+TEST_CASE("Construct concurrent LRU caches", "[ConcurrentLRUCache]")
+{
+    using Cache = ConcurrentLRUCache<int, std::string>;
+
+    Cache non_limited(Cache::NoAutoEvict, 6);
+    REQUIRE_FALSE(non_limited.auto_evict());
+    REQUIRE(non_limited.max_size() == 0);
+    REQUIRE(non_limited.segment_count() == 8);
+    REQUIRE(non_limited.promotion() == LRUPromotion::Eager);
+
+    Cache ltd(1000, 16, LRUPromotion::Lazy);
+    REQUIRE(ltd.auto_evict());
+    REQUIRE(ltd.segment_count() == 16);
+    REQUIRE(ltd.max_size() == 63 * 16);
+    REQUIRE(ltd.promotion() == LRUPromotion::Lazy);
+
+    // Every segment can hold at least one entry.
+    Cache tiny(3, 64);
+    REQUIRE(tiny.segment_count() == 2);
+    REQUIRE(tiny.max_size() == 4);
+
+    Cache automatic(1 << 20);
+    REQUIRE(automatic.segment_count() >= 4);
+}
+
+TEST_CASE("Put, get and erase in concurrent LRU caches", "[ConcurrentLRUCache]")
+{
+    for (auto promotion : {LRUPromotion::Eager, LRUPromotion::Lazy}) {
+        ConcurrentLRUCache<int, std::string> cache(8, 4, promotion);
+
+        std::string entry = "untouched";
+        REQUIRE_FALSE(cache.Get(1, entry));
+        REQUIRE(entry == "untouched");
+
+        cache.Put(1, "one");
+        cache.Put(2, std::string("two"));
+        REQUIRE(cache.size() == 2);
+        REQUIRE(cache.Contains(1));
+        REQUIRE(cache.Get(2, entry));
+        REQUIRE(entry == "two");
+
+        cache.Put(2, "deux");
+        REQUIRE(cache.size() == 2);
+        REQUIRE(cache.Get(2, entry));
+        REQUIRE(entry == "deux");
+
+        REQUIRE(cache.Erase(1));
+        REQUIRE_FALSE(cache.Erase(1));
+        REQUIRE_FALSE(cache.Contains(1));
+
+        // Segments evict independently, while the whole cache never exceeds its capacity.
+        for (int i = 0; i < 1000; ++i) {
+            cache.Put(i, std::to_string(i));
+            REQUIRE(cache.size() <= cache.max_size());
+        }
+
+        REQUIRE(cache.size() == cache.max_size());
+        REQUIRE(cache.Get(999, entry));
+        REQUIRE(entry == "999");
+
+        cache.clear();
+        REQUIRE(cache.size() == 0);
+    }
+}
+
+TEST_CASE("Promotion on hits in concurrent LRU caches", "[ConcurrentLRUCache]")
+{
+    using Cache = ConcurrentLRUCache<int, int>;
+    int entry = 0;
+
+    SECTION("eager promotion evicts the least recently used entry")
+    {
+        Cache cache(3, 1, LRUPromotion::Eager);
+        cache.Put(1, 1);
+        cache.Put(2, 2);
+        cache.Put(3, 3);
+        cache.Get(2, entry);
+        cache.Get(1, entry);
+        cache.Put(4, 4);
+        REQUIRE_FALSE(cache.Contains(3));
+        cache.Put(5, 5);
+        REQUIRE_FALSE(cache.Contains(2));
+        REQUIRE(cache.Contains(1));
+    }
+
+    SECTION("lazy promotion gives referenced entries a second chance")
+    {
+        Cache cache(3, 1, LRUPromotion::Lazy);
+        cache.Put(1, 1);
+        cache.Put(2, 2);
+        cache.Put(3, 3);
+        cache.Get(1, entry);
+        cache.Put(4, 4);
+        REQUIRE(cache.Contains(1));
+        REQUIRE_FALSE(cache.Contains(2));
+
+        // The bit was consumed by the second chance.
+        cache.Put(5, 5);
+        cache.Put(6, 6);
+        REQUIRE_FALSE(cache.Contains(3));
+        REQUIRE_FALSE(cache.Contains(1));
+    }
+
+    SECTION("lazy promotion evicts the oldest entry if all are referenced")
+    {
+        Cache cache(3, 1, LRUPromotion::Lazy);
+        for (int i = 1; i <= 3; ++i) {
+            cache.Put(i, i);
+        }
+
+        for (int i = 3; i >= 1; --i) {
+            cache.Get(i, entry);
+        }
+
+        cache.Put(4, 4);
+        REQUIRE_FALSE(cache.Contains(1));
+        REQUIRE(cache.Contains(2));
+        REQUIRE(cache.Contains(3));
+    }
+}
+
+TEST_CASE("Access concurrent LRU caches from multiple threads", "[ConcurrentLRUCache]")
+{
+    for (auto promotion : {LRUPromotion::Eager, LRUPromotion::Lazy}) {
+        ConcurrentLRUCache<int, int> cache(64, 8, promotion);
+
+        std::atomic<int> mismatches {0};
+        std::vector<std::thread> workers;
+        for (int t = 0; t < 4; ++t) {
+            workers.emplace_back([&cache, &mismatches, t] {
+                for (int i = 0; i < 20000; ++i) {
+                    int key = (i * 7 + t * 13) % 256;
+                    if (i % 10 == 0) {
+                        cache.Put(key, key * 3);
+                    } else if (i % 97 == 0) {
+                        cache.Erase(key);
+                    } else {
+                        int entry = -1;
+                        if (cache.Get(key, entry) && entry != key * 3) {
+                            ++mismatches;
+                        }
+                    }
+                }
+            });
+        }
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        REQUIRE(mismatches.load() == 0);
+        REQUIRE(cache.size() <= cache.max_size());
+    }
+}
+
+TEST_CASE("Statistics of concurrent LRU caches", "[ConcurrentLRUCache]")
+{
+    for (auto promotion : {LRUPromotion::Eager, LRUPromotion::Lazy}) {
+        ConcurrentLRUCache<int, int, std::hash<int>, std::equal_to<int>,
+                           AtomicCacheStatsRecorder> cache(64, 8, promotion);
+
+        std::vector<std::thread> workers;
+        for (int t = 0; t < 4; ++t) {
+            workers.emplace_back([&cache, t] {
+                for (int i = 0; i < 10000; ++i) {
+                    int key = (i * 7 + t * 13) % 256;
+                    if (i % 10 == 0) {
+                        cache.Put(key, key);
+                    } else if (i % 97 == 0) {
+                        cache.Erase(key);
+                    } else {
+                        int entry = 0;
+                        cache.Get(key, entry);
+                    }
+                }
+            });
+        }
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        auto stats = cache.stats();
+        REQUIRE(stats.insertions + stats.updates == 4 * 1000);
+        REQUIRE(stats.eviction_count(EvictionReason::Replaced) == stats.updates);
+        REQUIRE(stats.hits + stats.misses + stats.insertions + stats.updates +
+                stats.eviction_count(EvictionReason::Erased) <= 4 * 10000);
+        REQUIRE(stats.insertions - stats.eviction_count(EvictionReason::Capacity) -
+                stats.eviction_count(EvictionReason::Erased) == cache.size());
+        REQUIRE(stats.peak_size <= cache.max_size());
+    }
+}
+
+}   // namespace kbase
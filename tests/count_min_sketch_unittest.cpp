@@ -0,0 +1,54 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "catch2/catch.hpp"
+
+#include "kbase/count_min_sketch.h"
+
+namespace kbase {
+
+TEST_CASE("Estimate frequencies", "[CountMinSketch]")
+{
+    CountMinSketch sketch(1000);
+    REQUIRE(sketch.sample_size() == 10000);
+    REQUIRE(sketch.Frequency(42) == 0);
+
+    for (int i = 0; i < 8; ++i) {
+        sketch.Increment(42);
+    }
+
+    sketch.Increment(43);
+    REQUIRE(sketch.Frequency(42) == 8);
+    REQUIRE(sketch.Frequency(43) == 1);
+
+    SECTION("counters saturate")
+    {
+        for (int i = 0; i < 100; ++i) {
+            sketch.Increment(42);
+        }
+
+        REQUIRE(sketch.Frequency(42) == CountMinSketch::kMaxFrequency);
+    }
+
+    SECTION("counters are halved periodically")
+    {
+        for (size_t key = 1000; key < 1000 + sketch.sample_size() - 9; ++key) {
+            sketch.Increment(key);
+        }
+
+        // Other keys may share counters with the key, and estimates only go up.
+        auto frequency = sketch.Frequency(42);
+        REQUIRE(frequency >= 4);
+        REQUIRE(frequency < 8);
+    }
+
+    SECTION("clear all counters")
+    {
+        sketch.Clear();
+        REQUIRE(sketch.Frequency(42) == 0);
+        REQUIRE(sketch.Frequency(43) == 0);
+    }
+}
+
+}   // namespace kbase
@@ -0,0 +1,218 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+
+#include "kbase/binary_logging.h"
+#include "kbase/file_util.h"
+#include "kbase/flight_recorder.h"
+#include "kbase/logging.h"
+#include "kbase/path.h"
+
+#if defined(OS_POSIX)
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::string DumpFlightRecordsToString()
+{
+    std::string dump;
+    kbase::internal::DumpFlightRecords([](void* context, const char* data, size_t size) {
+        static_cast<std::string*>(context)->append(data, size);
+    }, &dump);
+
+    return dump;
+}
+
+// Returns records of the thread in the dump.
+std::string FlightRecordsOfThread(const std::string& dump, uint64_t thread_id)
+{
+    const std::string kSectionPrefix = "Flight records of thread ";
+    auto begin = dump.find(kSectionPrefix + std::to_string(thread_id) + ":\n");
+    if (begin == std::string::npos) {
+        return std::string();
+    }
+
+    auto end = dump.find(kSectionPrefix, begin + 1);
+    return dump.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+}
+
+std::string ReadFileContent(const kbase::PathString& path)
+{
+    std::ifstream in(path);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+}   // namespace
+
+namespace kbase {
+
+TEST_CASE("Record recent messages including filtered ones", "[FlightRecorder]")
+{
+    LoggingSettings settings;
+    settings.logging_destination = LoggingDestination::LogNone;
+    settings.min_severity_level = LogSeverity::LogWarning;
+    settings.flight_recorder_capacity = 4;
+    ConfigureLoggingSettings(settings);
+
+    int filtered_line = __LINE__ + 1;
+    LOG(INFO) << "never formatted";
+    BLOG(INFO, "request {1} took {0} ms {{id}}", -1.5, 42, std::string("tail"));
+    LOG(WARNING) << "warning text";
+    LOG(WARNING) << std::string(500, 'x');
+
+    auto records = FlightRecordsOfThread(DumpFlightRecordsToString(), GetCurrentOSThreadID());
+    REQUIRE(records.find("INFO flight_recorder_unittest.cpp(" + std::to_string(filtered_line) +
+                         ")]<filtered>\n") != std::string::npos);
+    REQUIRE(records.find("never formatted") == std::string::npos);
+    REQUIRE(records.find(")]request 42 took -1.500000 ms {id}\n") != std::string::npos);
+    REQUIRE(records.find(")]warning text\n") != std::string::npos);
+    REQUIRE(records.find(std::string(internal::kFlightRecordPayloadSize, 'x') + "\n") !=
+            std::string::npos);
+    REQUIRE(records.find(std::string(internal::kFlightRecordPayloadSize + 1, 'x')) ==
+            std::string::npos);
+
+    SECTION("filtered conditional and debug messages are recorded as well")
+    {
+        bool evaluated = false;
+        auto condition = [&evaluated] {
+            evaluated = true;
+            return true;
+        };
+
+        std::vector<int> filtered_lines {__LINE__ + 1};
+        LOG_IF(INFO, condition()) << "never formatted";
+#if !defined(NDEBUG)
+        filtered_lines.push_back(__LINE__ + 1);
+        DLOG(INFO) << "never formatted";
+        filtered_lines.push_back(__LINE__ + 1);
+        DLOG_IF(INFO, condition()) << "never formatted";
+#endif
+        REQUIRE_FALSE(evaluated);
+
+        records = FlightRecordsOfThread(DumpFlightRecordsToString(), GetCurrentOSThreadID());
+        for (auto line : filtered_lines) {
+            REQUIRE(records.find("INFO flight_recorder_unittest.cpp(" + std::to_string(line) +
+                                 ")]<filtered>\n") != std::string::npos);
+        }
+
+        REQUIRE(records.find("never formatted") == std::string::npos);
+    }
+
+    SECTION("only the last messages are kept")
+    {
+        settings.flight_recorder_capacity = 8;
+        ConfigureLoggingSettings(settings);
+        for (int i = 0; i < 20; ++i) {
+            LOG(WARNING) << "message " << i;
+        }
+
+        records = FlightRecordsOfThread(DumpFlightRecordsToString(), GetCurrentOSThreadID());
+        REQUIRE(records.find("warning text") == std::string::npos);
+        REQUIRE(records.find("message 11\n") == std::string::npos);
+        for (int i = 12; i < 20; ++i) {
+            REQUIRE(records.find("message " + std::to_string(i) + "\n") != std::string::npos);
+        }
+
+        REQUIRE(records.find("message 12\n") < records.find("message 19\n"));
+    }
+
+    SECTION("records of exited threads are kept")
+    {
+        uint64_t thread_id = 0;
+        std::thread([&thread_id] {
+            thread_id = GetCurrentOSThreadID();
+            LOG(WARNING) << "from another thread";
+        }).join();
+
+        records = FlightRecordsOfThread(DumpFlightRecordsToString(), thread_id);
+        REQUIRE(records.find(")]from another thread\n") != std::string::npos);
+    }
+
+    SECTION("nothing is recorded once disabled")
+    {
+        settings.flight_recorder_capacity = 0;
+        ConfigureLoggingSettings(settings);
+        LOG(WARNING) << "not recorded";
+        REQUIRE(DumpFlightRecordsToString().find("not recorded") == std::string::npos);
+    }
+
+    ConfigureLoggingSettings(LoggingSettings());
+}
+
+TEST_CASE("Fatal messages carry flight records", "[FlightRecorder]")
+{
+    PathString log_name(PATH_LITERAL("flight_recorder_test.log"));
+    LoggingSettings settings;
+    settings.log_file_path = log_name;
+    settings.old_file_disposal_option = OldFileDisposalOption::DeleteOldFile;
+    settings.min_severity_level = LogSeverity::LogError;
+    settings.flight_recorder_capacity = 16;
+    ConfigureLoggingSettings(settings);
+
+    BLOG(INFO, "context before the crash: {0}", 7);
+    LOG(FATAL) << "simulate a fatal error";
+
+    ConfigureLoggingSettings(LoggingSettings());
+
+    auto content = ReadFileContent(log_name);
+    REQUIRE(content.find("Flight records of thread " + std::to_string(GetCurrentOSThreadID())) !=
+            std::string::npos);
+    REQUIRE(content.find(")]context before the crash: 7\n") != std::string::npos);
+
+    RemoveFile(Path(log_name), false);
+}
+
+#if defined(OS_POSIX)
+
+TEST_CASE("Dump flight records on fatal signals", "[FlightRecorder]")
+{
+    const char kOutputName[] = "flight_recorder_signal_test.txt";
+    unlink(kOutputName);
+
+    auto child = fork();
+    REQUIRE(child != -1);
+    if (child == 0) {
+        int fd = open(kOutputName, O_CREAT | O_WRONLY | O_TRUNC, 0666);
+        dup2(fd, STDERR_FILENO);
+        close(fd);
+
+        LoggingSettings settings;
+        settings.logging_destination = LoggingDestination::LogNone;
+        settings.flight_recorder_capacity = 16;
+        ConfigureLoggingSettings(settings);
+        InstallFatalSignalHandler();
+
+        LOG(INFO) << "last words";
+        raise(SIGSEGV);
+        _exit(0);
+    }
+
+    int status = 0;
+    REQUIRE(waitpid(child, &status, 0) == child);
+    REQUIRE(WIFSIGNALED(status));
+    REQUIRE(WTERMSIG(status) == SIGSEGV);
+
+    auto content = ReadFileContent(kOutputName);
+    REQUIRE(content.find("*** Received fatal signal SIGSEGV ***\n") != std::string::npos);
+    REQUIRE(content.find("Flight records of thread " + std::to_string(child) + ":\n") !=
+            std::string::npos);
+    REQUIRE(content.find(")]last words\n") != std::string::npos);
+
+    unlink(kOutputName);
+}
+
+#endif
+
+}   // namespace kbase
@@ -0,0 +1,236 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+
+#include "kbase/hash_lru_cache.h"
+
+namespace {
+
+template<typename CacheType>
+bool CacheOrderingMatch(const CacheType& cache,
+                        const std::vector<typename CacheType::key_type>& seq)
+{
+    return cache.size() == seq.size() &&
+           std::equal(cache.begin(), cache.end(), seq.begin(),
+                      [](const typename CacheType::value_type& entry,
+                         const typename CacheType::key_type& key) {
+                          return entry.first == key;
+                      });
+}
+
+// Sends every key into the same bucket.
+struct ConstantHash {
+    size_t operator()(int) const noexcept
+    {
+        return 42;
+    }
+};
+
+}   // namespace
+
+namespace kbase {
+
+TEST_CASE("Construct and move hash LRU caches", "[HashLRUCache]")
+{
+    SECTION("with capacity limit or no evict")
+    {
+        HashLRUCache<int, std::string> non_limited(HashLRUCache<int, std::string>::NoAutoEvict);
+        REQUIRE_FALSE(non_limited.auto_evict());
+        REQUIRE(non_limited.max_size() == 0);
+
+        HashLRUCache<int, std::string> ltd(1024);
+        REQUIRE(ltd.auto_evict());
+        REQUIRE(ltd.max_size() == 1024);
+    }
+
+    SECTION("instance is movable")
+    {
+        using Dict = HashLRUCache<int, std::string>;
+
+        auto gen = []() -> Dict {
+            Dict dt(Dict::NoAutoEvict);
+            dt.Put(65, "A");
+            dt.Put(66, "B");
+            dt.Put(67, "C");
+            dt.Put(68, "D");
+            return dt;
+        };
+
+        Dict new_dt(gen());
+        REQUIRE(CacheOrderingMatch(new_dt, {65, 66, 67, 68}));
+
+        Dict messy_dt(123);
+        messy_dt.Put(1, "Its done");
+        messy_dt = std::move(new_dt);
+        REQUIRE_FALSE(messy_dt.auto_evict());
+        REQUIRE(CacheOrderingMatch(messy_dt, {65, 66, 67, 68}));
+        REQUIRE(messy_dt.Get(67)->second == "C");
+        REQUIRE(new_dt.empty());
+        REQUIRE(new_dt.begin() == new_dt.end());
+    }
+}
+
+TEST_CASE("Put, get and evict in hash LRU caches", "[HashLRUCache]")
+{
+    SECTION("put elements into the cache")
+    {
+        std::pair<int, std::string> candidates[] {
+            {65, "A"}, {66, "B"}, {67, "C"}, {68, "D"}, {69, "E"}, {70, "F"}, {71, "G"}
+        };
+
+        HashLRUCache<int, std::string> alphabet(5);
+        REQUIRE(alphabet.empty());
+
+        for (int i = 0; i < 3; ++i) {
+            alphabet.Put(candidates[i].first, candidates[i].second);
+        }
+
+        REQUIRE(alphabet.size() == 3);
+        int idx = 0;
+        for (auto it = alphabet.begin(); it != alphabet.end(); ++it, ++idx) {
+            REQUIRE(it->first == candidates[idx].first);
+            REQUIRE(it->second == candidates[idx].second);
+        }
+
+        // case: LRU replacement when running out of free space
+
+        for (size_t i = 3; i < 7; ++i) {
+            alphabet.Put(candidates[i].first, candidates[i].second);
+        }
+
+        REQUIRE(alphabet.size() == alphabet.max_size());
+        REQUIRE(CacheOrderingMatch(alphabet, {67, 68, 69, 70, 71}));
+        REQUIRE(alphabet.find(65) == alphabet.end());
+
+        // case: updating an entry refreshes it
+
+        alphabet.Put(67, "c");
+        REQUIRE(CacheOrderingMatch(alphabet, {68, 69, 70, 71, 67}));
+        REQUIRE(alphabet.find(67)->second == "c");
+
+        // case: cache movable but non-copyable objects
+
+        using AlphabetTable = HashLRUCache<std::string, std::unique_ptr<int>>;
+        AlphabetTable reverse_alphabet(AlphabetTable::NoAutoEvict);
+        reverse_alphabet.Put("A", std::make_unique<int>(65));
+        reverse_alphabet.Put("B", std::make_unique<int>(66));
+        REQUIRE(*reverse_alphabet.Get("A")->second == 65);
+    }
+
+    SECTION("get cached elements")
+    {
+        using Dict = HashLRUCache<int, std::string>;
+        Dict dt(Dict::NoAutoEvict);
+        dt.Put(65, "A");
+        dt.Put(66, "B");
+        dt.Put(67, "C");
+        dt.Put(68, "D");
+
+        REQUIRE(dt.Get(70) == dt.end());
+        REQUIRE(CacheOrderingMatch(dt, {65, 66, 67, 68}));
+
+        REQUIRE(dt.Get(66)->second == "B");
+        REQUIRE(dt.Get(68)->second == "D");
+        REQUIRE(CacheOrderingMatch(dt, {65, 67, 66, 68}));
+
+        // find() doesn't touch the entry.
+        const auto& const_dt = dt;
+        REQUIRE(const_dt.find(65)->second == "A");
+        REQUIRE(CacheOrderingMatch(dt, {65, 67, 66, 68}));
+    }
+
+    SECTION("erase and evict elements")
+    {
+        using Dict = HashLRUCache<int, std::string>;
+        Dict dt(Dict::NoAutoEvict);
+        dt.Put(65, "A");
+        dt.Put(66, "B");
+        dt.Put(67, "C");
+        dt.Put(68, "D");
+
+        auto next = dt.erase(dt.find(66));
+        REQUIRE(next->first == 67);
+        REQUIRE(CacheOrderingMatch(dt, {65, 67, 68}));
+
+        dt.Evict(2);
+        REQUIRE(CacheOrderingMatch(dt, {68}));
+
+        dt.Evict(1);
+        REQUIRE(dt.empty());
+    }
+}
+
+TEST_CASE("Hash chains and bucket growth", "[HashLRUCache]")
+{
+    SECTION("colliding keys")
+    {
+        HashLRUCache<int, int, ConstantHash> cache(4);
+        for (int i = 0; i < 10; ++i) {
+            cache.Put(i, i * 10);
+        }
+
+        REQUIRE(CacheOrderingMatch(cache, {6, 7, 8, 9}));
+        cache.erase(cache.find(8));
+        REQUIRE(cache.find(8) == cache.end());
+        REQUIRE(cache.find(7)->second == 70);
+        REQUIRE(cache.find(9)->second == 90);
+    }
+
+    SECTION("buckets grow with entries if no auto eviction")
+    {
+        HashLRUCache<int, int> cache(HashLRUCache<int, int>::NoAutoEvict);
+        for (int i = 0; i < 1000; ++i) {
+            cache.Put(i, i);
+        }
+
+        REQUIRE(cache.bucket_count() >= 1000);
+        for (int i = 0; i < 1000; ++i) {
+            REQUIRE(cache.find(i)->second == i);
+        }
+
+        REQUIRE(std::next(cache.begin(), 999)->first == 999);
+        REQUIRE(std::prev(cache.end())->first == 999);
+    }
+
+    SECTION("buckets grow up to the capacity")
+    {
+        HashLRUCache<int, int> cache(100);
+        cache.Put(1, 1);
+        REQUIRE(cache.bucket_count() < 100);
+        for (int i = 0; i < 1000; ++i) {
+            cache.Put(i, i);
+        }
+
+        auto bucket_count = cache.bucket_count();
+        REQUIRE(bucket_count >= 100);
+        REQUIRE(bucket_count < 200);
+        REQUIRE(cache.size() == 100);
+
+        for (int i = 1000; i < 2000; ++i) {
+            cache.Put(i, i);
+        }
+
+        REQUIRE(cache.bucket_count() == bucket_count);
+    }
+
+    SECTION("huge capacities allocate nothing up front")
+    {
+        for (auto max_size : {size_t(1) << 28, ~size_t(0)}) {
+            HashLRUCache<int, int> cache(max_size);
+            for (int i = 0; i < 100; ++i) {
+                cache.Put(i, i);
+            }
+
+            REQUIRE(cache.bucket_count() < 1000);
+            REQUIRE(cache.find(42)->second == 42);
+        }
+    }
+}
+
+}   // namespace kbase
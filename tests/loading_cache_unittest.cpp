@@ -0,0 +1,151 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+
+#include "kbase/loading_cache.h"
+
+namespace kbase {
+
+TEST_CASE("Load and cache entries", "[LoadingCache]")
+{
+    LoadingCache<int, std::string> cache(2);
+    REQUIRE(cache.max_size() == 2);
+    REQUIRE(cache.ttl() == LoadingCache<int, std::string>::TimeToLive::zero());
+
+    int loads = 0;
+    auto loader = [&loads](const int& key) {
+        ++loads;
+        return std::to_string(key);
+    };
+
+    REQUIRE(cache.Get(1, loader) == "1");
+    REQUIRE(cache.Get(1, loader) == "1");
+    REQUIRE(loads == 1);
+
+    cache.Get(2, loader);
+    cache.Get(3, loader);
+    REQUIRE(cache.size() == 2);
+    REQUIRE(loads == 3);
+
+    REQUIRE(cache.Invalidate(3));
+    REQUIRE_FALSE(cache.Invalidate(3));
+    REQUIRE(cache.Get(3, loader) == "3");
+    REQUIRE(loads == 4);
+
+    // Nothing is cached if the loader throws.
+    auto failing_loader = [](const int&) -> std::string {
+        throw std::runtime_error("unavailable");
+    };
+    REQUIRE_THROWS_AS(cache.Get(4, failing_loader), std::runtime_error);
+    REQUIRE(cache.Get(4, loader) == "4");
+}
+
+TEST_CASE("Coalesce concurrent loads of a key", "[LoadingCache]")
+{
+    constexpr int kThreads = 8;
+
+    for (bool failing : {false, true}) {
+        LoadingCache<int, int> cache(16);
+        std::atomic<int> loads {0};
+        std::atomic<bool> released {false};
+        auto loader = [&](const int& key) {
+            ++loads;
+            while (!released.load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            if (failing) {
+                throw std::runtime_error("unavailable");
+            }
+
+            return key * 2;
+        };
+
+        std::atomic<int> results {0};
+        std::atomic<int> errors {0};
+        std::vector<std::thread> callers;
+        for (int i = 0; i < kThreads; ++i) {
+            callers.emplace_back([&] {
+                try {
+                    if (cache.Get(21, loader) == 42) {
+                        ++results;
+                    }
+                } catch (const std::runtime_error&) {
+                    ++errors;
+                }
+            });
+        }
+
+        // Lets every caller join the load in progress.
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        released = true;
+        for (auto& caller : callers) {
+            caller.join();
+        }
+
+        REQUIRE(loads.load() == 1);
+        REQUIRE(results.load() == (failing ? 0 : kThreads));
+        REQUIRE(errors.load() == (failing ? kThreads : 0));
+    }
+}
+
+TEST_CASE("Refresh entries ahead of expiry", "[LoadingCache]")
+{
+    using std::chrono::seconds;
+
+    std::atomic<int> now_seconds {1000};
+    LoadingCache<int, int> cache(16, seconds(10), seconds(2));
+    cache.set_clock([&now_seconds] { return TimePoint() + seconds(now_seconds.load()); });
+    REQUIRE(cache.refresh_ahead() == seconds(2));
+
+    std::atomic<int> loads {0};
+    auto loader = [&loads](const int&) {
+        return ++loads;
+    };
+
+    REQUIRE(cache.Get(1, loader) == 1);
+
+    now_seconds += 7;
+    REQUIRE(cache.Get(1, loader) == 1);
+    cache.WaitForRefreshes();
+    REQUIRE(loads.load() == 1);
+
+    // The old entry is served while it is being reloaded.
+    now_seconds += 1;
+    REQUIRE(cache.Get(1, loader) == 1);
+    cache.WaitForRefreshes();
+    REQUIRE(loads.load() == 2);
+    REQUIRE(cache.Get(1, loader) == 2);
+
+    // The reload restarted the time-to-live.
+    now_seconds += 7;
+    REQUIRE(cache.Get(1, loader) == 2);
+    cache.WaitForRefreshes();
+    REQUIRE(loads.load() == 2);
+
+    // A failed reload leaves the old entry to expire.
+    auto failing_loader = [](const int&) -> int {
+        throw std::runtime_error("unavailable");
+    };
+    now_seconds += 1;
+    REQUIRE(cache.Get(1, failing_loader) == 2);
+    cache.WaitForRefreshes();
+    REQUIRE(cache.Get(1, loader) == 2);
+    cache.WaitForRefreshes();
+    REQUIRE(loads.load() == 3);
+    REQUIRE(cache.Get(1, loader) == 3);
+
+    now_seconds += 10;
+    REQUIRE(cache.Get(1, loader) == 4);
+}
+
+}   // namespace kbase
@@ -0,0 +1,210 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+
+#include "kbase/file_util.h"
+#include "kbase/log_sink.h"
+#include "kbase/logging.h"
+#include "kbase/path.h"
+
+namespace {
+
+class CountingSink : public kbase::LogSink {
+public:
+    explicit CountingSink(kbase::LogSeverity min_severity,
+                          kbase::LogSinkMode mode = kbase::LogSinkMode::Synchronous)
+        : LogSink(min_severity, mode)
+    {}
+
+    void Send(const kbase::LogRecord& record) override
+    {
+        ++count_;
+        if (record.severity == kbase::LogSeverity::LogError) {
+            last_error_line_ = record.line;
+            last_error_file_ = record.file_name;
+        }
+    }
+
+    int count() const
+    {
+        return count_.load();
+    }
+
+    int last_error_line() const
+    {
+        return last_error_line_;
+    }
+
+    const std::string& last_error_file() const
+    {
+        return last_error_file_;
+    }
+
+private:
+    std::atomic<int> count_ {0};
+    int last_error_line_ = 0;
+    std::string last_error_file_;
+};
+
+size_t CountLinesContaining(const kbase::PathString& path, const std::string& text)
+{
+    std::ifstream in(path);
+    size_t count = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.find(text) != std::string::npos) {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+}   // namespace
+
+namespace kbase {
+
+TEST_CASE("Fan out messages to sinks", "[LogSink]")
+{
+    LoggingSettings settings;
+    settings.logging_destination = LoggingDestination::LogNone;
+    ConfigureLoggingSettings(settings);
+
+    auto all_sink = std::make_shared<CountingSink>(LogSeverity::LogInfo);
+    auto error_sink = std::make_shared<CountingSink>(LogSeverity::LogError);
+    AddLogSink(all_sink);
+    AddLogSink(error_sink);
+    AddLogSink(all_sink);
+
+    LOG(INFO) << "info message";
+    LOG(WARNING) << "warning message";
+    int error_line = __LINE__ + 1;
+    LOG(ERROR) << "error message";
+
+    REQUIRE(all_sink->count() == 3);
+    REQUIRE(error_sink->count() == 1);
+    REQUIRE(error_sink->last_error_line() == error_line);
+    REQUIRE(error_sink->last_error_file() == "log_sink_unittest.cpp");
+
+    // Severity filters are adjustable on the fly.
+    all_sink->set_min_severity(LogSeverity::LogWarning);
+    LOG(INFO) << "info message";
+    REQUIRE(all_sink->count() == 3);
+
+    RemoveLogSink(all_sink);
+    LOG(ERROR) << "error message";
+    REQUIRE(all_sink->count() == 3);
+    REQUIRE(error_sink->count() == 2);
+
+    RemoveLogSink(error_sink);
+    ConfigureLoggingSettings(LoggingSettings());
+}
+
+TEST_CASE("Register and remove sinks while logging", "[LogSink]")
+{
+    LoggingSettings settings;
+    settings.logging_destination = LoggingDestination::LogNone;
+    ConfigureLoggingSettings(settings);
+
+    std::atomic<bool> done {false};
+    std::vector<std::thread> loggers;
+    for (int i = 0; i < 4; ++i) {
+        loggers.emplace_back([&done] {
+            while (!done.load()) {
+                LOG(INFO) << "message under churn";
+            }
+        });
+    }
+
+    auto stable_sink = std::make_shared<CountingSink>(LogSeverity::LogInfo);
+    AddLogSink(stable_sink);
+    for (int i = 0; i < 50; ++i) {
+        auto sink = std::make_shared<CountingSink>(
+            LogSeverity::LogInfo,
+            i % 2 ? LogSinkMode::Asynchronous : LogSinkMode::Synchronous);
+        AddLogSink(sink);
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        RemoveLogSink(sink);
+        auto count = sink->count();
+        // Nobody sends to a removed sink.
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        REQUIRE(sink->count() == count);
+    }
+
+    done = true;
+    for (auto& th : loggers) {
+        th.join();
+    }
+
+    REQUIRE(stable_sink->count() > 0);
+    RemoveLogSink(stable_sink);
+    ConfigureLoggingSettings(LoggingSettings());
+}
+
+TEST_CASE("Built-in sinks", "[LogSink]")
+{
+    LoggingSettings settings;
+    settings.logging_destination = LoggingDestination::LogNone;
+    ConfigureLoggingSettings(settings);
+
+    SECTION("asynchronous file sink")
+    {
+        PathString log_name(PATH_LITERAL("file_sink_test.log"));
+        RemoveFile(Path(log_name), false);
+
+        auto sink = std::make_shared<FileLogSink>(log_name);
+        REQUIRE(sink->is_open());
+        AddLogSink(sink);
+        for (int i = 0; i < 100; ++i) {
+            LOG(INFO) << "file sink message " << i;
+        }
+
+        FlushLogging();
+        REQUIRE(CountLinesContaining(log_name, "file sink message") == 100);
+
+        RemoveLogSink(sink);
+        sink = nullptr;
+        RemoveFile(Path(log_name), false);
+    }
+
+    SECTION("ring buffer sink keeps the last messages")
+    {
+        auto sink = std::make_shared<RingBufferLogSink>(4);
+        AddLogSink(sink);
+        for (int i = 0; i < 10; ++i) {
+            LOG(INFO) << "ring message " << i;
+        }
+
+        RemoveLogSink(sink);
+
+        auto messages = sink->GetMessages();
+        REQUIRE(messages.size() == 4);
+        for (size_t i = 0; i < messages.size(); ++i) {
+            auto expected = "ring message " + std::to_string(6 + i) + "\n";
+            REQUIRE(messages[i].size() > expected.size());
+            REQUIRE(messages[i].compare(messages[i].size() - expected.size(), expected.size(),
+                                        expected) == 0);
+        }
+    }
+
+    SECTION("stderr sink")
+    {
+        auto sink = std::make_shared<StderrLogSink>(LogSeverity::LogWarning);
+        AddLogSink(sink);
+        LOG(WARNING) << "stderr sink message";
+        RemoveLogSink(sink);
+    }
+
+    ConfigureLoggingSettings(LoggingSettings());
+}
+
+}   // namespace kbase
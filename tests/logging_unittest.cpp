@@ -2,19 +2,29 @@
  @ 0xCCCCCCCC
 */
 
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
 #include <iostream>
+#include <regex>
+#include <string>
 #include <thread>
 #include <vector>
 
 #include "catch2/catch.hpp"
 
+#include "kbase/async_log_writer.h"
 #include "kbase/basic_types.h"
+#include "kbase/chrono_util.h"
+#include "kbase/file_util.h"
 #include "kbase/logging.h"
 #include "kbase/path.h"
 
-#if defined(OS_WIN)
-#include "kbase/file_util.h"
-#else
+#if defined(OS_POSIX)
+#include <signal.h>
+#include <sys/wait.h>
+
 #include "unistd.h"
 #endif
 
@@ -32,6 +42,12 @@ bool Boolean(bool b)
     return b;
 }
 
+std::string LoggedWhileFormatting()
+{
+    LOG(INFO) << "nested message";
+    return "outer message";
+}
+
 bool PathExists(const kbase::PathString& path)
 {
 #if defined(OS_WIN)
@@ -41,6 +57,58 @@ bool PathExists(const kbase::PathString& path)
 #endif
 }
 
+size_t CountLinesContaining(const kbase::PathString& path, const std::string& text)
+{
+    std::ifstream in(path);
+    size_t count = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.find(text) != std::string::npos) {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+// Holds the flusher in the first batch, until being released.
+class GatedBatchCollector {
+public:
+    void Write(const kbase::internal::AsyncLogWriter::Record* records, size_t count)
+    {
+        entered_ = true;
+        while (!released_) {
+            std::this_thread::yield();
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            messages_.push_back(records[i].message);
+        }
+    }
+
+    void WaitForEntered() const
+    {
+        while (!entered_) {
+            std::this_thread::yield();
+        }
+    }
+
+    void Release()
+    {
+        released_ = true;
+    }
+
+    const std::vector<std::string>& messages() const
+    {
+        return messages_;
+    }
+
+private:
+    std::atomic<bool> entered_ {false};
+    std::atomic<bool> released_ {false};
+    std::vector<std::string> messages_;
+};
+
 }   // namespace
 
 namespace kbase {
@@ -62,6 +130,18 @@ TEST_CASE("It is thread-safe", "[Logging]")
     }
 }
 
+TEST_CASE("Call site descriptors are compile-time constants", "[Logging]")
+{
+    static_assert(*internal::ExtractFileName("C:\\dev\\kbase\\logging.cpp") == 'l', "");
+    static_assert(*internal::ExtractFileName("/home/dev/kbase/path.cpp") == 'p', "");
+    static_assert(*internal::ExtractFileName("main.cpp") == 'm', "");
+
+    const auto& site = LOG_CALL_SITE(LogSeverity::LogWarning);
+    REQUIRE(std::string(site.file_name) == "logging_unittest.cpp");
+    REQUIRE(site.severity == LogSeverity::LogWarning);
+    REQUIRE(site.line == __LINE__ - 3);
+}
+
 TEST_CASE("Control logging level and use conditional logging", "[Logging]")
 {
     LoggingSettings logging_settings;
@@ -77,6 +157,78 @@ TEST_CASE("Control logging level and use conditional logging", "[Logging]")
     DLOG_IF(FATAL, Boolean(false)) << "DLOG_IF(FATAL, Boolean(false))";
 }
 
+TEST_CASE("Adjust severity threshold and verbose levels at runtime", "[Logging]")
+{
+    PathString log_name(PATH_LITERAL("verbose_test_debug.log"));
+    LoggingSettings settings;
+    settings.log_file_path = log_name;
+    settings.old_file_disposal_option = OldFileDisposalOption::DeleteOldFile;
+    settings.verbose_level = 1;
+    ConfigureLoggingSettings(settings);
+
+    auto log_verbose_messages = [] {
+        VLOG(1) << "verbose level 1";
+        VLOG(2) << "verbose level 2";
+        VLOG_IF(2, false) << "verbose level 2";
+    };
+
+    log_verbose_messages();
+    REQUIRE(CountLinesContaining(log_name, "verbose level 1") == 1);
+    REQUIRE(CountLinesContaining(log_name, "verbose level 2") == 0);
+
+    // Call sites that have resolved their levels are refreshed.
+    SetVerboseModuleLevel("logging_unit*", 2);
+    log_verbose_messages();
+    REQUIRE(CountLinesContaining(log_name, "verbose level 2") == 1);
+
+    SetVerboseModuleLevel("logging_unit*", 0);
+    log_verbose_messages();
+    REQUIRE(CountLinesContaining(log_name, "verbose level 1") == 2);
+
+    ClearVerboseModuleLevels();
+    SetVerboseLevel(2);
+    log_verbose_messages();
+    REQUIRE(CountLinesContaining(log_name, "verbose level 1") == 3);
+    REQUIRE(CountLinesContaining(log_name, "verbose level 2") == 2);
+
+    // Verbose messages are of INFO severity.
+    SetMinSeverityLevel(LogSeverity::LogWarning);
+    log_verbose_messages();
+    REQUIRE(CountLinesContaining(log_name, "verbose level 1") == 3);
+
+    SECTION("module levels from settings")
+    {
+        settings.verbose_level = 0;
+        settings.verbose_modules = "no_such_module=3,logging_unittest=1,malformed=,=2";
+        ConfigureLoggingSettings(settings);
+        log_verbose_messages();
+        REQUIRE(CountLinesContaining(log_name, "verbose level 1") == 1);
+        REQUIRE(CountLinesContaining(log_name, "verbose level 2") == 0);
+    }
+
+    SECTION("change the threshold while logging")
+    {
+        std::atomic<bool> done {false};
+        std::thread logger([&done] {
+            while (!done.load()) {
+                LOG(INFO) << "threshold toggling message";
+                VLOG(1) << "threshold toggling verbose message";
+            }
+        });
+
+        for (int i = 0; i < 100; ++i) {
+            SetMinSeverityLevel(i % 2 ? LogSeverity::LogInfo : LogSeverity::LogError);
+            SetVerboseLevel(i % 2);
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+
+        done = true;
+        logger.join();
+    }
+
+    ConfigureLoggingSettings(LoggingSettings());
+}
+
 TEST_CASE("Use custom log file name", "[Logging]")
 {
     PathString log_name(PATH_LITERAL("my_test_debug.log"));
@@ -87,10 +239,501 @@ TEST_CASE("Use custom log file name", "[Logging]")
     REQUIRE(::PathExists(log_name));
 }
 
+TEST_CASE("Formatting states and buffers of log streams", "[Logging]")
+{
+    PathString log_name(PATH_LITERAL("stream_test_debug.log"));
+    LoggingSettings settings;
+    settings.log_file_path = log_name;
+    settings.old_file_disposal_option = OldFileDisposalOption::DeleteOldFile;
+    ConfigureLoggingSettings(settings);
+
+    SECTION("format states don't leak into next message")
+    {
+        LOG(INFO) << "hex value " << std::hex << std::showbase << 255;
+        LOG(INFO) << "dec value " << 255;
+        REQUIRE(CountLinesContaining(log_name, "hex value 0xff") == 1);
+        REQUIRE(CountLinesContaining(log_name, "dec value 255") == 1);
+    }
+
+    SECTION("oversized message spills to heap")
+    {
+        std::string long_text(10000, 'x');
+        LOG(INFO) << "long message " << long_text << " end";
+        REQUIRE(CountLinesContaining(log_name, "long message " + long_text + " end") == 1);
+        LOG(INFO) << "short message";
+        REQUIRE(CountLinesContaining(log_name, "short message") == 1);
+    }
+
+    SECTION("log while formatting another message")
+    {
+        LOG(INFO) << LoggedWhileFormatting();
+        REQUIRE(CountLinesContaining(log_name, "nested message") == 1);
+        REQUIRE(CountLinesContaining(log_name, "outer message") == 1);
+    }
+
+    ConfigureLoggingSettings(LoggingSettings());
+}
+
+TEST_CASE("Timestamp in message header", "[Logging]")
+{
+    PathString log_name(PATH_LITERAL("timestamp_test_debug.log"));
+    LoggingSettings settings;
+    settings.log_file_path = log_name;
+    settings.old_file_disposal_option = OldFileDisposalOption::DeleteOldFile;
+    ConfigureLoggingSettings(settings);
+
+    for (int i = 0; i < 3; ++i) {
+        LOG(INFO) << "timestamp message";
+    }
+
+    auto explode = TimePointToLocalTimeExplode(std::chrono::system_clock::now());
+    char date[16];
+    snprintf(date, sizeof(date), "[%4d%02d%02d ", explode.year, explode.month,
+             explode.day_of_month);
+
+    std::ifstream in(log_name);
+    std::string line;
+    std::regex header_pattern(R"(^\[\d{8} \d{2}:\d{2}:\d{2},\d{3} INFO .*timestamp message$)");
+    int matched = 0;
+    while (std::getline(in, line)) {
+        REQUIRE(std::regex_match(line, header_pattern));
+        REQUIRE(line.compare(0, strlen(date), date) == 0);
+        ++matched;
+    }
+
+    REQUIRE(matched == 3);
+
+    ConfigureLoggingSettings(LoggingSettings());
+}
+
+TEST_CASE("Process and thread ids in message header", "[Logging]")
+{
+    PathString log_name(PATH_LITERAL("ids_test_debug.log"));
+    LoggingSettings settings;
+    settings.log_file_path = log_name;
+    settings.old_file_disposal_option = OldFileDisposalOption::DeleteOldFile;
+    settings.log_item_options = LogItemOptions::EnableProcessID;
+    ConfigureLoggingSettings(settings);
+
+    auto pid = std::to_string(GetCurrentOSProcessID());
+    auto tid = std::to_string(GetCurrentOSThreadID());
+    uint64_t other_tid = 0;
+    std::thread([&other_tid] {
+        other_tid = GetCurrentOSThreadID();
+    }).join();
+    REQUIRE(other_tid != GetCurrentOSThreadID());
+#if defined(OS_POSIX)
+    REQUIRE(pid == std::to_string(getpid()));
+#endif
+
+    LOG(INFO) << "pid only";
+    settings.old_file_disposal_option = OldFileDisposalOption::AppendToOldFile;
+    settings.log_item_options = LogItemOptions::EnableThreadID;
+    ConfigureLoggingSettings(settings);
+    LOG(INFO) << "tid only";
+    settings.log_item_options = LogItemOptions::EnableAll;
+    ConfigureLoggingSettings(settings);
+    LOG(INFO) << "pid and tid";
+
+    // The main thread shares its id with the process on Linux, thus check lines as a whole.
+    std::ifstream in(log_name);
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(in, line);) {
+        lines.push_back(line);
+    }
+
+    REQUIRE(lines.size() == 3);
+    REQUIRE(lines[0].compare(0, pid.size() + 7, "[ " + pid + " INFO") == 0);
+    REQUIRE(lines[1].compare(0, tid.size() + 7, "[ " + tid + " INFO") == 0);
+    REQUIRE(lines[2].find(" " + pid + " " + tid + " INFO") != std::string::npos);
+    in.close();
+
+#if defined(OS_POSIX)
+    SECTION("ids are refreshed in a forked child")
+    {
+        auto child = fork();
+        REQUIRE(child != -1);
+        if (child == 0) {
+            LOG(INFO) << "in child";
+            bool refreshed = GetCurrentOSProcessID() == static_cast<uint64_t>(getpid()) &&
+                             GetCurrentOSThreadID() == static_cast<uint64_t>(getpid());
+            _exit(refreshed ? 0 : 1);
+        }
+
+        int status = 0;
+        REQUIRE(waitpid(child, &status, 0) == child);
+        REQUIRE(WIFEXITED(status));
+        REQUIRE(WEXITSTATUS(status) == 0);
+
+        auto child_id = std::to_string(child);
+        REQUIRE(CountLinesContaining(log_name, " " + child_id + " " + child_id + " INFO") == 1);
+    }
+#endif
+
+    ConfigureLoggingSettings(LoggingSettings());
+    RemoveFile(Path(log_name), false);
+}
+
+TEST_CASE("Rotate log file by size", "[Logging]")
+{
+    std::mutex mutex;
+    std::vector<PathString> rotated_files;
+
+    LoggingSettings settings;
+    settings.log_file_path = PATH_LITERAL("rotation_test_debug.log");
+    settings.old_file_disposal_option = OldFileDisposalOption::DeleteOldFile;
+    settings.max_log_file_size = 1024;
+    settings.max_rotated_files = 2;
+    settings.rotation_handler = [&](const PathString& path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        rotated_files.push_back(path);
+    };
+    ConfigureLoggingSettings(settings);
+
+    auto rotation_count = [&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        return rotated_files.size();
+    };
+
+    std::string padding(64, '-');
+    for (int round = 0; round < 500 && rotation_count() < 3; ++round) {
+        for (int i = 0; i < 20; ++i) {
+            LOG(INFO) << "rotation message " << padding;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // Stops the rotation and waits for pending rotation work.
+    ConfigureLoggingSettings(LoggingSettings());
+
+    REQUIRE(rotated_files.size() >= 3);
+    auto kept_begin = rotated_files.end() - 2;
+    for (auto it = rotated_files.begin(); it != kept_begin; ++it) {
+        REQUIRE_FALSE(::PathExists(*it));
+    }
+
+    for (auto it = kept_begin; it != rotated_files.end(); ++it) {
+        REQUIRE(::PathExists(*it));
+        REQUIRE(CountLinesContaining(*it, "rotation message") > 0);
+    }
+
+    for (const auto& path : rotated_files) {
+        RemoveFile(Path(path), false);
+    }
+}
+
+TEST_CASE("Prune rotated files in order of sequence numbers", "[Logging]")
+{
+    const PathString kLogFilePath = PATH_LITERAL("rotation_seq_test_debug.log");
+
+    // As if the file had been rotated more than 10 times within one second long ago.
+    std::vector<PathString> all_rotated {kLogFilePath + PATH_LITERAL(".20000101-000000")};
+    for (int seq = 1; seq <= 12; ++seq) {
+        auto seq_text = std::to_string(seq);
+        all_rotated.push_back(all_rotated.front() + PathChar('.') +
+                              PathString(seq_text.begin(), seq_text.end()));
+    }
+
+    for (const auto& path : all_rotated) {
+        WriteStringToFile(Path(path), "rotated long ago");
+    }
+
+    std::mutex mutex;
+    std::vector<PathString> rotated_files;
+
+    LoggingSettings settings;
+    settings.log_file_path = kLogFilePath;
+    settings.old_file_disposal_option = OldFileDisposalOption::DeleteOldFile;
+    settings.max_log_file_size = 1024;
+    settings.max_rotated_files = 3;
+    settings.rotation_handler = [&](const PathString& path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        rotated_files.push_back(path);
+    };
+    ConfigureLoggingSettings(settings);
+
+    auto rotation_count = [&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        return rotated_files.size();
+    };
+
+    std::string padding(64, '-');
+    for (int round = 0; round < 500 && rotation_count() < 1; ++round) {
+        for (int i = 0; i < 20; ++i) {
+            LOG(INFO) << "rotation message " << padding;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    ConfigureLoggingSettings(LoggingSettings());
+
+    // Only the newest 3 files are kept.
+    REQUIRE_FALSE(rotated_files.empty());
+    all_rotated.insert(all_rotated.end(), rotated_files.begin(), rotated_files.end());
+    auto kept_begin = all_rotated.end() - 3;
+    for (auto it = all_rotated.begin(); it != kept_begin; ++it) {
+        REQUIRE_FALSE(::PathExists(*it));
+    }
+
+    for (auto it = kept_begin; it != all_rotated.end(); ++it) {
+        REQUIRE(::PathExists(*it));
+    }
+
+    for (const auto& path : all_rotated) {
+        RemoveFile(Path(path), false);
+    }
+
+    RemoveFile(Path(kLogFilePath), false);
+}
+
+TEST_CASE("Rate-limited logging", "[Logging]")
+{
+    PathString log_name(PATH_LITERAL("rate_limit_test_debug.log"));
+    LoggingSettings settings;
+    settings.log_file_path = log_name;
+    settings.old_file_disposal_option = OldFileDisposalOption::DeleteOldFile;
+    ConfigureLoggingSettings(settings);
+
+    int evaluated = 0;
+    auto evaluate = [&evaluated] {
+        return ++evaluated;
+    };
+
+    SECTION("every n messages")
+    {
+        for (int i = 0; i < 25; ++i) {
+            LOG_EVERY_N(INFO, 10) << "every-n message " << evaluate();
+        }
+
+        REQUIRE(evaluated == 3);
+        REQUIRE(CountLinesContaining(log_name, "every-n message") == 3);
+        REQUIRE(CountLinesContaining(log_name, "[9 similar messages suppressed]") == 2);
+    }
+
+    SECTION("first n messages")
+    {
+        for (int i = 0; i < 10; ++i) {
+            LOG_FIRST_N(INFO, 3) << "first-n message " << evaluate();
+        }
+
+        REQUIRE(evaluated == 3);
+        REQUIRE(CountLinesContaining(log_name, "first-n message") == 3);
+    }
+
+    SECTION("at most once per interval")
+    {
+        for (int i = 0; i < 11; ++i) {
+            LOG_EVERY_T(INFO, std::chrono::milliseconds(50)) << "every-t message " << evaluate();
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+        LOG_EVERY_T(INFO, std::chrono::milliseconds(50)) << "every-t message " << evaluate();
+
+        // Each use of the macro is a distinct call site.
+        REQUIRE(evaluated == 2);
+        REQUIRE(CountLinesContaining(log_name, "every-t message") == 2);
+
+        for (int i = 0; i < 3; ++i) {
+            LOG_EVERY_T(WARNING, std::chrono::milliseconds(50)) << "every-t reopen " << i;
+            std::this_thread::sleep_for(std::chrono::milliseconds(i == 0 ? 0 : 60));
+        }
+
+        REQUIRE(CountLinesContaining(log_name, "every-t reopen") == 2);
+        REQUIRE(CountLinesContaining(log_name, "[1 similar messages suppressed]") == 1);
+    }
+
+    SECTION("token bucket")
+    {
+        for (int i = 0; i < 20; ++i) {
+            LOG_RATELIMITED(INFO, 5, std::chrono::hours(1)) << "bucket message " << evaluate();
+        }
+
+        REQUIRE(evaluated == 5);
+        REQUIRE(CountLinesContaining(log_name, "bucket message") == 5);
+    }
+
+    SECTION("disabled severity consumes no quota")
+    {
+        settings.min_severity_level = LogSeverity::LogError;
+        settings.old_file_disposal_option = OldFileDisposalOption::AppendToOldFile;
+        ConfigureLoggingSettings(settings);
+        for (int i = 0; i < 2; ++i) {
+            LOG_FIRST_N(INFO, 1) << "disabled message " << evaluate();
+            settings.min_severity_level = LogSeverity::LogInfo;
+            ConfigureLoggingSettings(settings);
+        }
+
+        REQUIRE(evaluated == 1);
+        REQUIRE(CountLinesContaining(log_name, "disabled message") == 1);
+    }
+
+    ConfigureLoggingSettings(LoggingSettings());
+}
+
+TEST_CASE("Reopen log file while logging", "[Logging]")
+{
+    PathString log_name(PATH_LITERAL("reopen_test_debug.log"));
+    LoggingSettings settings;
+    settings.log_file_path = log_name;
+    settings.old_file_disposal_option = OldFileDisposalOption::DeleteOldFile;
+    ConfigureLoggingSettings(settings);
+
+    constexpr int kThreads = 4;
+    constexpr int kMessagesPerThread = 2000;
+    std::vector<std::thread> loggers;
+    for (int i = 0; i < kThreads; ++i) {
+        loggers.emplace_back([] {
+            for (int j = 0; j < kMessagesPerThread; ++j) {
+                LOG(INFO) << "reopen message " << j << " end";
+            }
+        });
+    }
+
+    // Simulates what logrotate does.
+    std::vector<PathString> moved_files;
+    for (int i = 0; i < 5; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        auto seq = std::to_string(i);
+        PathString moved_name = log_name + PATH_LITERAL(".") + PathString(seq.begin(), seq.end());
+        REQUIRE(MakeFileMove(Path(log_name), Path(moved_name)));
+        moved_files.push_back(moved_name);
+        ReopenLogFile();
+    }
+
+    for (auto& th : loggers) {
+        th.join();
+    }
+
+    ConfigureLoggingSettings(LoggingSettings());
+
+    moved_files.push_back(log_name);
+    size_t total = 0;
+    std::regex message_pattern(R"(^\[.+\]reopen message \d+ end$)");
+    for (const auto& path : moved_files) {
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            REQUIRE(std::regex_match(line, message_pattern));
+            ++total;
+        }
+
+        in.close();
+        RemoveFile(Path(path), false);
+    }
+
+    REQUIRE(total == kThreads * kMessagesPerThread);
+}
+
+#if defined(OS_POSIX)
+
+TEST_CASE("Reopen log file on signal", "[Logging]")
+{
+    PathString log_name(PATH_LITERAL("signal_reopen_test_debug.log"));
+    PathString moved_name(PATH_LITERAL("signal_reopen_test_debug.log.1"));
+    LoggingSettings settings;
+    settings.log_file_path = log_name;
+    settings.old_file_disposal_option = OldFileDisposalOption::DeleteOldFile;
+    ConfigureLoggingSettings(settings);
+
+    ReopenLogFileOnSignal(SIGHUP);
+    LOG(INFO) << "before reopening";
+    REQUIRE(MakeFileMove(Path(log_name), Path(moved_name)));
+    raise(SIGHUP);
+    LOG(INFO) << "after reopening";
+    signal(SIGHUP, SIG_DFL);
+
+    ConfigureLoggingSettings(LoggingSettings());
+
+    REQUIRE(CountLinesContaining(moved_name, "before reopening") == 1);
+    REQUIRE(CountLinesContaining(moved_name, "after reopening") == 0);
+    REQUIRE(CountLinesContaining(log_name, "after reopening") == 1);
+
+    RemoveFile(Path(moved_name), false);
+}
+
+#endif
+
 TEST_CASE("Output callstack in the fatal error", "[Logging]")
 {
     ConfigureLoggingSettings(LoggingSettings());
     LOG(FATAL) << "simulate issuing a fatal error";
 }
 
+TEST_CASE("Log asynchronously", "[Logging]")
+{
+    PathString log_name(PATH_LITERAL("async_test_debug.log"));
+    LoggingSettings settings;
+    settings.log_file_path = log_name;
+    settings.old_file_disposal_option = OldFileDisposalOption::DeleteOldFile;
+    settings.async_logging = true;
+    settings.async_buffer_capacity = 64;
+    ConfigureLoggingSettings(settings);
+
+    constexpr int kThreads = 4;
+    constexpr int kMessagesPerThread = 500;
+    std::vector<std::thread> producers;
+    for (int i = 0; i < kThreads; ++i) {
+        producers.emplace_back([] {
+            for (int j = 0; j < kMessagesPerThread; ++j) {
+                LOG(INFO) << "async message " << j;
+            }
+        });
+    }
+
+    for (auto& th : producers) {
+        th.join();
+    }
+
+    FlushLogging();
+    REQUIRE(CountLinesContaining(log_name, "async message") == kThreads * kMessagesPerThread);
+
+    ConfigureLoggingSettings(LoggingSettings());
+}
+
+TEST_CASE("Overflow policies of async log writer", "[Logging]")
+{
+    using internal::AsyncLogWriter;
+
+    auto run = [](AsyncOverflowPolicy policy, GatedBatchCollector& collector) {
+        AsyncLogWriter writer(4, policy, [&collector](const AsyncLogWriter::Record* records,
+                                                      size_t count) {
+            collector.Write(records, count);
+        });
+
+        writer.Append(LogSeverity::LogError, "0", 1);
+        collector.WaitForEntered();
+        for (int i = 1; i <= 10; ++i) {
+            auto msg = std::to_string(i);
+            writer.Append(LogSeverity::LogInfo, msg.data(), msg.size());
+        }
+
+        collector.Release();
+        writer.Stop();
+    };
+
+    SECTION("drop newest messages")
+    {
+        GatedBatchCollector collector;
+        run(AsyncOverflowPolicy::DropNewestOnOverflow, collector);
+        std::vector<std::string> expected {"0", "1", "2", "3", "4"};
+        REQUIRE(collector.messages().size() == expected.size() + 1);
+        REQUIRE(std::equal(expected.begin(), expected.end(), collector.messages().begin()));
+        REQUIRE(collector.messages().back().find("6 log messages were dropped") !=
+                std::string::npos);
+    }
+
+    SECTION("drop oldest messages")
+    {
+        GatedBatchCollector collector;
+        run(AsyncOverflowPolicy::DropOldestOnOverflow, collector);
+        std::vector<std::string> expected {"0", "7", "8", "9", "10"};
+        REQUIRE(collector.messages().size() == expected.size() + 1);
+        REQUIRE(std::equal(expected.begin(), expected.end(), collector.messages().begin()));
+        REQUIRE(collector.messages().back().find("6 log messages were dropped") !=
+                std::string::npos);
+    }
+}
+
 }   // namespace kbase
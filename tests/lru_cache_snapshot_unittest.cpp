@@ -0,0 +1,167 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+
+#include "kbase/base_path_provider.h"
+#include "kbase/file_util.h"
+#include "kbase/lru_cache_snapshot.h"
+#include "kbase/path_service.h"
+
+namespace {
+
+template<typename CacheType>
+std::vector<typename CacheType::key_type> KeysOf(const CacheType& cache)
+{
+    std::vector<typename CacheType::key_type> keys;
+    for (const auto& entry : cache) {
+        keys.push_back(entry.first);
+    }
+
+    return keys;
+}
+
+}   // namespace
+
+namespace kbase {
+
+TEST_CASE("Save and load snapshots of LRU caches", "[LRUCacheSnapshot]")
+{
+    using Dict = LRUCache<int, std::string, HashMap>;
+
+    Dict dt(4);
+    dt.Put(1, "one");
+    dt.Put(2, "two");
+    dt.Put(3, "");
+    dt.Put(4, "four");
+    dt.Get(1);
+
+    SECTION("recency order is kept")
+    {
+        std::stringstream stream;
+        REQUIRE(SaveSnapshot(dt, stream));
+
+        Dict restored(4);
+        REQUIRE(LoadSnapshot(stream, restored));
+        REQUIRE(KeysOf(restored) == KeysOf(dt));
+        REQUIRE(restored.find(1)->second == "one");
+        REQUIRE(restored.find(3)->second.empty());
+    }
+
+    SECTION("loaded entries are more recent, and smaller caches keep the hottest")
+    {
+        std::stringstream stream;
+        REQUIRE(SaveSnapshot(dt, stream));
+
+        Dict restored(3);
+        restored.Put(5, "five");
+        REQUIRE(LoadSnapshot(stream, restored));
+        REQUIRE(KeysOf(restored) == (std::vector<int>{3, 4, 1}));
+    }
+
+    SECTION("expired entries are not saved")
+    {
+        auto now = TimePoint();
+        dt.set_clock([&now] { return now; });
+        dt.Put(5, "five", std::chrono::seconds(1));
+        now += std::chrono::seconds(1);
+
+        std::stringstream stream;
+        REQUIRE(SaveSnapshot(dt, stream));
+
+        Dict restored(8);
+        REQUIRE(LoadSnapshot(stream, restored));
+        REQUIRE(KeysOf(restored) == (std::vector<int>{3, 4, 1}));
+    }
+
+    SECTION("incomplete or foreign data is rejected")
+    {
+        std::stringstream stream;
+        REQUIRE(SaveSnapshot(dt, stream));
+        auto data = stream.str();
+
+        std::stringstream truncated(data.substr(0, data.size() - 4));
+        Dict restored(4);
+        REQUIRE_FALSE(LoadSnapshot(truncated, restored));
+        REQUIRE(restored.size() == 4);
+
+        std::stringstream foreign("not a snapshot at all");
+        Dict untouched(4);
+        REQUIRE_FALSE(LoadSnapshot(foreign, untouched));
+        REQUIRE(untouched.empty());
+    }
+
+    SECTION("snapshots of other types are rejected")
+    {
+        LRUCache<int, int64_t> numbers(4);
+        numbers.Put(1, int64_t(1) << 40);
+        numbers.Put(2, -1);
+
+        std::stringstream stream;
+        REQUIRE(SaveSnapshot(numbers, stream));
+
+        Dict restored(4);
+        REQUIRE_FALSE(LoadSnapshot(stream, restored));
+        REQUIRE(restored.empty());
+
+        std::stringstream stream_again(stream.str());
+        LRUCache<int64_t, int64_t> wider(4);
+        REQUIRE_FALSE(LoadSnapshot(stream_again, wider));
+        REQUIRE(wider.empty());
+    }
+
+    SECTION("corrupted entries are never put")
+    {
+        std::stringstream stream;
+        REQUIRE(SaveSnapshot(dt, stream));
+        auto data = stream.str();
+
+        // Makes the length of the last string, "one", run past the end of its chunk.
+        auto pos = data.rfind("one");
+        REQUIRE(pos != std::string::npos);
+        size_t length = 1 << 20;
+        data.replace(pos - sizeof(length), sizeof(length),
+                     reinterpret_cast<const char*>(&length), sizeof(length));
+
+        std::stringstream corrupted(data);
+        Dict restored(4);
+        REQUIRE_FALSE(LoadSnapshot(corrupted, restored));
+        REQUIRE(KeysOf(restored) == (std::vector<int>{2, 3, 4}));
+    }
+}
+
+TEST_CASE("Stream snapshots of large LRU caches through files", "[LRUCacheSnapshot]")
+{
+    using Dict = LRUCache<std::string, std::vector<int>>;
+
+    constexpr int kEntryCount = 20000;
+    Dict dt(kEntryCount);
+    for (int i = 0; i < kEntryCount; ++i) {
+        dt.Put(std::to_string(i), std::vector<int>(i % 5, i));
+    }
+
+    for (int i = 0; i < kEntryCount; i += 3) {
+        dt.Get(std::to_string(i));
+    }
+
+    auto path = PathService::Get(DirTemp).AppendWith(PATH_LITERAL("kbase_lru_snapshot.bin"));
+    REQUIRE(SaveSnapshot(dt, path));
+    // The snapshot spans many chunks.
+    REQUIRE(ReadFileToString(path).size() > internal::kSnapshotChunkSize * 4);
+
+    Dict restored(kEntryCount);
+    REQUIRE(LoadSnapshot(path, restored));
+    REQUIRE(KeysOf(restored) == KeysOf(dt));
+    REQUIRE(restored.find("4999")->second == std::vector<int>(4, 4999));
+
+    RemoveFile(path, false);
+    Dict missing(1);
+    REQUIRE_FALSE(LoadSnapshot(path, missing));
+}
+
+}   // namespace kbase
@@ -2,7 +2,11 @@
  @ 0xCCCCCCCC
 */
 
+#include <chrono>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "catch2/catch.hpp"
 
@@ -27,6 +31,77 @@ bool CacheOrderingMatch(const CacheType& cache,
                       });
 }
 
+// Counts copies of keys.
+struct CountedKey {
+    static int copies;
+
+    explicit CountedKey(int v)
+        : value(v)
+    {}
+
+    CountedKey(const CountedKey& other)
+        : value(other.value)
+    {
+        ++copies;
+    }
+
+    CountedKey(CountedKey&&) = default;
+
+    friend bool operator<(const CountedKey& lhs, const CountedKey& rhs)
+    {
+        return lhs.value < rhs.value;
+    }
+
+    int value;
+};
+
+int CountedKey::copies = 0;
+
+// Weighs an entry by its length.
+struct StringLengthWeigher {
+    size_t operator()(int, const std::string& entry) const
+    {
+        return entry.size();
+    }
+};
+
+size_t allocation_count = 0;
+
+// Allocates with std::allocator, and counts allocations made through it.
+template<typename T>
+struct CountingAllocator {
+    using value_type = T;
+
+    CountingAllocator() = default;
+
+    template<typename U>
+    CountingAllocator(const CountingAllocator<U>&) noexcept
+    {}
+
+    T* allocate(size_t n)
+    {
+        ++allocation_count;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* ptr, size_t n) noexcept
+    {
+        std::allocator<T>().deallocate(ptr, n);
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const CountingAllocator<T>&, const CountingAllocator<U>&) noexcept
+{
+    return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const CountingAllocator<T>&, const CountingAllocator<U>&) noexcept
+{
+    return false;
+}
+
 }   // namespace
 
 namespace kbase {
@@ -66,6 +141,34 @@ TEST_CASE("Construction and move semantics", "[LRUCache]")
         REQUIRE_FALSE(messy_dt.auto_evict());
         REQUIRE(CacheOrderingMatch(messy_dt, {65, 66, 67, 68}));
     }
+
+    SECTION("moved-from caches never share pools")
+    {
+        using Dict = LRUCache<int, std::string, HashMap>;
+
+        Dict a(8);
+        a.Put(1, "A");
+        auto pool = a.get_allocator().pool();
+        Dict b(std::move(a));
+        REQUIRE(b.get_allocator().pool() == pool);
+        REQUIRE(a.get_allocator() != b.get_allocator());
+
+        // Reusing both.
+        a.Put(2, "B");
+        b.Put(3, "C");
+        REQUIRE(CacheOrderingMatch(a, {2}));
+        REQUIRE(CacheOrderingMatch(b, {1, 3}));
+
+        Dict c(8);
+        c.Put(4, "D");
+        c = std::move(b);
+        REQUIRE(c.get_allocator().pool() == pool);
+        REQUIRE(b.get_allocator() != c.get_allocator());
+        REQUIRE(b.get_allocator() != a.get_allocator());
+        b.Put(5, "E");
+        REQUIRE(CacheOrderingMatch(b, {5}));
+        REQUIRE(CacheOrderingMatch(c, {1, 3}));
+    }
 }
 
 TEST_CASE("Put, get and eviction", "[LRUCache]")
@@ -161,4 +264,353 @@ TEST_CASE("Put, get and eviction", "[LRUCache]")
     }
 }
 
+TEST_CASE("Eviction by total weight", "[LRUCache]")
+{
+    using Dict = LRUCache<int, std::string, HashMap, StringLengthWeigher>;
+
+    SECTION("entries count as 1 by default")
+    {
+        LRUCache<int, std::string> dt(3);
+        dt.Put(1, "long entry");
+        dt.Put(2, "B");
+        REQUIRE(dt.total_weight() == 2);
+        dt.erase(dt.find(1));
+        REQUIRE(dt.total_weight() == 1);
+    }
+
+    SECTION("evict as many entries as needed")
+    {
+        Dict dt(10);
+        dt.Put(1, "aaa");
+        dt.Put(2, "bbb");
+        dt.Put(3, "ccc");
+        REQUIRE(dt.total_weight() == 9);
+
+        dt.Put(4, "dddddd");
+        REQUIRE(CacheOrderingMatch(dt, {3, 4}));
+        REQUIRE(dt.total_weight() == 9);
+
+        // Updating an entry re-weighs it, and evicts others but itself.
+        dt.Put(4, "dddddddd");
+        REQUIRE(CacheOrderingMatch(dt, {4}));
+        REQUIRE(dt.total_weight() == 8);
+
+        dt.Put(5, "ee");
+        REQUIRE(dt.total_weight() == 10);
+        dt.Evict();
+        REQUIRE(dt.total_weight() == 2);
+    }
+
+    SECTION("reject entries heavier than the budget")
+    {
+        Dict dt(10);
+        dt.Put(1, "aaa");
+        dt.Put(2, "bbb");
+        REQUIRE(dt.Put(3, std::string(11, 'c')) == dt.end());
+        REQUIRE(CacheOrderingMatch(dt, {1, 2}));
+        REQUIRE(dt.total_weight() == 6);
+
+        // The stale entry is erased.
+        REQUIRE(dt.Put(1, std::string(11, 'a')) == dt.end());
+        REQUIRE(CacheOrderingMatch(dt, {2}));
+        REQUIRE(dt.total_weight() == 3);
+
+        REQUIRE(dt.Put(3, std::string(10, 'c')) != dt.end());
+        REQUIRE(CacheOrderingMatch(dt, {3}));
+    }
+
+    SECTION("no limit without auto eviction")
+    {
+        Dict dt(Dict::NoAutoEvict);
+        dt.Put(1, std::string(100, 'a'));
+        dt.Put(2, std::string(100, 'b'));
+        REQUIRE(dt.size() == 2);
+        REQUIRE(dt.total_weight() == 200);
+
+        Dict moved(std::move(dt));
+        REQUIRE(moved.total_weight() == 200);
+        REQUIRE(dt.total_weight() == 0);
+    }
+}
+
+TEST_CASE("Expire entries by time-to-live", "[LRUCache]")
+{
+    using Dict = LRUCache<int, std::string, HashMap>;
+    using std::chrono::seconds;
+
+    auto now = TimePoint() + seconds(1000);
+    Dict dt(5);
+    dt.set_clock([&now] { return now; });
+    REQUIRE(dt.default_ttl() == Dict::TimeToLive::zero());
+
+    dt.Put(1, "A", seconds(10));
+    dt.Put(2, "B", seconds(20));
+    dt.Put(3, "C");
+
+    SECTION("expired entries are never found")
+    {
+        now += seconds(10);
+        const Dict& const_dt = dt;
+        REQUIRE(const_dt.find(1) == const_dt.end());
+        REQUIRE(dt.size() == 3);
+
+        REQUIRE(dt.Get(1) == dt.end());
+        REQUIRE(CacheOrderingMatch(dt, {2, 3}));
+
+        now += seconds(10);
+        REQUIRE(dt.find(2) == dt.end());
+        REQUIRE(CacheOrderingMatch(dt, {3}));
+
+        // Entries without time-to-live never expire.
+        now += seconds(1000000);
+        REQUIRE(dt.Get(3)->second == "C");
+    }
+
+    SECTION("expired entries are told while iterating")
+    {
+        auto is_expired = [&dt] {
+            std::vector<bool> result;
+            for (auto it = dt.cbegin(); it != dt.cend(); ++it) {
+                result.push_back(dt.expired(it));
+            }
+
+            return result;
+        };
+
+        REQUIRE(is_expired() == (std::vector<bool>{false, false, false}));
+
+        now += seconds(10);
+        REQUIRE(is_expired() == (std::vector<bool>{true, false, false}));
+
+        now += seconds(10);
+        REQUIRE(is_expired() == (std::vector<bool>{true, true, false}));
+        REQUIRE(dt.size() == 3);
+    }
+
+    SECTION("updates restart time-to-live")
+    {
+        now += seconds(5);
+        dt.Put(1, "a", seconds(10));
+        now += seconds(9);
+        REQUIRE(dt.Get(1)->second == "a");
+
+        dt.Put(1, "A");
+        now += seconds(1000);
+        REQUIRE(dt.Get(1)->second == "A");
+    }
+
+    SECTION("expired entries are swept before evicting live ones")
+    {
+        dt.Put(4, "D");
+        dt.Put(5, "E");
+        now += seconds(15);
+        dt.Put(6, "F");
+        REQUIRE(CacheOrderingMatch(dt, {2, 3, 4, 5, 6}));
+
+        now += seconds(5);
+        dt.Put(7, "G");
+        REQUIRE(CacheOrderingMatch(dt, {3, 4, 5, 6, 7}));
+
+        dt.Put(8, "H");
+        REQUIRE(CacheOrderingMatch(dt, {4, 5, 6, 7, 8}));
+    }
+
+    SECTION("default time-to-live and purging")
+    {
+        dt.set_default_ttl(seconds(30));
+        dt.Put(4, "D");
+        now += seconds(25);
+        dt.PurgeExpired();
+        REQUIRE(CacheOrderingMatch(dt, {3, 4}));
+
+        now += seconds(5);
+        dt.PurgeExpired();
+        REQUIRE(CacheOrderingMatch(dt, {3}));
+    }
+
+    SECTION("moved caches keep expiry")
+    {
+        Dict moved(std::move(dt));
+        now += seconds(10);
+        REQUIRE(moved.Get(1) == moved.end());
+        REQUIRE(moved.Get(2)->second == "B");
+
+        dt.Put(9, "I", seconds(1));
+        REQUIRE(dt.Get(9)->second == "I");
+    }
+}
+
+TEST_CASE("Heterogeneous lookup and emplacement", "[LRUCache]")
+{
+    SECTION("look up string keys with string views")
+    {
+        LRUCache<std::string, int, HashMap> dt(LRUCache<std::string, int, HashMap>::NoAutoEvict);
+        dt.Put("alpha", 1);
+        dt.Put("beta", 2);
+
+        StringView view = "alpha-beta";
+        REQUIRE(dt.Get(view.substr(0, 5))->second == 1);
+        REQUIRE(dt.find(view.substr(6))->second == 2);
+        REQUIRE(dt.Get(view) == dt.end());
+
+        const auto& const_dt = dt;
+        REQUIRE(const_dt.find("beta") != const_dt.end());
+        REQUIRE(dt.Get(std::string("alpha"))->second == 1);
+
+        LRUCache<std::wstring, int> wide_dt(2);
+        wide_dt.Put(L"alpha", 1);
+        REQUIRE(wide_dt.find(WStringView(L"alpha"))->second == 1);
+    }
+
+    SECTION("emplace entries")
+    {
+        LRUCache<std::string, std::string> dt(2);
+        REQUIRE(dt.Emplace(StringView("a"), 3, 'a')->second == "aaa");
+        REQUIRE(dt.Emplace("b", "bbb")->second == "bbb");
+        REQUIRE(dt.Emplace(std::string("a"), 2, 'x')->second == "xx");
+        REQUIRE(CacheOrderingMatch(dt, {"b", "a"}));
+
+        dt.Emplace("c", "ccc");
+        REQUIRE(CacheOrderingMatch(dt, {"a", "c"}));
+    }
+
+    SECTION("try emplacing leaves arguments intact for existing keys")
+    {
+        using Dict = LRUCache<std::string, std::unique_ptr<int>>;
+        Dict dt(Dict::NoAutoEvict);
+        dt.Put("a", std::make_unique<int>(1));
+        dt.Put("b", std::make_unique<int>(2));
+
+        auto ptr = std::make_unique<int>(42);
+        auto rv = dt.TryEmplace(StringView("a"), std::move(ptr));
+        REQUIRE_FALSE(rv.second);
+        REQUIRE(*rv.first->second == 1);
+        REQUIRE(ptr != nullptr);
+        REQUIRE(CacheOrderingMatch(dt, {"b", "a"}));
+
+        rv = dt.TryEmplace("c", std::move(ptr));
+        REQUIRE(rv.second);
+        REQUIRE(*rv.first->second == 42);
+        REQUIRE(ptr == nullptr);
+    }
+
+    SECTION("keys are stored once")
+    {
+        LRUCache<CountedKey, int> dt(2);
+        CountedKey key(1);
+        CountedKey::copies = 0;
+        dt.Put(key, 1);
+        REQUIRE(CountedKey::copies == 1);
+
+        dt.Put(key, 2);
+        dt.Get(key);
+        dt.TryEmplace(key, 3);
+        REQUIRE(CountedKey::copies == 1);
+
+        dt.Emplace(CountedKey(2), 2);
+        REQUIRE(CountedKey::copies == 1);
+        REQUIRE(dt.size() == 2);
+    }
+}
+
+TEST_CASE("Statistics and eviction callbacks", "[LRUCache]")
+{
+    using std::chrono::seconds;
+
+    SECTION("statistics are not recorded by default")
+    {
+        LRUCache<int, std::string> dt(2);
+        dt.Put(1, "A");
+        dt.Get(1);
+        dt.Get(2);
+        auto stats = dt.stats();
+        REQUIRE(stats.hits == 0);
+        REQUIRE(stats.misses == 0);
+        REQUIRE(stats.insertions == 0);
+    }
+
+    SECTION("record every event")
+    {
+        LRUCache<int, std::string, HashMap, UnitWeigher, CacheStatsRecorder> dt(3);
+        auto now = TimePoint() + seconds(1000);
+        dt.set_clock([&now] { return now; });
+
+        std::vector<std::pair<int, EvictionReason>> evictions;
+        std::string replaced_entry;
+        dt.set_eviction_callback([&](const int& key, std::string& entry, EvictionReason reason) {
+            evictions.emplace_back(key, reason);
+            if (reason == EvictionReason::Replaced) {
+                replaced_entry = entry;
+            }
+        });
+
+        dt.Put(1, "A");
+        dt.Put(2, "B", seconds(10));
+        dt.Put(3, "C");
+        dt.Put(1, "AA");
+        REQUIRE(replaced_entry == "A");
+
+        REQUIRE(dt.Get(1) != dt.end());
+        REQUIRE(dt.Get(4) == dt.end());
+        now += seconds(10);
+        REQUIRE(dt.Get(2) == dt.end());
+
+        dt.Put(4, "D");
+        dt.Put(5, "E");
+        dt.erase(dt.find(4));
+
+        using Event = std::pair<int, EvictionReason>;
+        std::vector<Event> expected {
+            Event(1, EvictionReason::Replaced),
+            Event(2, EvictionReason::Expired),
+            Event(3, EvictionReason::Capacity),
+            Event(4, EvictionReason::Erased)
+        };
+        REQUIRE(evictions == expected);
+
+        auto stats = dt.stats();
+        REQUIRE(stats.hits == 1);
+        REQUIRE(stats.misses == 2);
+        REQUIRE(stats.hit_rate() == Approx(1.0 / 3));
+        REQUIRE(stats.insertions == 5);
+        REQUIRE(stats.updates == 1);
+        REQUIRE(stats.peak_size == 3);
+        REQUIRE(stats.eviction_count(EvictionReason::Capacity) == 1);
+        REQUIRE(stats.eviction_count(EvictionReason::Expired) == 1);
+        REQUIRE(stats.eviction_count(EvictionReason::Erased) == 1);
+        REQUIRE(stats.eviction_count(EvictionReason::Replaced) == 1);
+
+        // Statistics move along with entries.
+        auto moved = std::move(dt);
+        REQUIRE(moved.stats().insertions == 5);
+    }
+}
+
+TEST_CASE("Recycle nodes of evicted entries", "[LRUCache]")
+{
+    using Allocator = CountingAllocator<std::pair<const int, std::string>>;
+
+    allocation_count = 0;
+    {
+        using Dict = LRUCache<int, std::string, HashMap, UnitWeigher, NoCacheStats, Allocator>;
+        Dict dt(8, UnitWeigher(), Allocator());
+        dt.set_default_ttl(std::chrono::hours(1));
+        // The first eviction takes one more node, as the new entry is constructed before it.
+        for (int i = 0; i < 9; ++i) {
+            dt.Put(i, "entry");
+        }
+
+        auto allocated = allocation_count;
+        REQUIRE(allocated > 0);
+        for (int i = 9; i < 100; ++i) {
+            dt.Put(i, "entry");
+        }
+
+        dt.Emplace(100, "entry");
+        dt.TryEmplace(101, "entry");
+        REQUIRE(allocation_count == allocated);
+        REQUIRE(CacheOrderingMatch(dt, {94, 95, 96, 97, 98, 99, 100, 101}));
+    }
+}
+
 }   // namespace kbase
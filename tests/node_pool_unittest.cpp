@@ -0,0 +1,188 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <list>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+#include "catch2/catch.hpp"
+
+#include "kbase/node_pool.h"
+
+namespace {
+
+size_t allocations = 0;
+size_t deallocations = 0;
+
+// Counts calls to it, which the pool makes only if it has no block to reuse.
+template<typename T>
+struct CountingAllocator {
+    using value_type = T;
+
+    CountingAllocator() = default;
+
+    template<typename U>
+    CountingAllocator(const CountingAllocator<U>&) noexcept
+    {}
+
+    T* allocate(size_t n)
+    {
+        ++allocations;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* ptr, size_t n) noexcept
+    {
+        ++deallocations;
+        std::allocator<T>().deallocate(ptr, n);
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const CountingAllocator<T>&, const CountingAllocator<U>&) noexcept
+{
+    return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const CountingAllocator<T>&, const CountingAllocator<U>&) noexcept
+{
+    return false;
+}
+
+}   // namespace
+
+namespace kbase {
+
+TEST_CASE("Recycle blocks in a node pool", "[NodePool]")
+{
+    allocations = 0;
+    deallocations = 0;
+
+    {
+        NodePool<CountingAllocator<int>> pool;
+        auto a = pool.Allocate(24);
+        auto b = pool.Allocate(24);
+        REQUIRE(a != b);
+        REQUIRE(allocations == 2);
+
+        pool.Deallocate(a, 24);
+        pool.Deallocate(b, 24);
+        REQUIRE(pool.free_count() == 2);
+        REQUIRE(deallocations == 0);
+
+        // The most recently freed block comes first.
+        REQUIRE(pool.Allocate(24) == b);
+        REQUIRE(pool.Allocate(20) == a);
+        REQUIRE(pool.free_count() == 0);
+        REQUIRE(allocations == 2);
+
+        // Blocks of another size are not reused.
+        pool.Deallocate(a, 24);
+        auto c = pool.Allocate(64);
+        REQUIRE(c != a);
+        REQUIRE(allocations == 3);
+        pool.Deallocate(c, 64);
+        pool.Deallocate(b, 24);
+        REQUIRE(pool.free_count() == 3);
+
+        auto array = pool.AllocateUnpooled(100);
+        pool.DeallocateUnpooled(array, 100);
+        REQUIRE(pool.free_count() == 3);
+        REQUIRE(deallocations == 1);
+    }
+
+    // Blocks kept are released with the pool.
+    REQUIRE(allocations == deallocations);
+}
+
+TEST_CASE("Node pools keep a bounded number of blocks", "[NodePool]")
+{
+    using Pool = NodePool<CountingAllocator<int>>;
+
+    allocations = 0;
+    deallocations = 0;
+
+    {
+        Pool pool;
+        std::vector<void*> blocks;
+        for (size_t i = 0; i < Pool::kMaxKeptBlocks + 100; ++i) {
+            blocks.push_back(pool.Allocate(24));
+        }
+
+        for (auto block : blocks) {
+            pool.Deallocate(block, 24);
+        }
+
+        REQUIRE(pool.free_count() == Pool::kMaxKeptBlocks);
+        REQUIRE(deallocations == 100);
+
+        // Kept blocks are reused as usual.
+        for (size_t i = 0; i < Pool::kMaxKeptBlocks; ++i) {
+            blocks[i] = pool.Allocate(24);
+        }
+
+        REQUIRE(pool.free_count() == 0);
+        REQUIRE(allocations == Pool::kMaxKeptBlocks + 100);
+        for (size_t i = 0; i < Pool::kMaxKeptBlocks; ++i) {
+            pool.Deallocate(blocks[i], 24);
+        }
+    }
+
+    REQUIRE(allocations == deallocations);
+}
+
+TEST_CASE("Node pool allocators for containers", "[NodePool]")
+{
+    using Pool = NodePool<CountingAllocator<int>>;
+    using Allocator = NodePoolAllocator<int, CountingAllocator<int>>;
+
+    allocations = 0;
+    deallocations = 0;
+
+    {
+        Allocator allocator(std::make_shared<Pool>());
+        NodePoolAllocator<double, CountingAllocator<int>> rebound(allocator);
+        REQUIRE(rebound == allocator);
+        REQUIRE(Allocator(std::make_shared<Pool>()) != allocator);
+
+        std::list<int, Allocator> list(allocator);
+        for (int i = 0; i < 100; ++i) {
+            list.push_back(i);
+        }
+
+        auto allocated = allocations;
+        for (int i = 100; i < 1000; ++i) {
+            list.pop_front();
+            list.push_back(i);
+        }
+
+        REQUIRE(allocations == allocated);
+
+        // Moved-from containers still share the pool.
+        auto moved = std::move(list);
+        list.push_back(0);
+        REQUIRE(list.get_allocator() == moved.get_allocator());
+
+        // Bucket arrays of hash tables are allocated as they are.
+        std::unordered_set<int, std::hash<int>, std::equal_to<int>, Allocator> set(allocator);
+        for (int i = 0; i < 1000; ++i) {
+            set.insert(i);
+        }
+
+        set.clear();
+        allocated = allocations;
+        for (int i = 0; i < 1000; ++i) {
+            set.insert(i);
+        }
+
+        REQUIRE(allocations == allocated);
+        REQUIRE(allocator.pool()->free_count() == 0);
+    }
+
+    REQUIRE(allocations == deallocations);
+}
+
+}   // namespace kbase
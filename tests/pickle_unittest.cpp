@@ -2,6 +2,7 @@
  @ 0xCCCCCCCC
 */
 
+#include <cstring>
 #include <functional>
 #include <list>
 #include <map>
@@ -384,4 +385,174 @@ TEST_CASE("General data serialization and deserialization", "[Pickle]")
     REQUIRE(unmarshalled_data_list == data_list);
 }
 
+TEST_CASE("Reserving room and estimating pickled sizes", "[Pickle]")
+{
+    SECTION("reserved room takes no reallocation")
+    {
+        Pickle pickle;
+        pickle.Reserve(1000);
+        auto capacity = pickle.capacity();
+        REQUIRE(capacity >= 1000 + sizeof(uint32_t));
+
+        // Never shrinks.
+        pickle.Reserve(10);
+        REQUIRE(pickle.capacity() == capacity);
+
+        for (int i = 0; i < 250; ++i) {
+            pickle << i;
+        }
+
+        REQUIRE(pickle.payload_size() == 1000);
+        REQUIRE(pickle.capacity() == capacity);
+
+        // Cleared pickles are reused as they are.
+        pickle.Clear();
+        REQUIRE(pickle.payload_empty());
+        REQUIRE(pickle.capacity() == capacity);
+        pickle << std::string("reused");
+        std::string value;
+        PickleReader reader(pickle);
+        reader >> value;
+        REQUIRE(value == "reused");
+    }
+
+    SECTION("estimations match pickled sizes")
+    {
+        std::vector<int> vi(1000, 42);
+        std::vector<std::string> vs {"", "a", "hello", "pickle"};
+        std::map<std::string, std::vector<double>> table {{"pi", {3.14}}, {"e", {2.71, 2.718}}};
+        std::list<std::pair<bool, std::wstring>> pairs {{true, L"wide"}, {false, L""}};
+
+        Pickle pickle;
+        pickle << true << vi << vs << table << pairs;
+        REQUIRE(pickle.payload_size() == EstimatePickledSize(true) + EstimatePickledSize(vi) +
+                                         EstimatePickledSize(vs) + EstimatePickledSize(table) +
+                                         EstimatePickledSize(pairs));
+    }
+
+    SECTION("containers of fixed-size elements reserve room at once")
+    {
+        std::vector<int> values(1000000);
+        Pickle pickle;
+        pickle << true;
+        pickle << values;
+        REQUIRE(pickle.capacity() - sizeof(uint32_t) - pickle.payload_size() < 64);
+    }
+}
+
+TEST_CASE("Pickling vectors of numbers in bulk", "[Pickle]")
+{
+    SECTION("the layout is the same as pickling elements one by one")
+    {
+        std::vector<int> vi {1, -2, 3, 0x7FFFFFFF};
+        std::vector<double> vd {3.14, -2.71, 1e300};
+        std::vector<uint64_t> vu {UINT64_C(0xFFFFFFFFFFFFFFFF), 0};
+
+        Pickle bulk;
+        bulk << true << vi << vd << vu;
+
+        Pickle one_by_one;
+        one_by_one << true << vi.size();
+        for (auto i : vi) {
+            one_by_one << i;
+        }
+
+        one_by_one << vd.size();
+        for (auto d : vd) {
+            one_by_one << d;
+        }
+
+        one_by_one << vu.size();
+        for (auto u : vu) {
+            one_by_one << u;
+        }
+
+        REQUIRE(bulk.size() == one_by_one.size());
+        REQUIRE(memcmp(bulk.data(), one_by_one.data(), bulk.size()) == 0);
+
+        PickleReader reader(bulk);
+        bool b = false;
+        std::vector<int> cvi {42};
+        std::vector<double> cvd;
+        std::vector<uint64_t> cvu;
+        reader >> b >> cvi >> cvd >> cvu;
+        REQUIRE(b);
+        REQUIRE(cvi == std::vector<int>({42, 1, -2, 3, 0x7FFFFFFF}));
+        REQUIRE(cvd == vd);
+        REQUIRE(cvu == vu);
+        REQUIRE_FALSE(!!reader);
+    }
+
+    SECTION("empty vectors and vectors of small or nested elements")
+    {
+        std::vector<float> empty;
+        std::vector<short> shorts {1, -1, 32767};
+        std::vector<std::vector<int>> nested {{1, 2}, {}, {3}};
+
+        Pickle pickle;
+        pickle << empty << shorts << nested << 7;
+
+        PickleReader reader(pickle);
+        std::vector<float> cempty;
+        std::vector<short> cshorts;
+        std::vector<std::vector<int>> cnested;
+        int tail = 0;
+        reader >> cempty >> cshorts >> cnested >> tail;
+        REQUIRE(cempty.empty());
+        REQUIRE(cshorts == shorts);
+        REQUIRE(cnested == nested);
+        REQUIRE(tail == 7);
+        REQUIRE_FALSE(!!reader);
+    }
+
+    SECTION("corrupted sizes are rejected before reading")
+    {
+        Pickle pickle;
+        pickle << (size_t(1) << 40) << 1 << 2;
+
+        PickleReader reader(pickle);
+        std::vector<int> vi;
+        REQUIRE_THROWS_AS(reader >> vi, EnsureFailure);
+        REQUIRE(vi.empty());
+
+        PickleReader str_reader(pickle);
+        std::string str;
+        REQUIRE_THROWS_AS(str_reader >> str, EnsureFailure);
+        REQUIRE(str.empty());
+
+        PickleReader list_reader(pickle);
+        std::list<std::string> strs;
+        REQUIRE_THROWS_AS(list_reader >> strs, EnsureFailure);
+        REQUIRE(strs.empty());
+    }
+
+    SECTION("reads never go past the end of data")
+    {
+        Pickle pickle;
+        pickle << 1;
+
+        PickleReader reader(pickle);
+        int64_t value = 0;
+        REQUIRE_THROWS_AS(reader >> value, EnsureFailure);
+
+        PickleReader int_reader(pickle);
+        int i = 0;
+        int_reader >> i;
+        REQUIRE(i == 1);
+        REQUIRE_THROWS_AS(int_reader >> i, EnsureFailure);
+    }
+
+    SECTION("only types pickled by Pickle itself are in bulk")
+    {
+        REQUIRE(internal::IsBulkPickleable<int>::value);
+        REQUIRE(internal::IsBulkPickleable<uint64_t>::value);
+        REQUIRE(internal::IsBulkPickleable<double>::value);
+        REQUIRE_FALSE(internal::IsBulkPickleable<short>::value);
+        REQUIRE_FALSE(internal::IsBulkPickleable<wchar_t>::value);
+        REQUIRE_FALSE(internal::IsBulkPickleable<char32_t>::value);
+        REQUIRE(internal::IsBulkPickleable<long long>::value ==
+                std::is_same<long long, int64_t>::value);
+    }
+}
+
 }   // namespace kbase
@@ -0,0 +1,140 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+
+#include "kbase/segmented_lru_cache.h"
+
+namespace {
+
+template<typename CacheType>
+bool CacheOrderingMatch(const CacheType& cache,
+                        const std::vector<typename CacheType::key_type>& seq)
+{
+    return cache.size() == seq.size() &&
+           std::equal(cache.begin(), cache.end(), seq.begin(),
+                      [](const typename CacheType::value_type& entry,
+                         const typename CacheType::key_type& key) {
+                          return entry.first == key;
+                      });
+}
+
+}   // namespace
+
+namespace kbase {
+
+TEST_CASE("Construct and move segmented LRU caches", "[SegmentedLRUCache]")
+{
+    using Dict = SegmentedLRUCache<int, std::string>;
+
+    Dict non_limited(Dict::NoAutoEvict);
+    REQUIRE_FALSE(non_limited.auto_evict());
+    REQUIRE(non_limited.max_size() == 0);
+
+    Dict dt(5);
+    dt.Put(1, "A");
+    dt.Put(2, "B");
+    dt.Get(1);
+    REQUIRE(CacheOrderingMatch(dt, {2, 1}));
+
+    Dict moved(std::move(dt));
+    REQUIRE(dt.empty());
+    REQUIRE(CacheOrderingMatch(moved, {2, 1}));
+    REQUIRE(moved.protected_size() == 1);
+
+    non_limited = std::move(moved);
+    REQUIRE(non_limited.auto_evict());
+    REQUIRE(CacheOrderingMatch(non_limited, {2, 1}));
+
+    // Segments still work after being moved.
+    non_limited.Put(3, "C");
+    non_limited.Get(2);
+    REQUIRE(CacheOrderingMatch(non_limited, {3, 1, 2}));
+}
+
+TEST_CASE("Promote and evict in segmented LRU caches", "[SegmentedLRUCache]")
+{
+    using Dict = SegmentedLRUCache<int, std::string, HashMap>;
+
+    SECTION("entries accessed again are protected")
+    {
+        Dict dt(5);
+        dt.Put(1, "A");
+        dt.Put(2, "B");
+        dt.Put(3, "C");
+        REQUIRE(dt.Get(2)->second == "B");
+        REQUIRE(CacheOrderingMatch(dt, {1, 3, 2}));
+        REQUIRE(dt.protected_size() == 1);
+
+        // Updates count as accesses.
+        dt.Put(1, "a");
+        REQUIRE(CacheOrderingMatch(dt, {3, 2, 1}));
+        REQUIRE(dt.find(1)->second == "a");
+
+        dt.Evict();
+        REQUIRE(CacheOrderingMatch(dt, {2, 1}));
+
+        REQUIRE(dt.Get(4) == dt.end());
+    }
+
+    SECTION("protected entries overflow into the probationary segment")
+    {
+        Dict dt(5);
+        for (int i = 1; i <= 5; ++i) {
+            dt.Put(i, std::to_string(i));
+        }
+
+        for (int i = 1; i <= 5; ++i) {
+            dt.Get(i);
+        }
+
+        REQUIRE(dt.protected_size() == 4);
+        REQUIRE(CacheOrderingMatch(dt, {1, 2, 3, 4, 5}));
+
+        dt.Put(6, "6");
+        REQUIRE(CacheOrderingMatch(dt, {6, 2, 3, 4, 5}));
+
+        dt.erase(dt.find(3));
+        REQUIRE(CacheOrderingMatch(dt, {6, 2, 4, 5}));
+        REQUIRE(dt.protected_size() == 3);
+
+        dt.Evict(4);
+        REQUIRE(dt.empty());
+        REQUIRE(dt.protected_size() == 0);
+    }
+
+    SECTION("one-off scans never flush frequently used entries")
+    {
+        Dict dt(100);
+        for (int i = 0; i < 50; ++i) {
+            dt.Put(i, std::to_string(i));
+            dt.Get(i);
+        }
+
+        for (int i = 1000; i < 2000; ++i) {
+            dt.Put(i, std::to_string(i));
+        }
+
+        REQUIRE(dt.size() == 100);
+        for (int i = 0; i < 50; ++i) {
+            REQUIRE(dt.find(i) != dt.end());
+        }
+    }
+
+    SECTION("cache movable but non-copyable objects")
+    {
+        SegmentedLRUCache<std::string, std::unique_ptr<int>> table(2);
+        table.Put("A", std::make_unique<int>(65));
+        table.Put("B", std::make_unique<int>(66));
+        table.Put("C", std::make_unique<int>(67));
+        REQUIRE(table.size() == 2);
+        REQUIRE(*table.Get("C")->second == 67);
+    }
+}
+
+}   // namespace kbase
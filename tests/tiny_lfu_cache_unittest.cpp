@@ -0,0 +1,141 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+
+#include "kbase/tiny_lfu_cache.h"
+
+namespace {
+
+template<typename CacheType>
+bool CacheOrderingMatch(const CacheType& cache,
+                        const std::vector<typename CacheType::key_type>& seq)
+{
+    return cache.size() == seq.size() &&
+           std::equal(cache.begin(), cache.end(), seq.begin(),
+                      [](const typename CacheType::value_type& entry,
+                         const typename CacheType::key_type& key) {
+                          return entry.first == key;
+                      });
+}
+
+}   // namespace
+
+namespace kbase {
+
+TEST_CASE("Basic operations of TinyLFU caches", "[TinyLFUCache]")
+{
+    using Dict = TinyLFUCache<int, std::string, HashMap>;
+
+    SECTION("without auto eviction it is a plain LRU cache")
+    {
+        Dict dt(Dict::NoAutoEvict);
+        REQUIRE_FALSE(dt.auto_evict());
+        for (int i = 0; i < 5; ++i) {
+            dt.Put(i, std::to_string(i));
+        }
+
+        dt.Get(1);
+        REQUIRE(CacheOrderingMatch(dt, {0, 2, 3, 4, 1}));
+
+        dt.erase(dt.find(3));
+        dt.Evict();
+        REQUIRE(CacheOrderingMatch(dt, {2, 4, 1}));
+
+        Dict moved(std::move(dt));
+        REQUIRE(dt.empty());
+        moved.Put(5, "5");
+        REQUIRE(CacheOrderingMatch(moved, {2, 4, 1, 5}));
+    }
+
+    SECTION("put, get and update")
+    {
+        Dict dt(10);
+        REQUIRE(dt.Get(1) == dt.end());
+        REQUIRE(dt.Put(1, "A")->second == "A");
+        REQUIRE(dt.Get(1)->second == "A");
+        dt.Put(1, "a");
+        REQUIRE(dt.find(1)->second == "a");
+        REQUIRE(dt.size() == 1);
+
+        // The miss, the put, the get and the update.
+        REQUIRE(dt.frequency(1) == 4);
+        REQUIRE(dt.frequency(2) == 0);
+
+        for (int i = 0; i < 100; ++i) {
+            dt.Put(i, std::to_string(i));
+            REQUIRE(dt.size() <= dt.max_size());
+        }
+
+        REQUIRE(dt.size() == dt.max_size());
+        REQUIRE(dt.find(99) != dt.end());
+    }
+
+    SECTION("a single entry cache keeps the newest")
+    {
+        Dict dt(1);
+        dt.Put(1, "A");
+        dt.Put(2, "B");
+        REQUIRE(CacheOrderingMatch(dt, {2}));
+    }
+}
+
+TEST_CASE("Admission of TinyLFU caches", "[TinyLFUCache]")
+{
+    using Dict = TinyLFUCache<int, int, HashMap>;
+
+    SECTION("rarely used entries are not admitted")
+    {
+        Dict dt(10);
+        for (int i = 0; i < 10; ++i) {
+            dt.Put(i, i);
+            dt.Get(i);
+            dt.Get(i);
+        }
+
+        // Each new entry leaves the window and loses to the victim of the main space.
+        dt.Put(100, 100);
+        dt.Put(101, 101);
+        REQUIRE(dt.find(100) == dt.end());
+        REQUIRE(dt.find(101) != dt.end());
+        REQUIRE(dt.size() == 10);
+
+        // Until it has been accessed more often.
+        for (int i = 0; i < 5; ++i) {
+            dt.Get(101);
+        }
+
+        dt.Put(102, 102);
+        REQUIRE(dt.find(101) != dt.end());
+        REQUIRE(dt.size() == 10);
+    }
+
+    SECTION("one-off scans never flush frequently used entries")
+    {
+        Dict dt(100);
+        for (int round = 0; round < 8; ++round) {
+            for (int i = 0; i < 50; ++i) {
+                if (dt.Get(i) == dt.end()) {
+                    dt.Put(i, i);
+                }
+            }
+        }
+
+        for (int i = 1000; i < 1500; ++i) {
+            if (dt.Get(i) == dt.end()) {
+                dt.Put(i, i);
+            }
+        }
+
+        REQUIRE(dt.size() == 100);
+        for (int i = 0; i < 50; ++i) {
+            REQUIRE(dt.find(i) != dt.end());
+        }
+    }
+}
+
+}   // namespace kbase
@@ -0,0 +1,86 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+// Renders binary log files written by `BLOG` back to text messages.
+//
+//   kbase_logdecode [--items=timestamp,pid,tid] <binary-log-file>...
+//
+// `--items` selects items of message headers, and is `timestamp` by default.
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "kbase/binary_logging.h"
+#include "kbase/string_util.h"
+
+namespace {
+
+bool ParseLogItemOptions(const std::string& items, kbase::LogItemOptions& options)
+{
+    std::vector<std::string> tokens;
+    kbase::SplitString(items, ",", tokens);
+
+    int flags = kbase::LogItemOptions::EnableNone;
+    for (const auto& token : tokens) {
+        if (token == "timestamp") {
+            flags |= kbase::LogItemOptions::EnableTimestamp;
+        } else if (token == "pid") {
+            flags |= kbase::LogItemOptions::EnableProcessID;
+        } else if (token == "tid") {
+            flags |= kbase::LogItemOptions::EnableThreadID;
+        } else {
+            return false;
+        }
+    }
+
+    options = static_cast<kbase::LogItemOptions>(flags);
+
+    return true;
+}
+
+}   // namespace
+
+int main(int argc, char* argv[])
+{
+    // `kbase::CommandLine` takes a leading '/' as a switch prefix, which mistakes absolute
+    // paths on POSIX for switches.
+    constexpr char kItemsSwitch[] = "--items=";
+    std::string items = "timestamp";
+    std::vector<std::string> file_paths;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], kItemsSwitch, sizeof(kItemsSwitch) - 1) == 0) {
+            items = argv[i] + sizeof(kItemsSwitch) - 1;
+        } else {
+            file_paths.push_back(argv[i]);
+        }
+    }
+
+    kbase::LogItemOptions options;
+    if (file_paths.empty() || !ParseLogItemOptions(items, options)) {
+        std::cerr << "Usage: kbase_logdecode [--items=timestamp,pid,tid] <binary-log-file>...\n";
+        return 1;
+    }
+
+    int exit_code = 0;
+    for (const auto& file_path : file_paths) {
+        std::ifstream in(file_path, std::ios::binary);
+        if (!in) {
+            std::cerr << "Failed to open " << file_path << "\n";
+            exit_code = 1;
+            continue;
+        }
+
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (!kbase::DecodeBinaryLog(data.data(), data.size(), options, std::cout)) {
+            std::cerr << file_path << " is malformed or truncated\n";
+            exit_code = 1;
+        }
+    }
+
+    return exit_code;
+}